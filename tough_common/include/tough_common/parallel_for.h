@@ -0,0 +1,39 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief splits [begin, end) in contiguous chunks and runs each one on its own thread. The calling thread
+ * runs the whole range when a single thread is asked for or the range is too small to split.
+ * @param num_threads number of threads, 0 to use all the available cores
+ * @param fn called with the bounds of a chunk, [chunk_begin, chunk_end)
+ */
+inline void parallelFor(int num_threads, int begin, int end, const std::function<void(int, int)> &fn)
+{
+    if(num_threads <= 0)
+        num_threads = std::thread::hardware_concurrency();
+    num_threads = std::max(1, std::min(num_threads, end - begin));
+    if(num_threads == 1)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(num_threads);
+    int chunk = (end - begin + num_threads - 1)/num_threads;
+    for(int start = begin; start < end; start += chunk)
+    {
+        workers.emplace_back(fn, start, std::min(start + chunk, end));
+    }
+    for(auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+#endif // PARALLEL_FOR_H
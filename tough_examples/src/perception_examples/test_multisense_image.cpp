@@ -20,6 +20,8 @@ int main(int argc, char **argv)
 {
     ros::init(argc, argv, "test_multisense_image");
     ros::NodeHandle nh;
+    ros::AsyncSpinner spinner(1);
+    spinner.start();
     bool status;
 
     tough_perception::MultisenseImage imageHandler(nh);
@@ -30,8 +32,12 @@ int main(int argc, char **argv)
 
     ROS_INFO_STREAM("[Height]" << imageHandler.giveHeight() << " [width]" <<imageHandler.giveWidth());
 
+    // the image is delivered by the spinner thread, wait for the first one published from now on
     cv::Mat image;
-    status = imageHandler.giveImage(image);
+    std::future<cv::Mat> next_image = imageHandler.nextImageAfter(ros::Time::now());
+    status = next_image.wait_for(std::chrono::seconds(5)) == std::future_status::ready;
+    if(status)
+        image = next_image.get();
     ROS_INFO("image status %s",status ? "true" : "false");
 
     if(status)
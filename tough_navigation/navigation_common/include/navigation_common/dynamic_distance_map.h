@@ -0,0 +1,99 @@
+#ifndef DYNAMIC_DISTANCE_MAP_H
+#define DYNAMIC_DISTANCE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief Euclidean distance to the closest obstacle of every cell of a grid, updated incrementally with the
+ * dynamic brushfire of Lau et al. Each cell keeps a reference to its closest obstacle. Adding an obstacle
+ * starts a lower wave, removing one starts a raise wave that clears the cells that referenced it, and both
+ * waves only visit the cells whose distance changes. Distances are truncated at max_distance.
+ */
+class DynamicDistanceMap
+{
+public:
+    DynamicDistanceMap(int width, int height, float resolution, float max_distance);
+    ~DynamicDistanceMap();
+
+    /**
+     * @brief recomputes the whole map from a grid
+     * @param is_obstacle tells if the value of a grid cell is an obstacle
+     */
+    void reset(const std::vector<int8_t> &grid, const std::function<bool(int8_t)> &is_obstacle);
+
+    /**
+     * @brief queues a change of a cell, the distances change on the next call to update
+     * @param index row major index of the cell
+     */
+    void setObstacle(size_t index);
+    void removeObstacle(size_t index);
+
+    /**
+     * @brief propagates the queued changes
+     * @param changed_cells cells whose distance changed since the last update, can be null
+     */
+    void update(std::vector<size_t> *changed_cells = nullptr);
+
+    /**
+     * @return distance in meters to the closest obstacle, max_distance when there is none closer
+     */
+    float getDistance(size_t index) const;
+
+    /**
+     * @brief distance scaled to the occupancy grid range, 0 at an obstacle and 100 at max_distance or further
+     */
+    int8_t getScaledDistance(size_t index) const;
+
+    bool isObstacle(size_t index) const
+    {
+        return cells_[index].obstacle == static_cast<int32_t>(index);
+    }
+
+    int getWidth() const  { return width_; }
+    int getHeight() const { return height_; }
+
+private:
+    static const int32_t NO_OBSTACLE = -1;
+    static const int32_t FAR_DISTANCE = INT32_MAX;
+
+    enum QueueState : uint8_t
+    {
+        NOT_QUEUED = 0,
+        QUEUED,
+        PROCESSED
+    };
+
+    struct Cell
+    {
+        int32_t     obstacle;       // index of the closest obstacle
+        int32_t     sq_distance;    // squared distance to it in cells
+        bool        raise;
+        QueueState  state;
+    };
+
+    void push(int32_t sq_distance, size_t index);
+    bool pop(size_t &index);
+    void raise(size_t index);
+    void lower(size_t index);
+    void markChanged(size_t index);
+
+    int                 width_;
+    int                 height_;
+    float               resolution_;
+    int32_t             max_sq_distance_;
+    std::vector<Cell>   cells_;
+
+    // bucket queue indexed by squared distance, cells beyond max_distance are never queued
+    std::vector<std::vector<size_t>>    buckets_;
+    size_t                              next_bucket_;
+    size_t                              queued_;
+
+    // cells whose distance changed since the last update
+    std::vector<uint8_t>    changed_;
+    std::vector<size_t>     changed_cells_;
+};
+
+#endif // DYNAMIC_DISTANCE_MAP_H
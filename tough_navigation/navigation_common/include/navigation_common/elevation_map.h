@@ -0,0 +1,112 @@
+#ifndef ELEVATION_MAP_H
+#define ELEVATION_MAP_H
+
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief parameters of the elevation map. The map is a fixed grid of length_x by length_y meters whose
+ * lower corner is at (origin_x, origin_y) in the world frame.
+ */
+struct ElevationMapParams
+{
+    float resolution;
+    float length_x;
+    float length_y;
+    float origin_x;
+    float origin_y;
+    float measurement_variance;     // variance of a single height measurement
+    float mahalanobis_threshold;    // measurements further than this many std dev above the cell replace it
+    float min_variance;             // lower bound of the fused variance so that the map can still change
+    float variance_growth;          // variance added to a cell per second since it was last updated
+    float max_variance;             // upper bound of the grown variance, the next measurement replaces such a cell
+    int   num_threads;              // 0 to use all the available cores
+
+    ElevationMapParams():
+        resolution(0.05f), length_x(40.0f), length_y(40.0f), origin_x(-20.0f), origin_y(-20.0f),
+        measurement_variance(0.0004f), mahalanobis_threshold(3.0f), min_variance(0.0001f), variance_growth(0.0001f),
+        max_variance(1.0f), num_threads(0)
+    {
+    }
+};
+
+/**
+ * @brief elevation layers of a rectangular part of the map, rows along y. Unknown cells have a NaN height.
+ */
+struct ElevationSubmap
+{
+    float origin_x;
+    float origin_y;
+    float resolution;
+    int   width;
+    int   height;
+    std::vector<float> elevation;
+    std::vector<float> variance;
+    std::vector<float> slope;       // radians
+    std::vector<float> roughness;   // std dev of the heights of the 3x3 neighbourhood in meters
+};
+
+/**
+ * @brief 2.5D elevation map updated incrementally from point clouds. Each layer is stored in its own
+ * array so that updates and sub-map copies touch contiguous memory.
+ */
+class ElevationMap
+{
+public:
+    ElevationMap(const ElevationMapParams &params = ElevationMapParams());
+    ~ElevationMap();
+
+    /**
+     * @brief fuses the points of a cloud in the world frame. The height of a cell is a variance weighted
+     * mean of its measurements, a measurement well above the cell replaces it. The variance of a cell grows
+     * with the time since its last update and with every measurement well below it, so the cell of an
+     * object that was moved away comes down again. Slope and roughness are recomputed around the updated
+     * cells.
+     * @param cloud cloud with float x, y and z fields
+     * @return number of points inside the map
+     */
+    size_t update(const sensor_msgs::PointCloud2 &cloud);
+
+    /**
+     * @brief gives the layers of a cell
+     * @return false if the point is outside the map or the cell was never observed
+     */
+    bool getCell(float x, float y, float &elevation, float &variance, float &slope, float &roughness) const;
+
+    /**
+     * @brief copies the layers of a rectangle of the map, clipped to the map bounds
+     * @param center_x center of the rectangle in the world frame
+     * @param center_y
+     * @param length_x size of the rectangle in meters
+     * @param length_y
+     * @param submap the copied layers
+     * @return false if the rectangle does not overlap the map
+     */
+    bool getSubmap(float center_x, float center_y, float length_x, float length_y, ElevationSubmap &submap) const;
+
+    /**
+     * @brief marks all the cells as unknown
+     */
+    void clear();
+
+    const ElevationMapParams& getParams() const { return params_; }
+
+private:
+    bool toCell(float x, float y, int &col, int &row) const;
+    void updateDerivedLayers(int min_col, int min_row, int max_col, int max_row);
+
+    ElevationMapParams  params_;
+    int                 width_;
+    int                 height_;
+
+    mutable std::mutex  mutex_;
+    std::vector<float>  elevation_;
+    std::vector<float>  variance_;
+    std::vector<double> update_time_;       // stamp of the last cloud that updated the cell
+    std::vector<float>  slope_;
+    std::vector<float>  roughness_;
+};
+
+#endif // ELEVATION_MAP_H
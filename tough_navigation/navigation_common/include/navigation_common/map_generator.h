@@ -5,9 +5,17 @@
 #include <nav_msgs/OccupancyGrid.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/point_cloud2_iterator.h>
+#include <tf/transform_listener.h>
 #include "tough_common/robot_state.h"
 #include "tough_common/robot_description.h"
+#include "navigation_common/dynamic_distance_map.h"
+#include "navigation_common/map_snapshot.h"
+#include "navigation_common/occupancy_quadtree.h"
+#include <std_msgs/UInt8MultiArray.h>
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 
 
 enum CELL_STATUS{
@@ -40,7 +48,54 @@ private:
     void clearCurrentPoseCB(const std_msgs::Empty &msg);
     void convertToOccupancyGrid(const sensor_msgs::PointCloud2Ptr msg);
     void updatePointsToBlock(const sensor_msgs::PointCloud2Ptr msg);
+    void clearFreeSpaceCB(const sensor_msgs::PointCloud2ConstPtr &msg);
     void timerCallback(const ros::TimerEvent& e);
+    void clearedPublishCallback(const ros::TimerEvent& e);
+
+    /**
+     * @brief rebuilds the distance map and the quadtree from the occupancy grid, called with mtx locked
+     */
+    void resetLayers();
+
+    /**
+     * @brief changes a cell of the occupancy grid and of the layers built from it, called with mtx locked
+     * @return false if the cell already had that status
+     */
+    bool setCell(size_t index, CELL_STATUS status);
+
+    /**
+     * @brief propagates the cells changed in the occupancy grid and copies the distances that changed
+     * to the distance grid, called with mtx locked
+     */
+    void updateDistanceMap();
+    static bool isObstacle(int8_t value);
+    void publishQuadtree();
+
+    /**
+     * @brief collects the cells where the rays from the sensor to the ground points of a laser scan pass close
+     * to the ground, for the points within the raytrace range. The rays are split between threads, each writing its own list
+     * of cells.
+     * @param cloudToMap    transform of the scan to the map frame at the time of the scan
+     * @param origin        position of the sensor in the map frame at the time of the scan
+     * @param ground        height of the ground under the robot
+     * @param cells         indices of the cells, a cell crossed by several rays is repeated
+     */
+    void traceFreeSpace(const sensor_msgs::PointCloud2 &cloud, const tf::Transform &cloudToMap, const tf::Vector3 &origin,
+                        double ground, std::vector<size_t> &cells) const;
+
+    /**
+     * @brief appends the cells of the line from (x0, y0) to (x1, y1), both ends included, where the height
+     * of the line, going from z0 to z1, is between minZ and maxZ
+     */
+    static void traceRay(int x0, int y0, float z0, int x1, int y1, float z1, float minZ, float maxZ,
+                         std::vector<size_t> &cells);
+
+    /**
+     * @brief saves the map every checkpoint period if it changed, runs in its own thread so that the
+     * callbacks are only blocked while the layers are copied
+     */
+    void checkpointLoop();
+    void saveSnapshot();
 
     ros::NodeHandle nh_;
     ros::Subscriber pointcloudSub_;
@@ -49,8 +104,34 @@ private:
     ros::Subscriber blockMapSub_;
     ros::Publisher  mapPub_;
     ros::Publisher  visitedMapPub_;
+    ros::Publisher  distanceMapPub_;
+    ros::Publisher  quadtreePub_;
     nav_msgs::OccupancyGrid occGrid_;
     nav_msgs::OccupancyGrid visitedOccGrid_;
+    nav_msgs::OccupancyGrid distanceGrid_;      // distance to the closest obstacle, scaled to 0-100
+    DynamicDistanceMap* distanceMap_;
+    std::vector<size_t> changedCells_;
+    std::string sensorFrame_;                   // origin of the rays that clear the map
+    double raytraceRange_;                      // 0 to disable the clearing
+    double groundTolerance_;                    // points this far from the ground are not on it
+    double clearHeight_;                        // rays higher above the ground only pass over the cells
+    int raytraceThreads_;                       // 0 to use all the cores
+    std::atomic<bool> clearedChanged_;          // the scans cleared cells that are not published yet
+    ros::Timer clearedPublishTimer_;            // publishes the cells cleared by the scans at most once per period
+    tf::TransformListener tfListener_;
+    ros::Subscriber laserSub_;
+    OccupancyQuadtree quadtree_;                // multi resolution copy of occGrid_
+    std_msgs::UInt8MultiArray quadtreeMsg_;
+
+    std::string snapshotFile_;                  // empty to disable the snapshots
+    double checkpointPeriod_;
+    std::atomic<bool> mapChanged_;
+    std::vector<int8_t> snapshotOccupancy_;
+    std::vector<int8_t> snapshotVisited_;
+    std::thread checkpointThread_;
+    std::mutex checkpointMtx_;
+    std::condition_variable checkpointCv_;
+    bool stopCheckpoint_;
     sensor_msgs::PointCloud2 pointsToBlock_;
     ros::Timer timer_;
     RobotStateInformer* currentState_;
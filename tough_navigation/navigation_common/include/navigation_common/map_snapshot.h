@@ -0,0 +1,51 @@
+#ifndef MAP_SNAPSHOT_H
+#define MAP_SNAPSHOT_H
+
+#include <nav_msgs/MapMetaData.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief binary snapshot of the layers of the map generator. The file is a fixed header followed by the
+ * raw occupancy and visited layers, written through a memory mapping to a temporary file that is renamed
+ * over the snapshot so that a crash never leaves a partial snapshot behind.
+ */
+class MapSnapshot
+{
+public:
+    /**
+     * @brief writes the layers, both must have info.width*info.height cells
+     * @return false if the file could not be written
+     */
+    static bool save(const std::string &path, const nav_msgs::MapMetaData &info,
+                     const std::vector<int8_t> &occupancy, const std::vector<int8_t> &visited);
+
+    /**
+     * @brief reads the layers of a snapshot taken with the same geometry as info
+     * @return false if the file does not exist, is corrupted or has another geometry. The layers are
+     * untouched in that case.
+     */
+    static bool load(const std::string &path, const nav_msgs::MapMetaData &info,
+                     std::vector<int8_t> &occupancy, std::vector<int8_t> &visited);
+
+private:
+    static const char       MAGIC[8];
+    static const uint32_t   VERSION;
+
+    struct Header
+    {
+        char        magic[8];
+        uint32_t    version;
+        uint32_t    width;
+        uint32_t    height;
+        float       resolution;
+        double      origin_x;
+        double      origin_y;
+        uint64_t    checksum;   // FNV-1a of the layers
+    };
+
+    static uint64_t checksum(const int8_t *occupancy, const int8_t *visited, size_t cells);
+};
+
+#endif // MAP_SNAPSHOT_H
@@ -0,0 +1,121 @@
+#ifndef OCCUPANCY_QUADTREE_H
+#define OCCUPANCY_QUADTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief square block of cells visited by OccupancyQuadtree::traverse. value is the highest occupancy of
+ * the block, so a block with a free value is free everywhere.
+ */
+struct QuadtreeBlock
+{
+    int     x;          // lower corner in cells
+    int     y;
+    int     size;       // side in cells
+    int     depth;      // 0 at the root
+    int8_t  value;
+    bool    leaf;       // every cell of the block has this value
+};
+
+/**
+ * @brief multi resolution copy of an occupancy grid. Blocks whose cells all have the same value are
+ * stored as a single leaf, so open floor and unexplored space take a handful of nodes and only the
+ * borders of obstacles and walkways go down to the grid resolution. Every node keeps the highest value
+ * below it, which lets region queries stop at the first block that answers them. Cells outside the grid
+ * have outside_value.
+ */
+class OccupancyQuadtree
+{
+public:
+    OccupancyQuadtree();
+    ~OccupancyQuadtree();
+
+    /**
+     * @brief rebuilds the tree from a row major grid
+     */
+    void build(const std::vector<int8_t> &grid, int width, int height, float resolution,
+               float origin_x, float origin_y, int8_t outside_value);
+
+    /**
+     * @brief changes one cell, splitting and merging the blocks along its path
+     */
+    void setValue(int x, int y, int8_t value);
+    int8_t getValue(int x, int y) const;
+
+    /**
+     * @brief highest value of the cells in [x_min, x_max] x [y_min, y_max]
+     */
+    int8_t getMaxValue(int x_min, int y_min, int x_max, int y_max) const;
+
+    /**
+     * @return true if no cell of [x_min, x_max] x [y_min, y_max] has a value above threshold
+     */
+    bool isRegionFree(int x_min, int y_min, int x_max, int y_max, int8_t threshold) const;
+
+    /**
+     * @brief visits the blocks coarse to fine in depth first order
+     * @param fn called on each block, returns true to visit the children of a block that is not a leaf
+     */
+    void traverse(const std::function<bool(const QuadtreeBlock&)> &fn) const;
+
+    /**
+     * @brief cell of a point in the frame of the grid, can be outside of the grid
+     */
+    void worldToCell(float wx, float wy, int &x, int &y) const;
+
+    /**
+     * @brief compact preorder encoding of one byte per node after a small header
+     */
+    void serialize(std::vector<uint8_t> &buffer) const;
+    bool deserialize(const std::vector<uint8_t> &buffer);
+
+    size_t getNodeCount() const { return nodes_.size() - 4*free_blocks_.size(); }
+    int getWidth() const  { return width_; }
+    int getHeight() const { return height_; }
+
+private:
+    static const int32_t    NO_CHILDREN = -1;
+    static const uint8_t    INNER_NODE  = 0x80;     // never a valid occupancy value
+
+    struct Node
+    {
+        int32_t children;   // index of the first of the four children, ordered (x, y), (x+h, y), (x, y+h), (x+h, y+h)
+        int8_t  value;      // value of a leaf, highest value of the children otherwise
+    };
+
+    struct SerializedHeader
+    {
+        int32_t width;
+        int32_t height;
+        int32_t size;
+        float   resolution;
+        float   origin_x;
+        float   origin_y;
+        int8_t  outside_value;
+    };
+
+    int8_t buildNode(const std::vector<int8_t> &grid, int32_t node, int x, int y, int size);
+    int32_t allocateChildren(int8_t value);
+    int8_t maxValue(int32_t node, int x, int y, int size, int x_min, int y_min, int x_max, int y_max) const;
+    bool hasValueAbove(int32_t node, int x, int y, int size, int x_min, int y_min, int x_max, int y_max,
+                       int8_t threshold) const;
+    void traverseNode(int32_t node, int x, int y, int size, int depth,
+                      const std::function<bool(const QuadtreeBlock&)> &fn) const;
+    bool clip(int &x_min, int &y_min, int &x_max, int &y_max) const;
+
+    int     width_;
+    int     height_;
+    int     size_;              // side of the root, power of two
+    float   resolution_;
+    float   origin_x_;
+    float   origin_y_;
+    int8_t  outside_value_;
+
+    std::vector<Node>       nodes_;         // root at 0, children in blocks of four
+    std::vector<int32_t>    free_blocks_;   // blocks of children released by merges
+};
+
+#endif // OCCUPANCY_QUADTREE_H
@@ -0,0 +1,246 @@
+#include "navigation_common/dynamic_distance_map.h"
+#include <algorithm>
+#include <cmath>
+
+const int32_t DynamicDistanceMap::NO_OBSTACLE;
+const int32_t DynamicDistanceMap::FAR_DISTANCE;
+
+DynamicDistanceMap::DynamicDistanceMap(int width, int height, float resolution, float max_distance):
+    width_(width), height_(height), resolution_(resolution), next_bucket_(0), queued_(0)
+{
+    const int32_t max_cells = std::max(1, static_cast<int>(std::ceil(max_distance/resolution)));
+    max_sq_distance_ = max_cells*max_cells;
+    buckets_.resize(max_sq_distance_ + 1);
+
+    Cell free_cell;
+    free_cell.obstacle    = NO_OBSTACLE;
+    free_cell.sq_distance = FAR_DISTANCE;
+    free_cell.raise       = false;
+    free_cell.state       = NOT_QUEUED;
+    cells_.assign(static_cast<size_t>(width_)*height_, free_cell);
+    changed_.assign(cells_.size(), 0);
+}
+
+DynamicDistanceMap::~DynamicDistanceMap()
+{
+}
+
+void DynamicDistanceMap::push(int32_t sq_distance, size_t index)
+{
+    const size_t bucket = std::min(sq_distance, max_sq_distance_);
+    buckets_[bucket].push_back(index);
+    next_bucket_ = std::min(next_bucket_, bucket);
+    ++queued_;
+}
+
+bool DynamicDistanceMap::pop(size_t &index)
+{
+    if(queued_ == 0)
+        return false;
+    while(buckets_[next_bucket_].empty())
+        ++next_bucket_;
+    index = buckets_[next_bucket_].back();
+    buckets_[next_bucket_].pop_back();
+    --queued_;
+    return true;
+}
+
+void DynamicDistanceMap::markChanged(size_t index)
+{
+    if(changed_[index])
+        return;
+    changed_[index] = 1;
+    changed_cells_.push_back(index);
+}
+
+void DynamicDistanceMap::reset(const std::vector<int8_t> &grid, const std::function<bool(int8_t)> &is_obstacle)
+{
+    for(auto &bucket : buckets_)
+        bucket.clear();
+    next_bucket_ = 0;
+    queued_      = 0;
+    for(size_t changed : changed_cells_)
+        changed_[changed] = 0;
+    changed_cells_.clear();
+
+    for(size_t i = 0; i < cells_.size(); ++i)
+    {
+        Cell &cell = cells_[i];
+        const bool obstacle = is_obstacle(grid[i]);
+        cell.obstacle    = obstacle ? static_cast<int32_t>(i) : NO_OBSTACLE;
+        cell.sq_distance = obstacle ? 0 : FAR_DISTANCE;
+        cell.raise       = false;
+        cell.state       = NOT_QUEUED;
+    }
+
+    // only the obstacles next to a free cell can lower a distance
+    for(int y = 0; y < height_; ++y)
+    {
+        for(int x = 0; x < width_; ++x)
+        {
+            const size_t index = static_cast<size_t>(y)*width_ + x;
+            if(cells_[index].obstacle != static_cast<int32_t>(index))
+                continue;
+            bool border = false;
+            for(int ny = std::max(0, y - 1); ny <= std::min(height_ - 1, y + 1) && !border; ++ny)
+            {
+                for(int nx = std::max(0, x - 1); nx <= std::min(width_ - 1, x + 1) && !border; ++nx)
+                {
+                    border = cells_[static_cast<size_t>(ny)*width_ + nx].obstacle == NO_OBSTACLE;
+                }
+            }
+            if(border)
+            {
+                cells_[index].state = QUEUED;
+                push(0, index);
+            }
+        }
+    }
+    update();
+}
+
+void DynamicDistanceMap::setObstacle(size_t index)
+{
+    Cell &cell = cells_[index];
+    if(cell.obstacle == static_cast<int32_t>(index))
+        return;
+    if(cell.sq_distance != 0)
+        markChanged(index);
+    cell.obstacle    = index;
+    cell.sq_distance = 0;
+    cell.raise       = false;
+    cell.state       = QUEUED;
+    push(0, index);
+}
+
+void DynamicDistanceMap::removeObstacle(size_t index)
+{
+    Cell &cell = cells_[index];
+    if(cell.obstacle != static_cast<int32_t>(index))
+        return;
+    markChanged(index);
+    cell.obstacle    = NO_OBSTACLE;
+    cell.sq_distance = FAR_DISTANCE;
+    cell.raise       = true;
+    cell.state       = QUEUED;
+    push(0, index);
+}
+
+/**
+ * @note clears the neighbours whose closest obstacle was removed and queues the ones whose obstacle
+ * still exists, they start the lower wave that refills the cleared cells
+ */
+void DynamicDistanceMap::raise(size_t index)
+{
+    const int x = index % width_;
+    const int y = index / width_;
+    for(int ny = std::max(0, y - 1); ny <= std::min(height_ - 1, y + 1); ++ny)
+    {
+        for(int nx = std::max(0, x - 1); nx <= std::min(width_ - 1, x + 1); ++nx)
+        {
+            const size_t n_index = static_cast<size_t>(ny)*width_ + nx;
+            Cell &neighbour = cells_[n_index];
+            if(neighbour.obstacle == NO_OBSTACLE || neighbour.raise)
+                continue;
+
+            if(cells_[neighbour.obstacle].obstacle != neighbour.obstacle)
+            {
+                push(neighbour.sq_distance, n_index);
+                markChanged(n_index);
+                neighbour.state       = QUEUED;
+                neighbour.raise       = true;
+                neighbour.obstacle    = NO_OBSTACLE;
+                neighbour.sq_distance = FAR_DISTANCE;
+            }
+            else if(neighbour.state != QUEUED)
+            {
+                push(neighbour.sq_distance, n_index);
+                neighbour.state = QUEUED;
+            }
+        }
+    }
+    cells_[index].raise = false;
+    cells_[index].state = PROCESSED;
+}
+
+void DynamicDistanceMap::lower(size_t index)
+{
+    Cell &cell = cells_[index];
+    cell.state = PROCESSED;
+
+    const int x  = index % width_;
+    const int y  = index / width_;
+    const int ox = cell.obstacle % width_;
+    const int oy = cell.obstacle / width_;
+    for(int ny = std::max(0, y - 1); ny <= std::min(height_ - 1, y + 1); ++ny)
+    {
+        for(int nx = std::max(0, x - 1); nx <= std::min(width_ - 1, x + 1); ++nx)
+        {
+            const size_t n_index = static_cast<size_t>(ny)*width_ + nx;
+            Cell &neighbour = cells_[n_index];
+            if(neighbour.raise)
+                continue;
+
+            const int32_t sq_distance = (nx - ox)*(nx - ox) + (ny - oy)*(ny - oy);
+            if(sq_distance > max_sq_distance_)
+                continue;
+            bool overwrite = sq_distance < neighbour.sq_distance;
+            if(!overwrite && sq_distance == neighbour.sq_distance)
+            {
+                overwrite = neighbour.obstacle == NO_OBSTACLE ||
+                            cells_[neighbour.obstacle].obstacle != neighbour.obstacle;
+            }
+            if(overwrite)
+            {
+                if(sq_distance != neighbour.sq_distance)
+                    markChanged(n_index);
+                push(sq_distance, n_index);
+                neighbour.state       = QUEUED;
+                neighbour.sq_distance = sq_distance;
+                neighbour.obstacle    = cell.obstacle;
+            }
+        }
+    }
+}
+
+void DynamicDistanceMap::update(std::vector<size_t> *changed_cells)
+{
+    size_t index;
+    while(pop(index))
+    {
+        Cell &cell = cells_[index];
+        if(cell.state == PROCESSED)
+            continue;
+
+        if(cell.raise)
+        {
+            raise(index);
+        }
+        else if(cell.obstacle != NO_OBSTACLE && cells_[cell.obstacle].obstacle == cell.obstacle)
+        {
+            lower(index);
+        }
+        else
+        {
+            cell.state = PROCESSED;
+        }
+    }
+
+    for(size_t changed : changed_cells_)
+        changed_[changed] = 0;
+    if(changed_cells != nullptr)
+        changed_cells->swap(changed_cells_);
+    changed_cells_.clear();
+}
+
+float DynamicDistanceMap::getDistance(size_t index) const
+{
+    const int32_t sq_distance = std::min(cells_[index].sq_distance, max_sq_distance_);
+    return std::sqrt(static_cast<float>(sq_distance))*resolution_;
+}
+
+int8_t DynamicDistanceMap::getScaledDistance(size_t index) const
+{
+    const int32_t sq_distance = std::min(cells_[index].sq_distance, max_sq_distance_);
+    return static_cast<int8_t>(std::lround(100.0*std::sqrt(static_cast<double>(sq_distance)/max_sq_distance_)));
+}
@@ -0,0 +1,250 @@
+#include "navigation_common/elevation_map.h"
+#include "tough_common/parallel_for.h"
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+ElevationMap::ElevationMap(const ElevationMapParams &params):
+    params_(params)
+{
+    width_  = std::max(1, static_cast<int>(std::ceil(params_.length_x/params_.resolution)));
+    height_ = std::max(1, static_cast<int>(std::ceil(params_.length_y/params_.resolution)));
+    clear();
+}
+
+ElevationMap::~ElevationMap()
+{
+}
+
+void ElevationMap::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t size = static_cast<size_t>(width_)*height_;
+    elevation_.assign(size, std::numeric_limits<float>::quiet_NaN());
+    variance_.assign(size, std::numeric_limits<float>::infinity());
+    update_time_.assign(size, 0.0);
+    slope_.assign(size, std::numeric_limits<float>::quiet_NaN());
+    roughness_.assign(size, std::numeric_limits<float>::quiet_NaN());
+}
+
+bool ElevationMap::toCell(float x, float y, int &col, int &row) const
+{
+    col = static_cast<int>(std::floor((x - params_.origin_x)/params_.resolution));
+    row = static_cast<int>(std::floor((y - params_.origin_y)/params_.resolution));
+    return col >= 0 && col < width_ && row >= 0 && row < height_;
+}
+
+/**
+ * @note the cells of the points are computed first and bucketed by band of rows, then every thread fuses
+ * the points of its own band so that no two threads write the same cell.
+ */
+size_t ElevationMap::update(const sensor_msgs::PointCloud2 &cloud)
+{
+    const size_t num_points = static_cast<size_t>(cloud.width)*cloud.height;
+    if(num_points == 0)
+        return 0;
+
+    std::vector<int>   cells;
+    std::vector<float> heights;
+    cells.reserve(num_points);
+    heights.reserve(num_points);
+
+    int min_col = width_, min_row = height_, max_col = -1, max_row = -1;
+    sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+    for(; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z)
+    {
+        int col, row;
+        if(!std::isfinite(*iter_z) || !toCell(*iter_x, *iter_y, col, row))
+            continue;
+        cells.push_back(row*width_ + col);
+        heights.push_back(*iter_z);
+        min_col = std::min(min_col, col);
+        max_col = std::max(max_col, col);
+        min_row = std::min(min_row, row);
+        max_row = std::max(max_row, row);
+    }
+    if(cells.empty())
+        return 0;
+
+    // bucket the points by band of rows, one band per thread
+    int num_bands = params_.num_threads > 0 ? params_.num_threads : std::thread::hardware_concurrency();
+    num_bands = std::max(1, std::min(num_bands, max_row - min_row + 1));
+    const int rows_per_band = (max_row - min_row + num_bands)/num_bands;
+    std::vector<size_t> band_begin(num_bands + 1, 0);
+    for(int cell : cells)
+        ++band_begin[(cell/width_ - min_row)/rows_per_band + 1];
+    for(int band = 0; band < num_bands; ++band)
+        band_begin[band + 1] += band_begin[band];
+    std::vector<size_t> order(cells.size());
+    std::vector<size_t> fill(band_begin.begin(), band_begin.end() - 1);
+    for(size_t i = 0; i < cells.size(); ++i)
+        order[fill[(cells[i]/width_ - min_row)/rows_per_band]++] = i;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const float  meas_var = params_.measurement_variance;
+    const float  gate     = params_.mahalanobis_threshold;
+    const double stamp    = cloud.header.stamp.toSec();
+    parallelFor(params_.num_threads, 0, num_bands, [&](int first_band, int last_band)
+    {
+        for(size_t k = band_begin[first_band]; k < band_begin[last_band]; ++k)
+        {
+            const int cell = cells[order[k]];
+            float &h   = elevation_[cell];
+            float &var = variance_[cell];
+            const float z = heights[order[k]];
+            if(!std::isnan(h) && stamp > update_time_[cell])
+            {
+                // the surface may have changed since the cell was last seen
+                var = std::min(params_.max_variance,
+                               var + params_.variance_growth*static_cast<float>(stamp - update_time_[cell]));
+            }
+            update_time_[cell] = std::max(update_time_[cell], stamp);
+
+            if(std::isnan(h) || var >= params_.max_variance || z - h > gate*std::sqrt(var))
+            {
+                // first observation, a cell that is no longer trusted or a new object on top of the cell
+                h   = z;
+                var = meas_var;
+            }
+            else if(h - z <= gate*std::sqrt(var))
+            {
+                h   = (var*z + meas_var*h)/(var + meas_var);
+                var = std::max(params_.min_variance, var*meas_var/(var + meas_var));
+            }
+            else
+            {
+                // measurements well below the cell are mostly occluded returns of the surface underneath and are
+                // not fused, but each one doubles the variance so that about ten consistent ones bring the cell
+                // down while the returns of the surface in between bring the variance back
+                var = std::min(params_.max_variance, 2.0f*var);
+            }
+        }
+    });
+
+    updateDerivedLayers(min_col, min_row, max_col, max_row);
+    return cells.size();
+}
+
+/**
+ * @note the slope is the angle of the gradient from central differences and the roughness is the standard
+ * deviation of the known heights of the 3x3 neighbourhood. Both need the neighbours of the updated cells.
+ */
+void ElevationMap::updateDerivedLayers(int min_col, int min_row, int max_col, int max_row)
+{
+    min_col = std::max(0, min_col - 1);
+    min_row = std::max(0, min_row - 1);
+    max_col = std::min(width_ - 1, max_col + 1);
+    max_row = std::min(height_ - 1, max_row + 1);
+
+    const float resolution = params_.resolution;
+    parallelFor(params_.num_threads, min_row, max_row + 1, [&](int row_begin, int row_end)
+    {
+        for(int row = row_begin; row < row_end; ++row)
+        {
+            for(int col = min_col; col <= max_col; ++col)
+            {
+                const int cell = row*width_ + col;
+                if(std::isnan(elevation_[cell]))
+                    continue;
+
+                float sum = 0.0f, sum_sq = 0.0f;
+                int   count = 0;
+                for(int r = std::max(0, row - 1); r <= std::min(height_ - 1, row + 1); ++r)
+                {
+                    for(int c = std::max(0, col - 1); c <= std::min(width_ - 1, col + 1); ++c)
+                    {
+                        const float h = elevation_[r*width_ + c];
+                        if(std::isnan(h))
+                            continue;
+                        sum    += h;
+                        sum_sq += h*h;
+                        ++count;
+                    }
+                }
+                const float mean = sum/count;
+                roughness_[cell] = std::sqrt(std::max(0.0f, sum_sq/count - mean*mean));
+
+                // one sided differences where a neighbour is unknown or outside the map
+                auto gradient = [&](int dc, int dr)
+                {
+                    const int c0 = col - dc, r0 = row - dr, c1 = col + dc, r1 = row + dr;
+                    const bool has_prev = c0 >= 0 && r0 >= 0 && !std::isnan(elevation_[r0*width_ + c0]);
+                    const bool has_next = c1 < width_ && r1 < height_ && !std::isnan(elevation_[r1*width_ + c1]);
+                    if(has_prev && has_next)
+                        return (elevation_[r1*width_ + c1] - elevation_[r0*width_ + c0])/(2.0f*resolution);
+                    if(has_next)
+                        return (elevation_[r1*width_ + c1] - elevation_[cell])/resolution;
+                    if(has_prev)
+                        return (elevation_[cell] - elevation_[r0*width_ + c0])/resolution;
+                    return 0.0f;
+                };
+                const float gx = gradient(1, 0);
+                const float gy = gradient(0, 1);
+                slope_[cell] = std::atan(std::sqrt(gx*gx + gy*gy));
+            }
+        }
+    });
+}
+
+bool ElevationMap::getCell(float x, float y, float &elevation, float &variance, float &slope, float &roughness) const
+{
+    int col, row;
+    if(!toCell(x, y, col, row))
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int cell = row*width_ + col;
+    if(std::isnan(elevation_[cell]))
+        return false;
+    elevation = elevation_[cell];
+    variance  = variance_[cell];
+    slope     = slope_[cell];
+    roughness = roughness_[cell];
+    return true;
+}
+
+bool ElevationMap::getSubmap(float center_x, float center_y, float length_x, float length_y, ElevationSubmap &submap) const
+{
+    int min_col = static_cast<int>(std::floor((center_x - length_x/2 - params_.origin_x)/params_.resolution));
+    int min_row = static_cast<int>(std::floor((center_y - length_y/2 - params_.origin_y)/params_.resolution));
+    int max_col = static_cast<int>(std::floor((center_x + length_x/2 - params_.origin_x)/params_.resolution));
+    int max_row = static_cast<int>(std::floor((center_y + length_y/2 - params_.origin_y)/params_.resolution));
+    min_col = std::max(0, min_col);
+    min_row = std::max(0, min_row);
+    max_col = std::min(width_ - 1, max_col);
+    max_row = std::min(height_ - 1, max_row);
+    if(min_col > max_col || min_row > max_row)
+        return false;
+
+    submap.resolution = params_.resolution;
+    submap.origin_x   = params_.origin_x + min_col*params_.resolution;
+    submap.origin_y   = params_.origin_y + min_row*params_.resolution;
+    submap.width      = max_col - min_col + 1;
+    submap.height     = max_row - min_row + 1;
+
+    const size_t size = static_cast<size_t>(submap.width)*submap.height;
+    submap.elevation.resize(size);
+    submap.variance.resize(size);
+    submap.slope.resize(size);
+    submap.roughness.resize(size);
+
+    // rows are contiguous in every layer
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t row_bytes = submap.width*sizeof(float);
+    for(int row = 0; row < submap.height; ++row)
+    {
+        const size_t src = static_cast<size_t>(min_row + row)*width_ + min_col;
+        const size_t dst = static_cast<size_t>(row)*submap.width;
+        std::memcpy(&submap.elevation[dst], &elevation_[src], row_bytes);
+        std::memcpy(&submap.variance[dst],  &variance_[src],  row_bytes);
+        std::memcpy(&submap.slope[dst],     &slope_[src],     row_bytes);
+        std::memcpy(&submap.roughness[dst], &roughness_[src], row_bytes);
+    }
+    return true;
+}
@@ -0,0 +1,133 @@
+#include "navigation_common/elevation_map.h"
+#include <tough_common/tough_common_names.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <std_msgs/Empty.h>
+#include <tf/transform_listener.h>
+#include <cmath>
+
+/**
+ * @note publishes the known cells of the map as a cloud with the layers as extra fields
+ */
+void publishMap(const ElevationMap &map, const std::string &frame_id, ros::Publisher &pub)
+{
+    const ElevationMapParams &params = map.getParams();
+    ElevationSubmap submap;
+    if(!map.getSubmap(params.origin_x + params.length_x/2, params.origin_y + params.length_y/2,
+                      params.length_x, params.length_y, submap))
+        return;
+
+    sensor_msgs::PointCloud2 cloud;
+    cloud.header.frame_id = frame_id;
+    cloud.header.stamp    = ros::Time::now();
+    sensor_msgs::PointCloud2Modifier modifier(cloud);
+    modifier.setPointCloud2Fields(6, "x", 1, sensor_msgs::PointField::FLOAT32,
+                                     "y", 1, sensor_msgs::PointField::FLOAT32,
+                                     "z", 1, sensor_msgs::PointField::FLOAT32,
+                                     "variance", 1, sensor_msgs::PointField::FLOAT32,
+                                     "slope", 1, sensor_msgs::PointField::FLOAT32,
+                                     "roughness", 1, sensor_msgs::PointField::FLOAT32);
+
+    size_t known = 0;
+    for(float h : submap.elevation)
+        known += std::isnan(h) ? 0 : 1;
+    modifier.resize(known);
+
+    sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+    sensor_msgs::PointCloud2Iterator<float> iter_var(cloud, "variance");
+    sensor_msgs::PointCloud2Iterator<float> iter_slope(cloud, "slope");
+    sensor_msgs::PointCloud2Iterator<float> iter_rough(cloud, "roughness");
+    for(int row = 0; row < submap.height; ++row)
+    {
+        for(int col = 0; col < submap.width; ++col)
+        {
+            const size_t cell = static_cast<size_t>(row)*submap.width + col;
+            if(std::isnan(submap.elevation[cell]))
+                continue;
+            *iter_x     = submap.origin_x + (col + 0.5f)*submap.resolution;
+            *iter_y     = submap.origin_y + (row + 0.5f)*submap.resolution;
+            *iter_z     = submap.elevation[cell];
+            *iter_var   = submap.variance[cell];
+            *iter_slope = submap.slope[cell];
+            *iter_rough = submap.roughness[cell];
+            ++iter_x; ++iter_y; ++iter_z; ++iter_var; ++iter_slope; ++iter_rough;
+        }
+    }
+    pub.publish(cloud);
+}
+
+int main(int argc, char** argv) {
+    ros::init(argc, argv, "elevation_map");
+    ros::NodeHandle n;
+    ros::NodeHandle pnh("~");
+
+    ElevationMapParams params;
+    std::string frame_id;
+    double publish_period;
+    pnh.param<std::string>("frame_id", frame_id, TOUGH_COMMON_NAMES::WORLD_TF);
+    pnh.param<float>("resolution", params.resolution, params.resolution);
+    pnh.param<float>("length_x", params.length_x, params.length_x);
+    pnh.param<float>("length_y", params.length_y, params.length_y);
+    pnh.param<float>("origin_x", params.origin_x, params.origin_x);
+    pnh.param<float>("origin_y", params.origin_y, params.origin_y);
+    pnh.param<float>("measurement_variance", params.measurement_variance, params.measurement_variance);
+    pnh.param<float>("mahalanobis_threshold", params.mahalanobis_threshold, params.mahalanobis_threshold);
+    pnh.param<float>("min_variance", params.min_variance, params.min_variance);
+    pnh.param<float>("variance_growth", params.variance_growth, params.variance_growth);
+    pnh.param<float>("max_variance", params.max_variance, params.max_variance);
+    pnh.param<int>("num_threads", params.num_threads, params.num_threads);
+    pnh.param<double>("publish_period", publish_period, 1.0);
+
+    ElevationMap map(params);
+    tf::TransformListener listener;
+    ros::Publisher map_pub = n.advertise<sensor_msgs::PointCloud2>("elevation_map", 1, true);
+
+    ros::Subscriber cloud_sub = n.subscribe<sensor_msgs::PointCloud2>("filtered_cloud2", 1,
+            [&](const sensor_msgs::PointCloud2ConstPtr &msg)
+            {
+                if(msg->header.frame_id == frame_id || ("/" + msg->header.frame_id) == frame_id)
+                {
+                    map.update(*msg);
+                    return;
+                }
+
+                tf::StampedTransform transform;
+                try
+                {
+                    listener.waitForTransform(frame_id, msg->header.frame_id, msg->header.stamp, ros::Duration(0.5));
+                    listener.lookupTransform(frame_id, msg->header.frame_id, msg->header.stamp, transform);
+                }
+                catch(tf::TransformException &ex)
+                {
+                    ROS_WARN("elevation_map: %s", ex.what());
+                    return;
+                }
+
+                sensor_msgs::PointCloud2 cloud = *msg;
+                sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
+                sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
+                sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
+                for(; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z)
+                {
+                    tf::Vector3 pt = transform*tf::Vector3(*iter_x, *iter_y, *iter_z);
+                    *iter_x = pt.x();
+                    *iter_y = pt.y();
+                    *iter_z = pt.z();
+                }
+                map.update(cloud);
+            });
+
+    ros::Subscriber reset_sub = n.subscribe<std_msgs::Empty>("reset_map", 1,
+            [&](const std_msgs::EmptyConstPtr &) { map.clear(); });
+
+    ros::Timer publish_timer = n.createTimer(ros::Duration(publish_period),
+            [&](const ros::TimerEvent &)
+            {
+                if(map_pub.getNumSubscribers() > 0)
+                    publishMap(map, frame_id, map_pub);
+            });
+
+    ros::spin();
+    return 0;
+}
@@ -1,5 +1,9 @@
 #include "navigation_common/map_generator.h"
 #include <tough_common/tough_common_names.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 
 
 const float MapGenerator::MAP_RESOLUTION = 0.05f;
@@ -34,8 +38,12 @@ void MapGenerator::trimTo2DecimalPlaces(float &x, float &y) {
     return;
 }
 
+bool MapGenerator::isObstacle(int8_t value) {
+    return value == OCCUPIED || value == BLOCKED;
+}
+
 
-MapGenerator::MapGenerator(ros::NodeHandle &n):nh_(n) {
+MapGenerator::MapGenerator(ros::NodeHandle &n):nh_(n), clearedChanged_(false), mapChanged_(false), stopCheckpoint_(false) {
 
     currentState_  = RobotStateInformer::getRobotStateInformer(nh_);
     rd_ = RobotDescription::getRobotDescription(nh_);
@@ -54,6 +62,16 @@ MapGenerator::MapGenerator(ros::NodeHandle &n):nh_(n) {
     std::fill(occGrid_.data.begin(), occGrid_.data.end(), OCCUPIED);
     visitedOccGrid_ = occGrid_;
 
+    // the snapshot brings back the map built before a restart. It is only kept when a file is given, a map of
+    // another run or another place would otherwise be restored
+    ros::param::param<std::string>("~snapshot_file", snapshotFile_, "");
+    ros::param::param<double>("~checkpoint_period", checkpointPeriod_, 10.0);
+    bool restored = !snapshotFile_.empty() &&
+                    MapSnapshot::load(snapshotFile_, occGrid_.info, occGrid_.data, visitedOccGrid_.data);
+    if(restored){
+        ROS_INFO("Restored the map from %s", snapshotFile_.c_str());
+    }
+
     geometry_msgs::Pose pelvisPose;
     currentState_->getCurrentPose(rd_->getPelvisFrame(),pelvisPose);
     ros::Duration(0.2).sleep();
@@ -67,30 +85,318 @@ MapGenerator::MapGenerator(ros::NodeHandle &n):nh_(n) {
     }
 
 
+    // distances are truncated at distance_map_max meters, which is 100 in the distance grid
+    double maxDistance;
+    ros::param::param<double>("~distance_map_max", maxDistance, 1.0);
+    // the filtered laser scans clear the cells where their rays skim the ground
+    ros::param::param<std::string>("~sensor_frame", sensorFrame_, TOUGH_COMMON_NAMES::HEAD_HOKUYO_FRAME_TF);
+    ros::param::param<double>("~raytrace_range", raytraceRange_, 4.0);
+    ros::param::param<double>("~raytrace_ground_tolerance", groundTolerance_, 0.05);
+    ros::param::param<double>("~raytrace_clear_height", clearHeight_, 0.05);
+    ros::param::param<int>("~raytrace_threads", raytraceThreads_, 0);
+    double raytracePublishPeriod;
+    ros::param::param<double>("~raytrace_publish_period", raytracePublishPeriod, 1.0);
+
+    distanceMap_  = new DynamicDistanceMap(MAP_WIDTH, MAP_HEIGHT, MAP_RESOLUTION, maxDistance);
+    distanceGrid_ = occGrid_;
+    resetLayers();
+
     pointcloudSub_       = nh_.subscribe("walkway", 10, &MapGenerator::convertToOccupancyGrid, this);   // add free cells by publishing to this topic
     resetMapSub_         = nh_.subscribe("reset_map", 10, &MapGenerator::resetMap, this);
     blockMapSub_         = nh_.subscribe("/block_map", 10, &MapGenerator::updatePointsToBlock, this);   // add permanent obstacles by publishing to this topic
     clearCurrentPoseSub_ = nh_.subscribe("map/clear_current_pose", 10, &MapGenerator::clearCurrentPoseCB, this);
+    if(raytraceRange_ > 0.0){
+        laserSub_        = nh_.subscribe("filtered_cloud2", 10, &MapGenerator::clearFreeSpaceCB, this);
+        // the map is published for the scans at this period instead of at the scan rate
+        clearedPublishTimer_ = nh_.createTimer(ros::Duration(raytracePublishPeriod), &MapGenerator::clearedPublishCallback, this);
+    }
 
     mapPub_        = nh_.advertise<nav_msgs::OccupancyGrid>("/map", 10, true);
     visitedMapPub_ = nh_.advertise<nav_msgs::OccupancyGrid>("/visited_map", 10, true);
+    distanceMapPub_ = nh_.advertise<nav_msgs::OccupancyGrid>("/distance_map", 10, true);
+    quadtreePub_    = nh_.advertise<std_msgs::UInt8MultiArray>("/map_quadtree", 10, true);
+    distanceMapPub_.publish(distanceGrid_);
+    publishQuadtree();
+    if(restored){
+        mapPub_.publish(occGrid_);
+        visitedMapPub_.publish(visitedOccGrid_);
+    }
 
     timer_         = nh_.createTimer(ros::Duration(2), &MapGenerator::timerCallback, this);
 
+    if(!snapshotFile_.empty() && checkpointPeriod_ > 0.0){
+        checkpointThread_ = std::thread(&MapGenerator::checkpointLoop, this);
+    }
 }
 
 MapGenerator::~MapGenerator() {
     pointcloudSub_.shutdown();
     resetMapSub_.shutdown();
     blockMapSub_.shutdown();
+    laserSub_.shutdown();
     timer_.stop();
+    clearedPublishTimer_.stop();
+
+    if(checkpointThread_.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(checkpointMtx_);
+            stopCheckpoint_ = true;
+        }
+        checkpointCv_.notify_one();
+        checkpointThread_.join();
+    }
+    // keeps what was mapped since the last checkpoint
+    if(!snapshotFile_.empty()){
+        saveSnapshot();
+    }
+    delete distanceMap_;
+}
+
+void MapGenerator::checkpointLoop() {
+    std::unique_lock<std::mutex> lock(checkpointMtx_);
+    while(!stopCheckpoint_){
+        checkpointCv_.wait_for(lock, std::chrono::duration<double>(checkpointPeriod_));
+        if(stopCheckpoint_){
+            break;
+        }
+        lock.unlock();
+        saveSnapshot();
+        lock.lock();
+    }
+}
+
+void MapGenerator::saveSnapshot() {
+    if(!mapChanged_.exchange(false)){
+        return;
+    }
+    mtx.lock();
+    snapshotOccupancy_ = occGrid_.data;
+    snapshotVisited_   = visitedOccGrid_.data;
+    mtx.unlock();
+
+    if(!MapSnapshot::save(snapshotFile_, occGrid_.info, snapshotOccupancy_, snapshotVisited_)){
+        mapChanged_ = true;
+    }
+}
+
+void MapGenerator::resetLayers() {
+    distanceMap_->reset(occGrid_.data, &MapGenerator::isObstacle);
+    for (size_t i = 0; i < distanceGrid_.data.size(); ++i){
+        distanceGrid_.data[i] = distanceMap_->getScaledDistance(i);
+    }
+    quadtree_.build(occGrid_.data, occGrid_.info.width, occGrid_.info.height, MAP_RESOLUTION,
+                    MAP_X_OFFSET, MAP_Y_OFFSET, OCCUPIED);
+}
+
+bool MapGenerator::setCell(size_t index, CELL_STATUS status) {
+    if (occGrid_.data.at(index) == status){
+        return false;
+    }
+    occGrid_.data[index] = status;
+    if (isObstacle(status)){
+        distanceMap_->setObstacle(index);
+    }
+    else{
+        distanceMap_->removeObstacle(index);
+    }
+    quadtree_.setValue(index % occGrid_.info.width, index / occGrid_.info.width, status);
+    return true;
+}
+
+void MapGenerator::publishQuadtree() {
+    // the encoding grows with the number of blocks, not with the area of the map
+    quadtree_.serialize(quadtreeMsg_.data);
+    quadtreePub_.publish(quadtreeMsg_);
+}
+
+void MapGenerator::updateDistanceMap() {
+    // only the cells around the changes are visited, not the whole map
+    distanceMap_->update(&changedCells_);
+    for (size_t index : changedCells_){
+        distanceGrid_.data[index] = distanceMap_->getScaledDistance(index);
+    }
+}
+
+void MapGenerator::traceRay(int x0, int y0, float z0, int x1, int y1, float z1, float minZ, float maxZ,
+                            std::vector<size_t> &cells) {
+    // integer Bresenham, the error term decides when to step along the minor axis. The height goes
+    // linearly along the major axis.
+    const int dx = std::abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    const int dy = -std::abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    const float dz = (z1 - z0)/std::max(1, std::max(dx, -dy));
+    int error = dx + dy;
+    float z = z0;
+    while (true){
+        if (z >= minZ && z <= maxZ){
+            cells.push_back(static_cast<size_t>(y0)*MAP_WIDTH + x0);
+        }
+        if (x0 == x1 && y0 == y1){
+            break;
+        }
+        const int error2 = 2*error;
+        if (error2 >= dy){
+            error += dy;
+            x0    += sx;
+        }
+        if (error2 <= dx){
+            error += dx;
+            y0    += sy;
+        }
+        z += dz;
+    }
+}
+
+/**
+ * @note a ray that passes a cell close to the ground shows that nothing stands on that cell. A ray that
+ * passes higher says nothing about low obstacles, so it does not clear the cell. Only the rays that end on
+ * the ground are traced: a ray that crosses the height of the ground and goes on looks into a drop, and a
+ * ray that ends on an obstacle does not get close to the ground.
+ */
+void MapGenerator::traceFreeSpace(const sensor_msgs::PointCloud2 &cloud, const tf::Transform &cloudToMap,
+                                  const tf::Vector3 &origin, double ground, std::vector<size_t> &cells) const {
+    cells.clear();
+
+    // points on the border are left out so that the indices of getIndex stay in the map
+    const float minX = MAP_X_OFFSET + MAP_RESOLUTION, maxX = MAP_X_OFFSET + (MAP_WIDTH - 1)*MAP_RESOLUTION;
+    const float minY = MAP_Y_OFFSET + MAP_RESOLUTION, maxY = MAP_Y_OFFSET + (MAP_HEIGHT - 1)*MAP_RESOLUTION;
+    auto inMap = [&](float x, float y){ return x >= minX && x < maxX && y >= minY && y < maxY; };
+    if (!inMap(origin.x(), origin.y())){
+        return;
+    }
+
+    const int width = occGrid_.info.width;
+    const size_t originIndex = getIndex(origin.x(), origin.y());
+    const int originX = originIndex % width, originY = originIndex / width;
+
+    struct RayEnd { int x, y; float z; };
+    const float minZ = ground - groundTolerance_, maxZ = ground + clearHeight_;
+    const double maxCells = raytraceRange_/MAP_RESOLUTION;
+    std::vector<RayEnd> ends;
+    sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+    for(; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z){
+        if (!std::isfinite(*iter_x) || !std::isfinite(*iter_y) || !std::isfinite(*iter_z)){
+            continue;
+        }
+        const tf::Vector3 point = cloudToMap*tf::Vector3(*iter_x, *iter_y, *iter_z);
+        if (point.z() < minZ || point.z() > maxZ || !inMap(point.x(), point.y())){
+            continue;
+        }
+        const size_t index = getIndex(point.x(), point.y());
+        const RayEnd end = {static_cast<int>(index % width), static_cast<int>(index / width), static_cast<float>(point.z())};
+        if (std::hypot(end.x - originX, end.y - originY) <= maxCells){
+            ends.push_back(end);
+        }
+    }
+    if (ends.empty()){
+        return;
+    }
+
+    int numThreads = raytraceThreads_ > 0 ? raytraceThreads_ : std::thread::hardware_concurrency();
+    numThreads = std::max(1, std::min<int>(numThreads, ends.size()));
+    std::vector<std::vector<size_t>> traced(numThreads);
+    auto trace = [&](int thread, size_t begin, size_t end){
+        for (size_t i = begin; i < end; ++i){
+            traceRay(originX, originY, origin.z(), ends[i].x, ends[i].y, ends[i].z, minZ, maxZ, traced[thread]);
+        }
+    };
+
+    const size_t chunk = (ends.size() + numThreads - 1)/numThreads;
+    if (numThreads == 1){
+        trace(0, 0, ends.size());
+    }
+    else{
+        std::vector<std::thread> workers;
+        workers.reserve(numThreads);
+        for (int t = 0; t < numThreads; ++t){
+            workers.emplace_back(trace, t, std::min(t*chunk, ends.size()), std::min((t + 1)*chunk, ends.size()));
+        }
+        for (auto &worker : workers){
+            worker.join();
+        }
+    }
+
+    cells.swap(traced[0]);
+    for (int t = 1; t < numThreads; ++t){
+        cells.insert(cells.end(), traced[t].begin(), traced[t].end());
+    }
+}
+
+void MapGenerator::clearFreeSpaceCB(const sensor_msgs::PointCloud2ConstPtr &msg) {
+    if (msg->data.empty()){
+        return;
+    }
+
+    // the rays start where the sensor was when the scan was taken. The spin thread does not wait for the
+    // transforms, a scan that comes before them is dropped
+    const std::string mapFrame = occGrid_.header.frame_id;
+    const ros::Time stamp = msg->header.stamp;
+    if (!tfListener_.canTransform(mapFrame, msg->header.frame_id, stamp) ||
+        !tfListener_.canTransform(mapFrame, sensorFrame_, stamp) ||
+        !tfListener_.canTransform(mapFrame, rd_->getLeftFootFrameName(), stamp) ||
+        !tfListener_.canTransform(mapFrame, rd_->getRightFootFrameName(), stamp)){
+        ROS_DEBUG_THROTTLE(5, "Dropped a scan whose transforms are not available yet");
+        return;
+    }
+    tf::StampedTransform cloudToMap, sensorToMap, leftFoot, rightFoot;
+    try{
+        tfListener_.lookupTransform(mapFrame, msg->header.frame_id, msg->header.stamp, cloudToMap);
+        tfListener_.lookupTransform(mapFrame, sensorFrame_, msg->header.stamp, sensorToMap);
+        tfListener_.lookupTransform(mapFrame, rd_->getLeftFootFrameName(), msg->header.stamp, leftFoot);
+        tfListener_.lookupTransform(mapFrame, rd_->getRightFootFrameName(), msg->header.stamp, rightFoot);
+    }
+    catch (tf::TransformException &ex){
+        ROS_WARN_THROTTLE(5, "Cannot clear the free space of the scan: %s", ex.what());
+        return;
+    }
+    const double ground = std::min(leftFoot.getOrigin().z(), rightFoot.getOrigin().z()) - rd_->getFootFrameOffset();
+
+    // the rays are traced before locking the map
+    std::vector<size_t> rayCells;
+    traceFreeSpace(*msg, cloudToMap, sensorToMap.getOrigin(), ground, rayCells);
+    if (rayCells.empty()){
+        return;
+    }
+
+    // blocked cells are kept as they were added on purpose
+    bool changed = false, visitedChanged = false;
+    mtx.lock();
+    for (size_t index : rayCells){
+        if(occGrid_.data[index] ==  OCCUPIED){
+            changed = setCell(index, FREE) || changed;
+        }
+        if(visitedOccGrid_.data[index] ==  OCCUPIED){
+            visitedOccGrid_.data[index] =  FREE;
+            visitedChanged = true;
+        }
+    }
+    if (changed){
+        updateDistanceMap();
+    }
+    mtx.unlock();
+    if (changed || visitedChanged){
+        mapChanged_ = true;
+    }
+    if (changed){
+        clearedChanged_ = true;
+    }
+}
+
+void MapGenerator::clearedPublishCallback(const ros::TimerEvent& e) {
+    if (!clearedChanged_.exchange(false)){
+        return;
+    }
+    mapPub_.publish(occGrid_);
+    distanceMapPub_.publish(distanceGrid_);
+    publishQuadtree();
 }
 
 void MapGenerator::resetMap(const std_msgs::Empty &msg) {
+    mtx.lock();
     std::fill(occGrid_.data.begin(), occGrid_.data.end(),  OCCUPIED);
     visitedOccGrid_ = occGrid_;
 
-    mtx.lock();
     for (float x = -0.5f; x < 0.5f; x += MAP_RESOLUTION/10){
         for (float y = -0.5f; y < 0.5f; y += MAP_RESOLUTION/10){
             geometry_msgs::Pose pelvisPose;
@@ -102,10 +408,14 @@ void MapGenerator::resetMap(const std_msgs::Empty &msg) {
             visitedOccGrid_.data.at(getIndex(pelvisPose.position.x, pelvisPose.position.y)) =  FREE;
         }
     }
+    resetLayers();
     mtx.unlock();
+    mapChanged_ = true;
     pointsToBlock_.data.clear();
     mapPub_.publish(occGrid_);
     visitedMapPub_.publish(visitedOccGrid_);
+    distanceMapPub_.publish(distanceGrid_);
+    publishQuadtree();
 }
 
 void MapGenerator::clearCurrentPoseCB(const std_msgs::Empty &msg)
@@ -118,11 +428,16 @@ void MapGenerator::clearCurrentPoseCB(const std_msgs::Empty &msg)
             pelvisPose.position.y = y;
             pelvisPose.orientation.w = 1.0f;
             currentState_->transformPose(pelvisPose, pelvisPose, rd_->getPelvisFrame(), TOUGH_COMMON_NAMES::WORLD_TF);
-            occGrid_.data.at(getIndex(pelvisPose.position.x + x, pelvisPose.position.y +y)) =  FREE;
+            size_t index = getIndex(pelvisPose.position.x + x, pelvisPose.position.y +y);
+            setCell(index, FREE);
         }
     }
+    updateDistanceMap();
     mtx.unlock();
+    mapChanged_ = true;
     mapPub_.publish(occGrid_);
+    distanceMapPub_.publish(distanceGrid_);
+    publishQuadtree();
 }
 
 void MapGenerator::timerCallback(const ros::TimerEvent& e){
@@ -131,13 +446,20 @@ void MapGenerator::timerCallback(const ros::TimerEvent& e){
     currentState_->getCurrentPose(rd_->getPelvisFrame(),pelvisPose);
 
     // mark a box of 1m X 1m around robot as visited area
+    bool changed = false;
     mtx.lock();
     for (float x = -0.5f; x < 0.5f; x += MAP_RESOLUTION/10){
         for (float y = -0.5f; y < 0.5f; y += MAP_RESOLUTION/10){
-            visitedOccGrid_.data.at(getIndex(pelvisPose.position.x + x, pelvisPose.position.y +y)) =  VISITED;
+            int8_t &cell = visitedOccGrid_.data.at(getIndex(pelvisPose.position.x + x, pelvisPose.position.y +y));
+            changed = changed || cell != VISITED;
+            cell = VISITED;
         }
     }
     mtx.unlock();
+    // a robot standing still does not trigger a checkpoint
+    if(changed){
+        mapChanged_ = true;
+    }
 
     visitedMapPub_.publish(visitedOccGrid_);
 }
@@ -155,16 +477,22 @@ void MapGenerator::convertToOccupancyGrid(const sensor_msgs::PointCloud2Ptr msg)
         float x = *iter_x;
         float y = *iter_y;
 
-        if(occGrid_.data.at(getIndex(x,y)) ==  OCCUPIED){
-            occGrid_.data.at(getIndex(x, y)) =  FREE;
+        size_t index = getIndex(x, y);
+
+        if(occGrid_.data.at(index) ==  OCCUPIED){
+            setCell(index, FREE);
         }
         //update visited map only if it is completely occupied. value = 50 means visited in that map
-        if(visitedOccGrid_.data.at(getIndex(x,y)) ==  OCCUPIED){
-            visitedOccGrid_.data.at(getIndex(x, y)) =  FREE;
+        if(visitedOccGrid_.data.at(index) ==  OCCUPIED){
+            visitedOccGrid_.data.at(index) =  FREE;
         }
-    }    
+    }
+    updateDistanceMap();
     mtx.unlock();
+    mapChanged_ = true;
     mapPub_.publish(occGrid_);
+    distanceMapPub_.publish(distanceGrid_);
+    publishQuadtree();
 
 }
 
@@ -179,11 +507,16 @@ void MapGenerator::updatePointsToBlock(const sensor_msgs::PointCloud2Ptr msg) {
             float x = *iter_x;
             float y = *iter_y;
 
-            if(occGrid_.data.at(getIndex(x,y)) ==  FREE){
-                occGrid_.data.at(getIndex(x, y)) =  BLOCKED;
+            size_t index = getIndex(x, y);
+            if(occGrid_.data.at(index) ==  FREE){
+                setCell(index, BLOCKED);
             }
         }
+        updateDistanceMap();
         mtx.unlock();
+        mapChanged_ = true;
     }
     mapPub_.publish(occGrid_);
+    distanceMapPub_.publish(distanceGrid_);
+    publishQuadtree();
 }
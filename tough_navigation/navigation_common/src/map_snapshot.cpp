@@ -0,0 +1,139 @@
+#include "navigation_common/map_snapshot.h"
+#include <ros/ros.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char      MapSnapshot::MAGIC[8] = {'T', 'O', 'U', 'G', 'H', 'M', 'A', 'P'};
+const uint32_t  MapSnapshot::VERSION  = 1;
+
+uint64_t MapSnapshot::checksum(const int8_t *occupancy, const int8_t *visited, size_t cells)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(const int8_t *layer : {occupancy, visited})
+    {
+        for(size_t i = 0; i < cells; ++i)
+        {
+            hash ^= static_cast<uint8_t>(layer[i]);
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+bool MapSnapshot::save(const std::string &path, const nav_msgs::MapMetaData &info,
+                       const std::vector<int8_t> &occupancy, const std::vector<int8_t> &visited)
+{
+    const size_t cells = static_cast<size_t>(info.width)*info.height;
+    if(occupancy.size() != cells || visited.size() != cells)
+    {
+        ROS_ERROR("MapSnapshot: layers do not match the map size");
+        return false;
+    }
+
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version    = VERSION;
+    header.width      = info.width;
+    header.height     = info.height;
+    header.resolution = info.resolution;
+    header.origin_x   = info.origin.position.x;
+    header.origin_y   = info.origin.position.y;
+    header.checksum   = checksum(occupancy.data(), visited.data(), cells);
+
+    const std::string tmp_path = path + ".tmp";
+    const size_t file_size = sizeof(Header) + 2*cells;
+    int fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        ROS_ERROR("MapSnapshot: cannot open %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+    if(ftruncate(fd, file_size) != 0)
+    {
+        ROS_ERROR("MapSnapshot: cannot resize %s: %s", tmp_path.c_str(), strerror(errno));
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+    {
+        ROS_ERROR("MapSnapshot: cannot map %s: %s", tmp_path.c_str(), strerror(errno));
+        return false;
+    }
+
+    char *out = static_cast<char*>(mapped);
+    std::memcpy(out, &header, sizeof(Header));
+    std::memcpy(out + sizeof(Header), occupancy.data(), cells);
+    std::memcpy(out + sizeof(Header) + cells, visited.data(), cells);
+    const bool synced = msync(mapped, file_size, MS_SYNC) == 0;
+    munmap(mapped, file_size);
+
+    if(!synced || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        ROS_ERROR("MapSnapshot: cannot write %s: %s", path.c_str(), strerror(errno));
+        unlink(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MapSnapshot::load(const std::string &path, const nav_msgs::MapMetaData &info,
+                       std::vector<int8_t> &occupancy, std::vector<int8_t> &visited)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    const size_t cells = static_cast<size_t>(info.width)*info.height;
+    const size_t file_size = sizeof(Header) + 2*cells;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != file_size)
+    {
+        ROS_WARN("MapSnapshot: %s does not have the size of the map, ignoring it", path.c_str());
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED)
+    {
+        ROS_ERROR("MapSnapshot: cannot map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    const char *in = static_cast<const char*>(mapped);
+    const int8_t *in_occupancy = reinterpret_cast<const int8_t*>(in + sizeof(Header));
+    const int8_t *in_visited   = in_occupancy + cells;
+    Header header;
+    std::memcpy(&header, in, sizeof(Header));
+
+    bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+                 header.width == info.width && header.height == info.height &&
+                 std::fabs(header.resolution - info.resolution) < 1e-6 &&
+                 std::fabs(header.origin_x - info.origin.position.x) < 1e-6 &&
+                 std::fabs(header.origin_y - info.origin.position.y) < 1e-6;
+    if(!valid)
+    {
+        ROS_WARN("MapSnapshot: %s was taken with another map geometry, ignoring it", path.c_str());
+    }
+    else if(header.checksum != checksum(in_occupancy, in_visited, cells))
+    {
+        ROS_WARN("MapSnapshot: %s is corrupted, ignoring it", path.c_str());
+        valid = false;
+    }
+    else
+    {
+        occupancy.assign(in_occupancy, in_occupancy + cells);
+        visited.assign(in_visited, in_visited + cells);
+    }
+    munmap(mapped, file_size);
+    return valid;
+}
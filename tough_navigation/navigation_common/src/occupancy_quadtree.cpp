@@ -0,0 +1,374 @@
+#include "navigation_common/occupancy_quadtree.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const int32_t OccupancyQuadtree::NO_CHILDREN;
+const uint8_t OccupancyQuadtree::INNER_NODE;
+
+OccupancyQuadtree::OccupancyQuadtree():
+    width_(0), height_(0), size_(1), resolution_(1.0f), origin_x_(0.0f), origin_y_(0.0f), outside_value_(0)
+{
+    nodes_.push_back(Node{NO_CHILDREN, 0});
+}
+
+OccupancyQuadtree::~OccupancyQuadtree()
+{
+}
+
+void OccupancyQuadtree::build(const std::vector<int8_t> &grid, int width, int height, float resolution,
+                              float origin_x, float origin_y, int8_t outside_value)
+{
+    width_         = width;
+    height_        = height;
+    resolution_    = resolution;
+    origin_x_      = origin_x;
+    origin_y_      = origin_y;
+    outside_value_ = outside_value;
+    size_ = 1;
+    while(size_ < width_ || size_ < height_)
+        size_ *= 2;
+
+    nodes_.clear();
+    free_blocks_.clear();
+    nodes_.push_back(Node{NO_CHILDREN, outside_value_});
+    if(static_cast<size_t>(width_)*height_ == grid.size())
+        buildNode(grid, 0, 0, 0, size_);
+}
+
+/**
+ * @note the children of a node are appended before its subtrees, so the subtree of a block that turns out
+ * to be uniform is always at the end of the nodes and is released by shrinking them
+ */
+int8_t OccupancyQuadtree::buildNode(const std::vector<int8_t> &grid, int32_t node, int x, int y, int size)
+{
+    if(x >= width_ || y >= height_)
+    {
+        nodes_[node] = Node{NO_CHILDREN, outside_value_};
+        return outside_value_;
+    }
+    if(size == 1)
+    {
+        const int8_t value = grid[static_cast<size_t>(y)*width_ + x];
+        nodes_[node] = Node{NO_CHILDREN, value};
+        return value;
+    }
+
+    const int half = size/2;
+    const int32_t first = nodes_.size();
+    nodes_.resize(first + 4);
+    int8_t values[4];
+    values[0] = buildNode(grid, first,     x,        y,        half);
+    values[1] = buildNode(grid, first + 1, x + half, y,        half);
+    values[2] = buildNode(grid, first + 2, x,        y + half, half);
+    values[3] = buildNode(grid, first + 3, x + half, y + half, half);
+
+    bool uniform = true;
+    for(int i = 0; i < 4 && uniform; ++i)
+        uniform = nodes_[first + i].children == NO_CHILDREN && values[i] == values[0];
+
+    if(uniform)
+    {
+        nodes_.resize(first);
+        nodes_[node] = Node{NO_CHILDREN, values[0]};
+        return values[0];
+    }
+    const int8_t value = *std::max_element(values, values + 4);
+    nodes_[node] = Node{first, value};
+    return value;
+}
+
+int32_t OccupancyQuadtree::allocateChildren(int8_t value)
+{
+    int32_t first;
+    if(!free_blocks_.empty())
+    {
+        first = free_blocks_.back();
+        free_blocks_.pop_back();
+    }
+    else
+    {
+        first = nodes_.size();
+        nodes_.resize(first + 4);
+    }
+    for(int i = 0; i < 4; ++i)
+        nodes_[first + i] = Node{NO_CHILDREN, value};
+    return first;
+}
+
+void OccupancyQuadtree::setValue(int x, int y, int8_t value)
+{
+    if(x < 0 || y < 0 || x >= width_ || y >= height_)
+        return;
+
+    // path from the root to the cell, split on the way down
+    int32_t path[32];
+    int depth = 0;
+    int32_t node = 0;
+    int size = size_;
+    int node_x = 0, node_y = 0;
+    while(true)
+    {
+        path[depth++] = node;
+        if(nodes_[node].children == NO_CHILDREN)
+        {
+            if(nodes_[node].value == value)
+                return;
+            if(size == 1)
+                break;
+            const int32_t first = allocateChildren(nodes_[node].value);
+            nodes_[node].children = first;
+        }
+        size /= 2;
+        const int quadrant = (x >= node_x + size ? 1 : 0) + (y >= node_y + size ? 2 : 0);
+        node_x += (quadrant & 1) ? size : 0;
+        node_y += (quadrant & 2) ? size : 0;
+        node = nodes_[node].children + quadrant;
+    }
+    nodes_[node].value = value;
+
+    // merge and update the highest values on the way up
+    for(int i = depth - 2; i >= 0; --i)
+    {
+        Node &parent = nodes_[path[i]];
+        const Node *children = &nodes_[parent.children];
+        bool uniform = true;
+        int8_t highest = children[0].value;
+        for(int c = 0; c < 4; ++c)
+        {
+            uniform = uniform && children[c].children == NO_CHILDREN && children[c].value == children[0].value;
+            highest = std::max(highest, children[c].value);
+        }
+        if(uniform)
+        {
+            free_blocks_.push_back(parent.children);
+            parent.children = NO_CHILDREN;
+        }
+        if(!uniform && parent.value == highest)
+            break;
+        parent.value = highest;
+    }
+}
+
+int8_t OccupancyQuadtree::getValue(int x, int y) const
+{
+    if(x < 0 || y < 0 || x >= width_ || y >= height_)
+        return outside_value_;
+
+    int32_t node = 0;
+    int size = size_;
+    int node_x = 0, node_y = 0;
+    while(nodes_[node].children != NO_CHILDREN)
+    {
+        size /= 2;
+        const int quadrant = (x >= node_x + size ? 1 : 0) + (y >= node_y + size ? 2 : 0);
+        node_x += (quadrant & 1) ? size : 0;
+        node_y += (quadrant & 2) ? size : 0;
+        node = nodes_[node].children + quadrant;
+    }
+    return nodes_[node].value;
+}
+
+bool OccupancyQuadtree::clip(int &x_min, int &y_min, int &x_max, int &y_max) const
+{
+    const bool outside = x_min < 0 || y_min < 0 || x_max >= width_ || y_max >= height_;
+    x_min = std::max(x_min, 0);
+    y_min = std::max(y_min, 0);
+    x_max = std::min(x_max, width_ - 1);
+    y_max = std::min(y_max, height_ - 1);
+    return outside;
+}
+
+int8_t OccupancyQuadtree::maxValue(int32_t node, int x, int y, int size,
+                                   int x_min, int y_min, int x_max, int y_max) const
+{
+    const Node &n = nodes_[node];
+    const bool inside = x >= x_min && y >= y_min && x + size - 1 <= x_max && y + size - 1 <= y_max;
+    if(n.children == NO_CHILDREN || inside)
+        return n.value;
+
+    const int half = size/2;
+    int8_t highest = INT8_MIN;
+    for(int c = 0; c < 4; ++c)
+    {
+        const int cx = x + ((c & 1) ? half : 0);
+        const int cy = y + ((c & 2) ? half : 0);
+        if(cx > x_max || cy > y_max || cx + half - 1 < x_min || cy + half - 1 < y_min)
+            continue;
+        // nothing below can raise the result any further
+        if(nodes_[n.children + c].value <= highest)
+            continue;
+        highest = std::max(highest, maxValue(n.children + c, cx, cy, half, x_min, y_min, x_max, y_max));
+    }
+    return highest;
+}
+
+int8_t OccupancyQuadtree::getMaxValue(int x_min, int y_min, int x_max, int y_max) const
+{
+    const bool outside = clip(x_min, y_min, x_max, y_max);
+    if(x_min > x_max || y_min > y_max)
+        return outside_value_;
+    const int8_t highest = maxValue(0, 0, 0, size_, x_min, y_min, x_max, y_max);
+    return outside ? std::max(highest, outside_value_) : highest;
+}
+
+bool OccupancyQuadtree::hasValueAbove(int32_t node, int x, int y, int size, int x_min, int y_min,
+                                      int x_max, int y_max, int8_t threshold) const
+{
+    const Node &n = nodes_[node];
+    if(n.value <= threshold)
+        return false;
+    const bool inside = x >= x_min && y >= y_min && x + size - 1 <= x_max && y + size - 1 <= y_max;
+    if(n.children == NO_CHILDREN || inside)
+        return true;
+
+    const int half = size/2;
+    for(int c = 0; c < 4; ++c)
+    {
+        const int cx = x + ((c & 1) ? half : 0);
+        const int cy = y + ((c & 2) ? half : 0);
+        if(cx > x_max || cy > y_max || cx + half - 1 < x_min || cy + half - 1 < y_min)
+            continue;
+        if(hasValueAbove(n.children + c, cx, cy, half, x_min, y_min, x_max, y_max, threshold))
+            return true;
+    }
+    return false;
+}
+
+bool OccupancyQuadtree::isRegionFree(int x_min, int y_min, int x_max, int y_max, int8_t threshold) const
+{
+    const bool outside = clip(x_min, y_min, x_max, y_max);
+    if(outside && outside_value_ > threshold)
+        return false;
+    if(x_min > x_max || y_min > y_max)
+        return true;
+    return !hasValueAbove(0, 0, 0, size_, x_min, y_min, x_max, y_max, threshold);
+}
+
+void OccupancyQuadtree::traverseNode(int32_t node, int x, int y, int size, int depth,
+                                     const std::function<bool(const QuadtreeBlock&)> &fn) const
+{
+    const Node &n = nodes_[node];
+    QuadtreeBlock block;
+    block.x     = x;
+    block.y     = y;
+    block.size  = size;
+    block.depth = depth;
+    block.value = n.value;
+    block.leaf  = n.children == NO_CHILDREN;
+    if(!fn(block) || block.leaf)
+        return;
+
+    const int half = size/2;
+    for(int c = 0; c < 4; ++c)
+    {
+        // the padding of the root beyond the grid is not part of the map
+        const int cx = x + ((c & 1) ? half : 0);
+        const int cy = y + ((c & 2) ? half : 0);
+        if(cx < width_ && cy < height_)
+            traverseNode(n.children + c, cx, cy, half, depth + 1, fn);
+    }
+}
+
+void OccupancyQuadtree::traverse(const std::function<bool(const QuadtreeBlock&)> &fn) const
+{
+    traverseNode(0, 0, 0, size_, 0, fn);
+}
+
+void OccupancyQuadtree::worldToCell(float wx, float wy, int &x, int &y) const
+{
+    x = static_cast<int>(std::floor((wx - origin_x_)/resolution_));
+    y = static_cast<int>(std::floor((wy - origin_y_)/resolution_));
+}
+
+void OccupancyQuadtree::serialize(std::vector<uint8_t> &buffer) const
+{
+    SerializedHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.width         = width_;
+    header.height        = height_;
+    header.size          = size_;
+    header.resolution    = resolution_;
+    header.origin_x      = origin_x_;
+    header.origin_y      = origin_y_;
+    header.outside_value = outside_value_;
+
+    buffer.resize(sizeof(header));
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    buffer.reserve(sizeof(header) + getNodeCount());
+
+    std::vector<int32_t> stack(1, 0);
+    while(!stack.empty())
+    {
+        const Node &n = nodes_[stack.back()];
+        stack.pop_back();
+        if(n.children == NO_CHILDREN)
+        {
+            buffer.push_back(static_cast<uint8_t>(n.value));
+            continue;
+        }
+        buffer.push_back(INNER_NODE);
+        for(int c = 3; c >= 0; --c)
+            stack.push_back(n.children + c);
+    }
+}
+
+bool OccupancyQuadtree::deserialize(const std::vector<uint8_t> &buffer)
+{
+    SerializedHeader header;
+    if(buffer.size() <= sizeof(header))
+        return false;
+    std::memcpy(&header, buffer.data(), sizeof(header));
+    if(header.size <= 0 || (header.size & (header.size - 1)) != 0 ||
+       header.width > header.size || header.height > header.size)
+        return false;
+
+    std::vector<Node> nodes(1, Node{NO_CHILDREN, 0});
+    std::vector<std::pair<int32_t, int>> stack(1, std::make_pair(0, header.size));   // node and its size
+    size_t pos = sizeof(header);
+    while(!stack.empty())
+    {
+        if(pos >= buffer.size())
+            return false;
+        const int32_t node = stack.back().first;
+        const int size     = stack.back().second;
+        stack.pop_back();
+        const uint8_t code = buffer[pos++];
+        if(code != INNER_NODE)
+        {
+            nodes[node] = Node{NO_CHILDREN, static_cast<int8_t>(code)};
+            continue;
+        }
+        if(size == 1)
+            return false;
+        const int32_t first = nodes.size();
+        nodes.resize(first + 4);
+        nodes[node].children = first;
+        for(int c = 3; c >= 0; --c)
+            stack.push_back(std::make_pair(first + c, size/2));
+    }
+    if(pos != buffer.size())
+        return false;
+
+    // the highest values are not serialized, children always come after their parent
+    for(int32_t i = nodes.size() - 1; i >= 0; --i)
+    {
+        if(nodes[i].children == NO_CHILDREN)
+            continue;
+        int8_t highest = nodes[nodes[i].children].value;
+        for(int c = 1; c < 4; ++c)
+            highest = std::max(highest, nodes[nodes[i].children + c].value);
+        nodes[i].value = highest;
+    }
+
+    width_         = header.width;
+    height_        = header.height;
+    size_          = header.size;
+    resolution_    = header.resolution;
+    origin_x_      = header.origin_x;
+    origin_y_      = header.origin_y;
+    outside_value_ = header.outside_value;
+    nodes_.swap(nodes);
+    free_blocks_.clear();
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef FOOTSTEP_VALIDATOR_H
+#define FOOTSTEP_VALIDATOR_H
+
+#include <ros/ros.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <sensor_msgs/PointCloud2.h>
+#include "ihmc_msgs/FootstepDataListRosMessage.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief parameters of the footstep validator. Lengths are in meters. The defaults are the atlas foot
+ * of config/footsteps_atlas.yaml.
+ */
+struct FootstepValidatorParams
+{
+    float   foot_length;
+    float   foot_width;
+    float   center_offset_x;        // center of the sole in the frame of the step location
+    float   center_offset_y;
+    float   sample_spacing;         // distance between the points sampled under a foot
+    float   min_support_ratio;      // fewest part of the sole that has to be supported
+    int     max_free_value;         // occupancy cells up to this value can support a foot
+    int     blocked_value;          // occupancy cells with this value are obstacles
+    float   max_height_error;       // elevation cells this close to the sole support it
+    float   max_obstacle_height;    // elevation cells higher above the sole collide with it
+
+    FootstepValidatorParams():
+        foot_length(0.26f), foot_width(0.16f), center_offset_x(0.045f), center_offset_y(0.0f),
+        sample_spacing(0.025f), min_support_ratio(0.8f), max_free_value(50), blocked_value(90),
+        max_height_error(0.03f), max_obstacle_height(0.04f)
+    {
+    }
+};
+
+/**
+ * @brief result of the validation of one step
+ */
+struct StepValidity
+{
+    float   support_ratio;  // part of the sole on walkable cells
+    bool    collision;      // the sole overlaps an obstacle
+    bool    valid;
+};
+
+/**
+ * @brief checks footsteps against the occupancy map and the elevation map. The sole of every step is
+ * sampled on a fixed pattern and all the samples of a list are transformed, looked up and classified
+ * in flat loops, so revalidating the rest of a plan on every map update takes tens of microseconds.
+ */
+class FootstepValidator
+{
+public:
+    FootstepValidator(const FootstepValidatorParams &params = FootstepValidatorParams());
+    ~FootstepValidator();
+
+    /**
+     * @brief reads the size of the sole and the shift of its center from the foot settings loaded for the
+     * footstep planner, the defaults are kept for missing ones
+     * @param ns namespace of the footstep planner parameters
+     */
+    static FootstepValidatorParams loadParams(const ros::NodeHandle &nh, const std::string &ns);
+
+    /**
+     * @brief sets the occupancy map, the message is shared and not copied
+     */
+    void setOccupancy(const nav_msgs::OccupancyGridConstPtr &grid);
+
+    /**
+     * @brief sets the elevation map from the cloud published by the elevation_map node
+     * @param resolution cell size of the elevation map
+     */
+    void setElevation(const sensor_msgs::PointCloud2 &cloud, float resolution);
+
+    /**
+     * @return true if a map was received
+     */
+    bool hasMap() const;
+
+    /**
+     * @brief validates the steps of a list from first_step on
+     * @param result one entry per validated step
+     * @return true if all the validated steps are valid
+     */
+    bool validate(const ihmc_msgs::FootstepDataListRosMessage &list, std::vector<StepValidity> &result,
+                  size_t first_step = 0) const;
+
+    const FootstepValidatorParams& getParams() const { return params_; }
+
+private:
+    FootstepValidatorParams params_;
+
+    // sole samples in the frame of the step location
+    std::vector<float> sample_x_;
+    std::vector<float> sample_y_;
+
+    nav_msgs::OccupancyGridConstPtr occupancy_;
+
+    // elevation grid, NaN where unknown
+    std::vector<float> elevation_;
+    int     elevation_width_;
+    int     elevation_height_;
+    float   elevation_origin_x_;
+    float   elevation_origin_y_;
+    float   elevation_resolution_;
+};
+
+#endif // FOOTSTEP_VALIDATOR_H
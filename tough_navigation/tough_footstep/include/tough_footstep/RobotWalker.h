@@ -6,6 +6,7 @@
 #include "ros/ros.h"
 #include"geometry_msgs/Pose2D.h"
 #include <humanoid_nav_msgs/PlanFootsteps.h>
+#include <humanoid_nav_msgs/PlanFootstepsBetweenFeet.h>
 #include "ihmc_msgs/FootstepDataListRosMessage.h"
 #include "ihmc_msgs/FootstepDataRosMessage.h"
 #include "ihmc_msgs/FootstepStatusRosMessage.h"
@@ -20,6 +21,10 @@
 #include <tf/transform_listener.h>
 #include <tough_common/robot_state.h>
 #include "tough_common/robot_description.h"
+#include "tough_footstep/FootstepValidator.h"
+#include "tough_footstep/StepTemplateLibrary.h"
+#include "tough_footstep/StepTimingOptimizer.h"
+#include <mutex>
 
 
 /**
@@ -44,6 +49,7 @@ public:
 
     /**
      * @brief walkToGoal walks to a given 2D point in a map. needs a map either from map server or from octomap server
+     *        With plan streaming, the walk starts as soon as the planner finds a first path. see setPlanStreaming
      * @param goal  pose2d message giving position and orientation of goal point.
      * @return true if footstep planning is successful else false
      */
@@ -80,7 +86,9 @@ public:
     /**
      * @brief setWalkParms      Set the values of walking parameters
      * @param InTransferTime    transfer_time is the time required for the robot to switch its weight from one to other while walking.
+     *                          With step timing optimization it is the longest transfer time of a step.
      * @param InSwingTime       swing_time is the time required for the robot to swing its leg to the given step size.
+     *                          With step timing optimization it is the longest swing time of a step.
      * @param InMode            execution mode defines if steps are to be queued with previous steps or override and start a walking message. Only Override is supported in this version.
      * @todo create separate messages for each of the parameters.
      */
@@ -107,13 +115,19 @@ public:
     }
 
     /**
-     * @brief turn contains precomputed footsteps to make a left or right 90 degree turn
+     * @brief turn makes a left or right 90 degree turn in place using the cached turn template
      * @param side left- anticlockwise, right - clockwise.
-     * DO NOT USE. ROBOT MIGHT FALL.
      * @return
      */
     bool turn(RobotSide side);
 
+    /**
+     * @brief sidestep moves the robot sideways in place using the cached sidestep templates.
+     * @param distance is the distance in meters, positive to the left. It is rounded to a centimeter.
+     * @return false if the sidestep cannot be done within the step limits
+     */
+    bool sidestep(float distance, bool waitForSteps=true);
+
     /**
      * @brief walkLocalPreComputedSteps walks predefined steps which could have varying step length and step widths. This is defined wrt Pelvis frame.
      * @param xOffset  Is a vector of float. Each value represents offset in x direction of individual step.
@@ -176,8 +190,8 @@ public:
     void loadEEF(RobotSide side, EE_LOADING load);
 
     /**
-     * @brief walkRotate rotates the robot by desired angle. this is relative to the current yaw angle.
-     * @param angle is the angle expressed in radians
+     * @brief walkRotate rotates the robot in place by desired angle. this is relative to the current yaw angle.
+     * @param angle is the angle expressed in radians. It is rounded to a degree.
      * @return
      */
     bool walkRotate(float angle);
@@ -203,6 +217,40 @@ public:
      */
     void abortWalk();
 
+    /**
+     * @brief setStepValidation enables the check of the steps against the occupancy and elevation maps. Invalid
+     *        steps are not sent, and the steps left to walk are checked again every time a map is updated.
+     *        It is also enabled by the validate_footsteps parameter.
+     * @param enable true to check the steps
+     */
+    void setStepValidation(bool enable);
+
+    /**
+     * @brief validateSteps checks a list of steps against the latest maps.
+     * @param list      steps to check
+     * @param result    support ratio and collision of each step from firstStep on
+     * @param firstStep first step to check
+     * @return true if the steps are valid or no map was received yet
+     */
+    bool validateSteps(const ihmc_msgs::FootstepDataListRosMessage& list, std::vector<StepValidity>& result, size_t firstStep = 0);
+
+    /**
+     * @brief setStepTimingOptimization enables per step swing and transfer times. Every step sent gets the shortest
+     *        times its geometry allows within the bounds of the step_timing parameters, and never more than the
+     *        transfer and swing times of the walker. It is also enabled by the optimize_step_timing parameter.
+     * @param enable true to time each step
+     */
+    void setStepTimingOptimization(bool enable);
+
+    /**
+     * @brief setPlanStreaming makes walkToGoal send the steps of the first path found in batches. While a batch is walked,
+     *        the rest of the path is planned again, at most every stream_replan_period seconds, from a stance a few
+     *        batches ahead. The new path replaces the pending steps after that stance when it is shorter or when they
+     *        are no longer valid, unless the stance was sent meanwhile. It is also set by the stream_batch_size parameter.
+     * @param batchSize number of steps sent at once, 0 to send the whole path
+     */
+    void setPlanStreaming(int batchSize);
+
 private:
     RobotStateInformer *current_state_;
     RobotDescription *rd_;
@@ -213,13 +261,67 @@ private:
     ros::Time                   cbTime_;
     ros::Publisher              footsteps_pub_ ,nudgestep_pub_,loadeff_pub, abort_footsteps_pub_;
     ros::Subscriber             footstep_status_ ;
-    ros::ServiceClient          footstep_client_ ;
     std_msgs::String            right_foot_frame_,left_foot_frame_;
 
+    FootstepValidator           validator_;
+    bool                        validate_steps_;
+    float                       elevation_resolution_;
+    ros::Subscriber             map_sub_, elevation_sub_;
+    ihmc_msgs::FootstepDataListRosMessage active_steps_;
+    std::mutex                  steps_mtx_;     // guards validator_, active_steps_ and step_counter_
+    StepTemplateLibrary         templates_;
+    StepTimingOptimizer         timing_;
+    bool                        optimize_timing_;
+    int                         stream_batch_size_;
+    double                      stream_replan_period_;
+    std::string                 footstep_params_ns_;
+
     void footstepStatusCB(const ihmc_msgs::FootstepStatusRosMessage & msg);
+    void mapCB(const nav_msgs::OccupancyGridConstPtr &msg);
+    void elevationCB(const sensor_msgs::PointCloud2ConstPtr &msg);
+    void revalidateActiveSteps();
+    /**
+     * @brief stepsInFlight number of steps sent that the controller did not complete yet
+     */
+    int stepsInFlight();
     void waitForSteps(const int numSteps);
-    ihmc_msgs::FootstepDataRosMessage::Ptr getOffsetStep(int side, float x, float y);
-    ihmc_msgs::FootstepDataRosMessage::Ptr getOffsetStepWRTPelvis(int side , float x, float y);
+    /**
+     * @brief getOffsetSteps appends steps offset from the current position of the feet, alternating legs from startLeg.
+     *        The feet and the pelvis are looked up once for the whole sequence.
+     * @param xOffset   offsets in x of the steps
+     * @param yOffset   offsets in y of the steps, same size as xOffset
+     * @param wrtPelvis true if the offsets are in the pelvis frame, false if they are in the world frame
+     * @param list      list the steps are appended to
+     */
+    void getOffsetSteps(int startLeg, const std::vector<float> &xOffset, const std::vector<float> &yOffset, bool wrtPelvis,
+                        ihmc_msgs::FootstepDataListRosMessage &list);
+    /**
+     * @brief getTemplateSteps appends the steps of a template placed at the current stance, centered between the feet
+     *        and facing their mean yaw. The feet are looked up once.
+     * @param steps     template from templates_
+     * @param list      list the steps are appended to
+     */
+    void getTemplateSteps(const std::vector<TemplateStep> &steps, ihmc_msgs::FootstepDataListRosMessage &list);
+    /**
+     * @brief getPlannedSteps converts the steps of the footstep planner, which only give the position and yaw of the feet
+     * @param feet      steps the feet are at, indexed by side
+     */
+    static void getPlannedSteps(const std::vector<humanoid_nav_msgs::StepTarget> &planned, const ihmc_msgs::FootstepDataRosMessage feet[2],
+                                std::vector<ihmc_msgs::FootstepDataRosMessage> &steps);
+    /**
+     * @brief planBetweenFeet plans the steps from the given feet to the goal, steps where the feet already are are left out.
+     *        It does not use the walker, so it can run in a thread that outlives it.
+     * @param separation distance between the feet at the goal
+     */
+    static bool planBetweenFeet(ros::NodeHandle nh, float separation, const ihmc_msgs::FootstepDataRosMessage feet[2],
+                                const geometry_msgs::Pose2D &goal, std::vector<ihmc_msgs::FootstepDataRosMessage> &steps);
+    /**
+     * @brief queueSteps sends steps after the ones being walked
+     * @param feet      steps the feet will be at when the list starts, indexed by side
+     * @return false if the steps are not valid
+     */
+    bool queueSteps(ihmc_msgs::FootstepDataListRosMessage &list, const ihmc_msgs::FootstepDataRosMessage feet[2]);
+    bool streamToGoal(const geometry_msgs::Pose2D &goal, bool waitForSteps);
 
 
 };
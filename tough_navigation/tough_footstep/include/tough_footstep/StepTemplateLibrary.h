@@ -0,0 +1,102 @@
+#ifndef STEP_TEMPLATE_LIBRARY_H
+#define STEP_TEMPLATE_LIBRARY_H
+
+#include <ros/ros.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief reach of a step, as in the foot settings of config/footsteps_<robot>.yaml. The displacement of the
+ * swing foot is in the frame of the support foot and mirrored for the right foot, so y and theta are positive
+ * away from the support foot. The defaults are those of atlas.
+ */
+struct StepLimits
+{
+    float max_x;
+    float max_y;
+    float max_theta;
+    float min_x;        // max/inverse/step of the yaml
+    float min_y;
+    float min_theta;
+    float separation;   // distance between the feet when standing
+
+    StepLimits():
+        max_x(0.42f), max_y(0.42f), max_theta(0.6f), min_x(-0.18f), min_y(0.25f), min_theta(-0.1f), separation(0.36f)
+    {
+    }
+};
+
+/**
+ * @brief step of a template, in the stance frame centered between the feet and facing forward
+ */
+struct TemplateStep
+{
+    int     side;
+    float   x;
+    float   y;
+    float   yaw;
+};
+
+/**
+ * @brief library of step sequences for turning in place and stepping sideways. The sequences are built in the
+ * stance frame with the fewest steps that stay within the step limits, moving a step by up to 2 cm when it
+ * is just out of reach, and are cached, so walking one only takes the transform of the stance frame to the
+ * world. Turns of every 15 degrees and sidesteps of every 5 cm up to 1 m are built up front.
+ */
+class StepTemplateLibrary
+{
+public:
+    StepTemplateLibrary(const StepLimits &limits = StepLimits());
+    ~StepTemplateLibrary();
+
+    /**
+     * @brief reads the foot settings loaded for the footstep planner
+     * @param ns namespace of the footstep planner parameters, the defaults are kept for missing ones
+     */
+    static StepLimits loadLimits(const ros::NodeHandle &nh, const std::string &ns);
+
+    /**
+     * @brief sets the step limits and rebuilds the templates
+     */
+    void setLimits(const StepLimits &limits);
+    const StepLimits& getLimits() const { return limits_; }
+
+    /**
+     * @brief steps to turn in place
+     * @param angle radians, positive to turn left. It is rounded to a degree.
+     * @return empty if the turn cannot be done within the limits
+     */
+    const std::vector<TemplateStep>& getTurn(float angle);
+
+    /**
+     * @brief steps to move sideways
+     * @param distance meters, positive to move left. It is rounded to a centimeter.
+     * @return empty if the sidestep cannot be done within the limits
+     */
+    const std::vector<TemplateStep>& getSidestep(float distance);
+
+private:
+    static const float  ANGLE_RESOLUTION;
+    static const float  DISTANCE_RESOLUTION;
+    static const float  POSITION_TOLERANCE;     // largest correction of a step to keep it within the limits
+    static const int    MAX_STEP_PAIRS;
+
+    /**
+     * @brief builds a sequence of step pairs, the leading foot moves first in each pair
+     * @param place pose of a foot of the stance frame after a fraction of the motion
+     */
+    template <typename PlaceFn>
+    std::vector<TemplateStep> buildTemplate(int lead, PlaceFn place) const;
+
+    /**
+     * @brief closest step to swing that is within the limits from support
+     */
+    TemplateStep clampToLimits(const TemplateStep &support, const TemplateStep &swing) const;
+
+    StepLimits limits_;
+    std::map<int, std::vector<TemplateStep>> turns_;
+    std::map<int, std::vector<TemplateStep>> sidesteps_;
+};
+
+#endif // STEP_TEMPLATE_LIBRARY_H
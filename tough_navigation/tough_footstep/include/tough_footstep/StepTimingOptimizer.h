@@ -0,0 +1,61 @@
+#ifndef STEP_TIMING_OPTIMIZER_H
+#define STEP_TIMING_OPTIMIZER_H
+
+#include <ros/ros.h>
+#include "ihmc_msgs/FootstepDataListRosMessage.h"
+#include "ihmc_msgs/FootstepDataRosMessage.h"
+#include <string>
+
+/**
+ * @brief bounds of the step timing. Durations are in seconds, speeds in meters or radians per second. The
+ * longest durations are the default durations of the step list, which are tuned for the worst case.
+ */
+struct StepTimingParams
+{
+    double  min_swing;
+    double  min_transfer;
+    double  swing_speed;        // horizontal speed of the swing foot
+    double  swing_turn_rate;    // yaw rate of the swing foot
+    double  step_up_speed;      // vertical speed of the swing foot between the heights of its steps
+    double  transfer_speed;     // speed of the weight shift onto the support foot
+    double  transfer_up_speed;  // vertical speed of the weight shift onto a higher or lower support foot
+
+    StepTimingParams():
+        min_swing(0.6), min_transfer(0.25), swing_speed(0.8), swing_turn_rate(1.0), step_up_speed(0.25),
+        transfer_speed(0.5), transfer_up_speed(0.2)
+    {
+    }
+};
+
+/**
+ * @brief picks the swing and transfer durations of every step from its geometry: how far the swing foot
+ * travels, turns and changes height, and how far the weight shifts onto the support foot. Short flat
+ * steps get the shortest durations and no step gets more than the defaults of its list.
+ */
+class StepTimingOptimizer
+{
+public:
+    StepTimingOptimizer(const StepTimingParams &params = StepTimingParams());
+    ~StepTimingOptimizer();
+
+    /**
+     * @brief reads the timing bounds, the defaults are kept for missing ones
+     * @param ns namespace of the parameters
+     */
+    static StepTimingParams loadParams(const ros::NodeHandle &nh, const std::string &ns);
+
+    void setParams(const StepTimingParams &params) { params_ = params; }
+    const StepTimingParams& getParams() const { return params_; }
+
+    /**
+     * @brief sets swing_duration and transfer_duration of every step of a list
+     * @param feet current steps of the feet, indexed by side
+     * @param list steps to time, walked in order from feet
+     */
+    void apply(const ihmc_msgs::FootstepDataRosMessage feet[2], ihmc_msgs::FootstepDataListRosMessage &list) const;
+
+private:
+    StepTimingParams params_;
+};
+
+#endif // STEP_TIMING_OPTIMIZER_H
@@ -0,0 +1,195 @@
+#include "tough_footstep/FootstepValidator.h"
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <tf/tf.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * @note origin_shift of the planner goes from the center of the sole to the step location, the opposite of
+ * center_offset
+ */
+FootstepValidatorParams FootstepValidator::loadParams(const ros::NodeHandle &nh, const std::string &ns)
+{
+    FootstepValidatorParams params;
+    float shiftX = -params.center_offset_x, shiftY = -params.center_offset_y;
+    nh.param<float>(ns + "/foot/size/x", params.foot_length, params.foot_length);
+    nh.param<float>(ns + "/foot/size/y", params.foot_width, params.foot_width);
+    nh.param<float>(ns + "/foot/origin_shift/x", shiftX, shiftX);
+    nh.param<float>(ns + "/foot/origin_shift/y", shiftY, shiftY);
+    params.center_offset_x = -shiftX;
+    params.center_offset_y = -shiftY;
+    return params;
+}
+
+FootstepValidator::FootstepValidator(const FootstepValidatorParams &params):
+    params_(params), elevation_width_(0), elevation_height_(0), elevation_origin_x_(0.0f),
+    elevation_origin_y_(0.0f), elevation_resolution_(1.0f)
+{
+    // samples at the centers of a regular grid over the sole
+    const int nx = std::max(1, static_cast<int>(std::ceil(params_.foot_length/params_.sample_spacing)));
+    const int ny = std::max(1, static_cast<int>(std::ceil(params_.foot_width/params_.sample_spacing)));
+    for(int i = 0; i < nx; ++i)
+    {
+        for(int j = 0; j < ny; ++j)
+        {
+            sample_x_.push_back(params_.center_offset_x + ((i + 0.5f)/nx - 0.5f)*params_.foot_length);
+            sample_y_.push_back(params_.center_offset_y + ((j + 0.5f)/ny - 0.5f)*params_.foot_width);
+        }
+    }
+}
+
+FootstepValidator::~FootstepValidator()
+{
+}
+
+void FootstepValidator::setOccupancy(const nav_msgs::OccupancyGridConstPtr &grid)
+{
+    occupancy_ = grid;
+}
+
+void FootstepValidator::setElevation(const sensor_msgs::PointCloud2 &cloud, float resolution)
+{
+    const size_t num_points = static_cast<size_t>(cloud.width)*cloud.height;
+    if(num_points == 0)
+    {
+        elevation_.clear();
+        elevation_width_ = elevation_height_ = 0;
+        return;
+    }
+
+    float min_x = std::numeric_limits<float>::max(), min_y = min_x;
+    float max_x = -min_x, max_y = -min_x;
+    sensor_msgs::PointCloud2ConstIterator<float> it_x(cloud, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> it_y(cloud, "y");
+    for(; it_x != it_x.end(); ++it_x, ++it_y)
+    {
+        min_x = std::min(min_x, *it_x);
+        min_y = std::min(min_y, *it_y);
+        max_x = std::max(max_x, *it_x);
+        max_y = std::max(max_y, *it_y);
+    }
+
+    // the points are at the cell centers
+    elevation_resolution_ = resolution;
+    elevation_origin_x_   = min_x - resolution/2;
+    elevation_origin_y_   = min_y - resolution/2;
+    elevation_width_      = static_cast<int>(std::lround((max_x - min_x)/resolution)) + 1;
+    elevation_height_     = static_cast<int>(std::lround((max_y - min_y)/resolution)) + 1;
+    elevation_.assign(static_cast<size_t>(elevation_width_)*elevation_height_, std::numeric_limits<float>::quiet_NaN());
+
+    sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
+    sensor_msgs::PointCloud2ConstIterator<float> iter_z(cloud, "z");
+    for(; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z)
+    {
+        const int col = static_cast<int>((*iter_x - elevation_origin_x_)/resolution);
+        const int row = static_cast<int>((*iter_y - elevation_origin_y_)/resolution);
+        if(col >= 0 && row >= 0 && col < elevation_width_ && row < elevation_height_)
+            elevation_[static_cast<size_t>(row)*elevation_width_ + col] = *iter_z;
+    }
+}
+
+bool FootstepValidator::hasMap() const
+{
+    return occupancy_ != nullptr || !elevation_.empty();
+}
+
+/**
+ * @note every stage runs over the samples of all the steps at once: the sole pattern is placed at each
+ * step, the samples are turned into cell indices of both maps, then the cells are classified. A sample is
+ * supported by the elevation map when its cell is known and at the height of the sole, and by the
+ * occupancy map only when its elevation is unknown.
+ */
+bool FootstepValidator::validate(const ihmc_msgs::FootstepDataListRosMessage &list, std::vector<StepValidity> &result,
+                                 size_t first_step) const
+{
+    result.clear();
+    const auto &steps = list.footstep_data_list;
+    if(first_step >= steps.size())
+        return true;
+
+    const size_t num_steps   = steps.size() - first_step;
+    const size_t per_step    = sample_x_.size();
+    const size_t num_samples = num_steps*per_step;
+
+    std::vector<float> world_x(num_samples), world_y(num_samples), sole_z(num_samples);
+    for(size_t s = 0; s < num_steps; ++s)
+    {
+        const ihmc_msgs::FootstepDataRosMessage &step = steps[first_step + s];
+        const float yaw = tf::getYaw(step.orientation);
+        const float c = std::cos(yaw), sn = std::sin(yaw);
+        const float px = step.location.x, py = step.location.y, pz = step.location.z;
+        float *out_x = &world_x[s*per_step];
+        float *out_y = &world_y[s*per_step];
+        float *out_z = &sole_z[s*per_step];
+        for(size_t i = 0; i < per_step; ++i)
+        {
+            out_x[i] = px + c*sample_x_[i] - sn*sample_y_[i];
+            out_y[i] = py + sn*sample_x_[i] + c*sample_y_[i];
+            out_z[i] = pz;
+        }
+    }
+
+    // 1 if the sample is supported, 2 if it collides
+    std::vector<uint8_t> flags(num_samples, 0);
+    std::vector<uint8_t> elevation_known(num_samples, 0);
+
+    if(!elevation_.empty())
+    {
+        const float inv_res = 1.0f/elevation_resolution_;
+        for(size_t i = 0; i < num_samples; ++i)
+        {
+            const int col = static_cast<int>(std::floor((world_x[i] - elevation_origin_x_)*inv_res));
+            const int row = static_cast<int>(std::floor((world_y[i] - elevation_origin_y_)*inv_res));
+            if(col < 0 || row < 0 || col >= elevation_width_ || row >= elevation_height_)
+                continue;
+            const float h = elevation_[static_cast<size_t>(row)*elevation_width_ + col];
+            if(std::isnan(h))
+                continue;
+            const float dz = h - sole_z[i];
+            elevation_known[i] = 1;
+            flags[i] = std::fabs(dz) <= params_.max_height_error ? 1 : (dz > params_.max_obstacle_height ? 2 : 0);
+        }
+    }
+
+    if(occupancy_ != nullptr)
+    {
+        const nav_msgs::MapMetaData &info = occupancy_->info;
+        const int8_t *cells = occupancy_->data.data();
+        const float inv_res = 1.0f/info.resolution;
+        const float origin_x = info.origin.position.x, origin_y = info.origin.position.y;
+        for(size_t i = 0; i < num_samples; ++i)
+        {
+            const int col = static_cast<int>(std::floor((world_x[i] - origin_x)*inv_res));
+            const int row = static_cast<int>(std::floor((world_y[i] - origin_y)*inv_res));
+            if(col < 0 || row < 0 || col >= static_cast<int>(info.width) || row >= static_cast<int>(info.height))
+                continue;
+            const int value = cells[static_cast<size_t>(row)*info.width + col];
+            if(value == params_.blocked_value)
+                flags[i] = 2;
+            else if(!elevation_known[i] && value >= 0 && value <= params_.max_free_value)
+                flags[i] = 1;
+        }
+    }
+
+    bool all_valid = true;
+    result.resize(num_steps);
+    for(size_t s = 0; s < num_steps; ++s)
+    {
+        size_t supported = 0;
+        bool collision = false;
+        const uint8_t *step_flags = &flags[s*per_step];
+        for(size_t i = 0; i < per_step; ++i)
+        {
+            supported += step_flags[i] == 1;
+            collision |= step_flags[i] == 2;
+        }
+        StepValidity &validity = result[s];
+        validity.support_ratio = static_cast<float>(supported)/per_step;
+        validity.collision     = collision;
+        validity.valid         = !collision && validity.support_ratio >= params_.min_support_ratio;
+        all_valid = all_valid && validity.valid;
+    }
+    return all_valid;
+}
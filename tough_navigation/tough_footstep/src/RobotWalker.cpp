@@ -6,7 +6,12 @@
 
 #include "tough_footstep/RobotWalker.h"
 #include "tough_common/tough_common_names.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <thread>
 #include <ros/ros.h>
 
 int RobotWalker::id = 1;
@@ -41,6 +46,23 @@ RobotWalker::RobotWalker(ros::NodeHandle nh,double InTransferTime ,double InSwin
      */
     cbTime_=ros::Time::now();
 
+    // foot settings and step limits of the footstep planner, the templates are built once here
+    nh_.param<std::string>("footstep_params_ns", footstep_params_ns_, "/footstep_planner");
+    validator_ = FootstepValidator(FootstepValidator::loadParams(nh_, footstep_params_ns_));
+
+    double elevationResolution;
+    nh_.param<bool>("validate_footsteps", validate_steps_, false);
+    nh_.param<double>("elevation_map_resolution", elevationResolution, 0.05);
+    elevation_resolution_ = elevationResolution;
+    setStepValidation(validate_steps_);
+
+    templates_.setLimits(StepTemplateLibrary::loadLimits(nh_, footstep_params_ns_));
+
+    nh_.param<bool>("optimize_step_timing", optimize_timing_, false);
+    timing_.setParams(StepTimingOptimizer::loadParams(nh_, "step_timing"));
+
+    nh_.param<int>("stream_batch_size", stream_batch_size_, 0);
+    nh_.param<double>("stream_replan_period", stream_replan_period_, 2.0);
 }
 
 /**
@@ -58,7 +80,12 @@ void RobotWalker::footstepStatusCB(const ihmc_msgs::FootstepStatusRosMessage &ms
 {
     if(msg.status == ihmc_msgs::FootstepStatusRosMessage::COMPLETED)
     {
+        std::lock_guard<std::mutex> lock(steps_mtx_);
         step_counter_++;
+        if(step_counter_ >= static_cast<int>(active_steps_.footstep_data_list.size()))
+        {
+            active_steps_.footstep_data_list.clear();
+        }
     }
 
     // reset the timer
@@ -76,17 +103,14 @@ bool RobotWalker::walkToGoal( geometry_msgs::Pose2D &goal, bool waitForSteps)
     list.execution_mode = execution_mode_;
     list.unique_id = RobotWalker::id;
 
-    if(this->getFootstep(goal,list))
+    if(stream_batch_size_ > 0)
     {
-        this->footsteps_pub_.publish(list);
-        RobotWalker::id++;
+        return streamToGoal(goal, waitForSteps);
+    }
 
-        if (waitForSteps)
-        {
-            cbTime_=ros::Time::now();
-            this->waitForSteps(list.footstep_data_list.size());
-        }
-        return true;
+    if(this->getFootstep(goal,list))
+    {
+        return this->walkGivenSteps(list, waitForSteps);
     }
     return false;
 }
@@ -101,26 +125,19 @@ bool RobotWalker::walkNSteps(int numSteps, float xOffset, float yOffset, bool co
 
     list.unique_id = RobotWalker::id;
 
+    // the last step brings the other foot next to the leading one
+    std::vector<float> xOffsets, yOffsets;
     for (int m =1; m <= numSteps ; m++) {
-        if(m%2 == 1) {
-            list.footstep_data_list.push_back(*getOffsetStep(startLeg , m*xOffset, m*yOffset));
-        }
-        else {
-            list.footstep_data_list.push_back(*getOffsetStep((startLeg+1)%2 , m*xOffset, m*yOffset));
-        }
-
+        xOffsets.push_back(m*xOffset);
+        yOffsets.push_back(m*yOffset);
     }
     if(!continous){
-        if (numSteps%2 ==1) {
-            list.footstep_data_list.push_back(*getOffsetStep((startLeg+1)%2  , numSteps*xOffset, numSteps*yOffset));
-        }
-        if (numSteps%2 ==0) {
-            list.footstep_data_list.push_back(*getOffsetStep(startLeg , numSteps*xOffset, numSteps*yOffset));
-        }
+        xOffsets.push_back(numSteps*xOffset);
+        yOffsets.push_back(numSteps*yOffset);
     }
+    getOffsetSteps(startLeg, xOffsets, yOffsets, false, list);
 
-    this->walkGivenSteps(list, waitForSteps);
-    return true;
+    return this->walkGivenSteps(list, waitForSteps);
 }
 
 // walks certain number of defined footsteps. steps defined wrt pelvis frame.
@@ -133,26 +150,19 @@ bool RobotWalker::walkNStepsWRTPelvis(int numSteps, float xOffset, float yOffset
 
     list.unique_id = RobotWalker::id ;
 
+    // the last step brings the other foot next to the leading one
+    std::vector<float> xOffsets, yOffsets;
     for (int m =1; m <= numSteps ; m++) {
-        if(m%2 == 1) {
-            list.footstep_data_list.push_back(*getOffsetStepWRTPelvis(startLeg , m*xOffset, m*yOffset));
-        }
-        else {
-            list.footstep_data_list.push_back(*getOffsetStepWRTPelvis((startLeg+1)%2 , m*xOffset, m*yOffset));
-        }
-
+        xOffsets.push_back(m*xOffset);
+        yOffsets.push_back(m*yOffset);
     }
     if(!continous){
-        if (numSteps%2 ==1) {
-            list.footstep_data_list.push_back(*getOffsetStepWRTPelvis((startLeg+1)%2  , numSteps*xOffset, numSteps*yOffset));
-        }
-        if (numSteps%2 ==0) {
-            list.footstep_data_list.push_back(*getOffsetStepWRTPelvis(startLeg , numSteps*xOffset, numSteps*yOffset));
-        }
+        xOffsets.push_back(numSteps*xOffset);
+        yOffsets.push_back(numSteps*yOffset);
     }
+    getOffsetSteps(startLeg, xOffsets, yOffsets, true, list);
 
-    this->walkGivenSteps(list, waitForSteps);
-    return true;
+    return this->walkGivenSteps(list, waitForSteps);
 }
 
 // walks predefined steps which could have varying step length and step widths. This is defined wrt World frame.
@@ -170,17 +180,9 @@ bool RobotWalker::walkPreComputedSteps(const std::vector<float> xOffset, const s
     }
 
 
-    size_t numberOfSteps = xOffset.size();
-
-    for (int m =1; m <= numberOfSteps ; m++) {
-        if(m%2 == 1)
-            list.footstep_data_list.push_back(*getOffsetStep(startLeg , xOffset[m-1], yOffset[m-1]));
-        else
-            list.footstep_data_list.push_back(*getOffsetStep((startLeg+1)%2 , xOffset[m-1], yOffset[m-1]));
-    }
+    getOffsetSteps(startLeg, xOffset, yOffset, false, list);
 
-    this->walkGivenSteps(list);
-    return true;
+    return this->walkGivenSteps(list);
 }
 
 // walks predefined steps which could have varying step length and step widths. This is defined wrt Pelvis frame.
@@ -192,49 +194,42 @@ bool RobotWalker::walkLocalPreComputedSteps(const std::vector<float> xOffset, co
     list.execution_mode = execution_mode_;
     list.unique_id = RobotWalker::id;
 
-    if (xOffset.size() != yOffset.size())
+    if (xOffset.size() != yOffset.size()){
         ROS_ERROR("X Offset and Y Offset have different size");
+        return false;
+    }
 
-    ihmc_msgs::FootstepDataRosMessage::Ptr current(new ihmc_msgs::FootstepDataRosMessage());
-    ihmc_msgs::FootstepDataRosMessage::Ptr newFootStep(new ihmc_msgs::FootstepDataRosMessage());
+    getOffsetSteps(startLeg, xOffset, yOffset, true, list);
 
-    geometry_msgs::Point currentWorldLocation,currentPelvisLocation;
+    return this->walkGivenSteps(list);
+}
 
-    size_t numberOfSteps = xOffset.size();
+bool RobotWalker::walkGivenSteps(ihmc_msgs::FootstepDataListRosMessage& list , bool waitForSteps)
+{
+    if(optimize_timing_)
+    {
+        ihmc_msgs::FootstepDataRosMessage feet[2];
+        getCurrentStep(LEFT, feet[LEFT]);
+        getCurrentStep(RIGHT, feet[RIGHT]);
+        timing_.apply(feet, list);
+    }
 
-    for (int m = 1; m <= numberOfSteps; ++m) {
-        if(m%2 == 1)
-        {
-            getCurrentStep(startLeg, *current);
-        }
-        else
+    std::vector<StepValidity> validity;
+    if(validate_steps_ && !validateSteps(list, validity))
+    {
+        for(size_t i = 0; i < validity.size(); ++i)
         {
-            getCurrentStep((startLeg+1)%2, *current);
+            if(!validity[i].valid)
+                ROS_ERROR("Step %zu is not valid: support %.2f collision %d", i, validity[i].support_ratio, validity[i].collision);
         }
-
-        currentWorldLocation.x=current->location.x;
-        currentWorldLocation.y=current->location.y;
-        currentWorldLocation.z=current->location.z;
-        current_state_->transformPoint(currentWorldLocation,currentPelvisLocation,TOUGH_COMMON_NAMES::WORLD_TF,rd_->getPelvisFrame());
-
-        currentPelvisLocation.x+=xOffset[m-1];
-        currentPelvisLocation.y+=yOffset[m-1];
-        current_state_->transformPoint(currentPelvisLocation,currentWorldLocation,rd_->getPelvisFrame(),TOUGH_COMMON_NAMES::WORLD_TF);
-        newFootStep->location.x=currentWorldLocation.x;
-        newFootStep->location.y=currentWorldLocation.y;
-        newFootStep->location.z=current->location.z;
-        newFootStep->orientation=current->orientation;
-        newFootStep->robot_side=current->robot_side;
-        newFootStep->trajectory_type=current->trajectory_type;
-        list.footstep_data_list.push_back(*newFootStep);
+        return false;
     }
 
-    this->walkGivenSteps(list);
-    return true;
-}
-
-bool RobotWalker::walkGivenSteps(ihmc_msgs::FootstepDataListRosMessage& list , bool waitForSteps)
-{
+    {
+        std::lock_guard<std::mutex> lock(steps_mtx_);
+        step_counter_ = 0;
+        active_steps_ = list;
+    }
     this->footsteps_pub_.publish(list);
     RobotWalker::id++;
     if (waitForSteps){
@@ -506,7 +501,8 @@ bool RobotWalker::getFootstep(const geometry_msgs::Pose2D &goal,ihmc_msgs::Foots
 
     geometry_msgs::Pose2D start;
     humanoid_nav_msgs::PlanFootsteps srv;
-    footstep_client_ = nh_.serviceClient <humanoid_nav_msgs::PlanFootsteps> ("/plan_footsteps");
+    // a client per call, so that goals can be planned from several threads
+    ros::ServiceClient footstepClient = nh_.serviceClient <humanoid_nav_msgs::PlanFootsteps> ("/plan_footsteps");
     // get start from robot position
 
     //    ihmc_msgs::FootstepDataRosMessage::Ptr startstep(new ihmc_msgs::FootstepDataRosMessage());
@@ -524,38 +520,248 @@ bool RobotWalker::getFootstep(const geometry_msgs::Pose2D &goal,ihmc_msgs::Foots
     srv.request.start = start;
     srv.request.goal = goal;
     // The service calls succeeds everytime. result variable stores the actual result of planning
-    if(footstep_client_.call(srv) && srv.response.result)
+    if(footstepClient.call(srv) && srv.response.result)
+    {
+        ihmc_msgs::FootstepDataRosMessage feet[2];
+        this->getCurrentStep(LEFT, feet[LEFT]);
+        this->getCurrentStep(RIGHT, feet[RIGHT]);
+        std::vector<ihmc_msgs::FootstepDataRosMessage> steps;
+        getPlannedSteps(srv.response.footsteps, feet, steps);
+        list.footstep_data_list.insert(list.footstep_data_list.end(), steps.begin(), steps.end());
+        return true;
+    }
+    return false;
+}
+
+// the planned steps only change the position and yaw of the feet
+void RobotWalker::getPlannedSteps(const std::vector<humanoid_nav_msgs::StepTarget> &planned, const ihmc_msgs::FootstepDataRosMessage feet[2],
+                                  std::vector<ihmc_msgs::FootstepDataRosMessage> &steps)
+{
+    steps.resize(planned.size());
+    for(size_t i = 0; i < planned.size(); ++i)
+    {
+        const int side = planned[i].leg == humanoid_nav_msgs::StepTarget::left ? LEFT : RIGHT;
+        steps[i] = feet[side];
+        steps[i].location.x = planned[i].pose.x;
+        steps[i].location.y = planned[i].pose.y;
+        tf::quaternionTFToMsg(tf::createQuaternionFromYaw(planned[i].pose.theta), steps[i].orientation);
+        ROS_DEBUG("Step %zu side %d x %.2f y %.2f", i, side, planned[i].pose.x, planned[i].pose.y);
+    }
+}
+
+bool RobotWalker::planBetweenFeet(ros::NodeHandle nh, float separation, const ihmc_msgs::FootstepDataRosMessage feet[2],
+                                  const geometry_msgs::Pose2D &goal, std::vector<ihmc_msgs::FootstepDataRosMessage> &steps)
+{
+    humanoid_nav_msgs::PlanFootstepsBetweenFeet srv;
+    srv.request.start_left.leg   = humanoid_nav_msgs::StepTarget::left;
+    srv.request.start_left.pose.x = feet[LEFT].location.x;
+    srv.request.start_left.pose.y = feet[LEFT].location.y;
+    srv.request.start_left.pose.theta = tf::getYaw(feet[LEFT].orientation);
+    srv.request.start_right.leg  = humanoid_nav_msgs::StepTarget::right;
+    srv.request.start_right.pose.x = feet[RIGHT].location.x;
+    srv.request.start_right.pose.y = feet[RIGHT].location.y;
+    srv.request.start_right.pose.theta = tf::getYaw(feet[RIGHT].orientation);
+
+    // the goal feet stand at the separation of the step limits, around the goal
+    const double halfSeparation = separation/2;
+    srv.request.goal_left.leg    = humanoid_nav_msgs::StepTarget::left;
+    srv.request.goal_left.pose   = goal;
+    srv.request.goal_left.pose.x -= halfSeparation*std::sin(goal.theta);
+    srv.request.goal_left.pose.y += halfSeparation*std::cos(goal.theta);
+    srv.request.goal_right.leg   = humanoid_nav_msgs::StepTarget::right;
+    srv.request.goal_right.pose  = goal;
+    srv.request.goal_right.pose.x += halfSeparation*std::sin(goal.theta);
+    srv.request.goal_right.pose.y -= halfSeparation*std::cos(goal.theta);
+
+    ros::ServiceClient client = nh.serviceClient<humanoid_nav_msgs::PlanFootstepsBetweenFeet>("/plan_footsteps_feet");
+    if(!client.call(srv) || !srv.response.result)
+        return false;
+
+    getPlannedSteps(srv.response.footsteps, feet, steps);
+
+    // the path starts with the feet where they are
+    size_t placed = 0;
+    while(placed < steps.size())
+    {
+        const ihmc_msgs::FootstepDataRosMessage &foot = feet[steps[placed].robot_side == LEFT ? LEFT : RIGHT];
+        if(std::hypot(steps[placed].location.x - foot.location.x, steps[placed].location.y - foot.location.y) > 0.01)
+            break;
+        ++placed;
+    }
+    steps.erase(steps.begin(), steps.begin() + placed);
+    return !steps.empty();
+}
+
+bool RobotWalker::queueSteps(ihmc_msgs::FootstepDataListRosMessage &list, const ihmc_msgs::FootstepDataRosMessage feet[2])
+{
+    if(optimize_timing_)
     {
+        timing_.apply(feet, list);
+    }
 
-        for(int i=0; i <srv.response.footsteps.size();i++)
+    std::vector<StepValidity> validity;
+    if(validate_steps_ && !validateSteps(list, validity))
+    {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(steps_mtx_);
+        // the controller may have walked all the steps sent before
+        if(active_steps_.footstep_data_list.empty())
         {
+            step_counter_ = 0;
+        }
+        active_steps_.footstep_data_list.insert(active_steps_.footstep_data_list.end(),
+                                                list.footstep_data_list.begin(), list.footstep_data_list.end());
+    }
+    list.execution_mode = ihmc_msgs::FootstepDataListRosMessage::QUEUE;
+    this->footsteps_pub_.publish(list);
+    RobotWalker::id++;
+    return true;
+}
 
-            ihmc_msgs::FootstepDataRosMessage::Ptr step(new ihmc_msgs::FootstepDataRosMessage());
-            bool side = bool(srv.response.footsteps.at(i).leg);
+/**
+ * @note the first batch is sent as soon as the planner returns a path. With search_until_first_solution, as in
+ * config/planning_params.yaml, that is the first solution of the inflated search rather than a search of the whole
+ * allocated_time. While batches are walked, the rest of the path is planned again in the background from a stance
+ * two batches ahead. The planner searches backward from the goal and reuses its search, so each of these plans is
+ * at least as good as the last. A replan that is still running when the walk ends is left to finish on its own.
+ */
+bool RobotWalker::streamToGoal(const geometry_msgs::Pose2D &goal, bool waitForSteps)
+{
+    bool firstSolution;
+    nh_.param<bool>(footstep_params_ns_ + "/search_until_first_solution", firstSolution, true);
+    if(!firstSolution)
+    {
+        ROS_WARN("The footstep planner searches for its whole allocated time, the first batch waits for it");
+    }
 
-            side = !side;
+    ihmc_msgs::FootstepDataListRosMessage batch;
+    batch.default_transfer_duration = transfer_time_;
+    batch.default_swing_duration    = swing_time_;
+    batch.execution_mode            = execution_mode_;
+    batch.unique_id                 = RobotWalker::id;
+    if(!getFootstep(goal, batch))
+        return false;
 
-            this->getCurrentStep(int(side),*step);
+    std::vector<ihmc_msgs::FootstepDataRosMessage> pending(batch.footstep_data_list.begin() +
+                                                           std::min<size_t>(stream_batch_size_, batch.footstep_data_list.size()),
+                                                           batch.footstep_data_list.end());
+    batch.footstep_data_list.resize(batch.footstep_data_list.size() - pending.size());
 
-            step->location.x = srv.response.footsteps.at(i).pose.x;
-            step->location.y = srv.response.footsteps.at(i).pose.y;
-            step->location.z = step->location.z;
+    // feet at the end of the steps sent
+    ihmc_msgs::FootstepDataRosMessage feet[2];
+    getCurrentStep(LEFT, feet[LEFT]);
+    getCurrentStep(RIGHT, feet[RIGHT]);
+    for(const auto &step : batch.footstep_data_list)
+        feet[step.robot_side == LEFT ? LEFT : RIGHT] = step;
 
-            tf::Quaternion t = tf::createQuaternionFromYaw(srv.response.footsteps.at(i).pose.theta);
-            ROS_DEBUG("Step x  %d %.2f", i, srv.response.footsteps.at(i).pose.x);
-            ROS_DEBUG("Step y  %d %.2f", i, srv.response.footsteps.at(i).pose.y);
-            ROS_DEBUG("Side  %d %d",i, int(side));
+    if(!walkGivenSteps(batch, false))
+        return false;
+    cbTime_ = ros::Time::now();
 
-            step->orientation.w = t.w();
-            step->orientation.x = t.x();
-            step->orientation.y = t.y();
-            step->orientation.z = t.z();
-            
-            list.footstep_data_list.push_back(*step);
+    // the replan only shares this with the walk, so the walk can end without waiting for it
+    struct ReplanJob
+    {
+        std::atomic<bool> done;
+        bool ok;
+        size_t start;       // index of the first replanned step in the steps of the walk
+        std::vector<ihmc_msgs::FootstepDataRosMessage> steps;
+        ReplanJob(): done(false), ok(false), start(0) {}
+    };
+    std::shared_ptr<ReplanJob> replan;
+    ros::Time replanTime;
+
+    size_t sent = batch.footstep_data_list.size();
+    const size_t lookahead = 2*stream_batch_size_;
+    const int refill = std::max(1, stream_batch_size_/2);
+    const float separation = templates_.getLimits().separation;
+
+    while(!pending.empty() && ros::ok())
+    {
+        if(replan && replan->done)
+        {
+            // the replan is of no use once the steps before its stance are sent
+            if(replan->ok && replan->start >= sent)
+            {
+                const size_t keep = replan->start - sent;
+                ihmc_msgs::FootstepDataListRosMessage check;
+                check.footstep_data_list.assign(pending.begin() + keep, pending.end());
+                std::vector<StepValidity> validity;
+                const bool pendingValid = !validate_steps_ || validateSteps(check, validity);
+                check.footstep_data_list = replan->steps;
+                const bool replannedValid = !validate_steps_ || validateSteps(check, validity);
+                if(replannedValid && (!pendingValid || replan->steps.size() <= pending.size() - keep))
+                {
+                    ROS_DEBUG("Spliced %zu replanned steps in place of %zu", replan->steps.size(), pending.size() - keep);
+                    pending.resize(keep);
+                    pending.insert(pending.end(), replan->steps.begin(), replan->steps.end());
+                }
+            }
+            replan.reset();
         }
-        return true;
+
+        if(!replan && pending.size() > lookahead && (ros::Time::now() - replanTime).toSec() >= stream_replan_period_)
+        {
+            replan = std::make_shared<ReplanJob>();
+            replan->start = sent + lookahead;
+            replanTime = ros::Time::now();
+
+            ihmc_msgs::FootstepDataRosMessage startFeet[2] = {feet[LEFT], feet[RIGHT]};
+            for(size_t i = 0; i < lookahead; ++i)
+                startFeet[pending[i].robot_side == LEFT ? LEFT : RIGHT] = pending[i];
+            std::shared_ptr<ReplanJob> job = replan;
+            ros::NodeHandle nh(nh_);
+            std::thread([job, nh, separation, startFeet, goal]()
+            {
+                job->ok = planBetweenFeet(nh, separation, startFeet, goal, job->steps);
+                job->done = true;
+            }).detach();
+        }
+
+        // the next batch is sent before the controller runs out of steps
+        int inFlight = stepsInFlight();
+        if(inFlight <= refill)
+        {
+            const size_t count = std::min<size_t>(stream_batch_size_, pending.size());
+            batch.footstep_data_list.assign(pending.begin(), pending.begin() + count);
+            batch.unique_id = RobotWalker::id;
+            if(!queueSteps(batch, feet))
+            {
+                ROS_ERROR("The streamed steps are not valid, stopping");
+                abortWalk();
+                return false;
+            }
+            // a controller that had stopped starts over with this batch
+            if(inFlight <= 0)
+                cbTime_ = ros::Time::now();
+            for(const auto &step : batch.footstep_data_list)
+                feet[step.robot_side == LEFT ? LEFT : RIGHT] = step;
+            pending.erase(pending.begin(), pending.begin() + count);
+            sent += count;
+            inFlight = stepsInFlight();
+        }
+
+        ros::spinOnce();
+        // hack to detect if robot has fallen, as in waitForSteps
+        if((ros::Time::now() - cbTime_) > ros::Duration(5) && inFlight > 0)
+        {
+            break;
+        }
+        ros::Duration(0.05).sleep();
     }
-    return false;
+
+    if(waitForSteps)
+    {
+        size_t numSteps;
+        {
+            std::lock_guard<std::mutex> lock(steps_mtx_);
+            numSteps = active_steps_.footstep_data_list.size();
+        }
+        this->waitForSteps(numSteps);
+    }
+    return pending.empty();
 }
 
 void RobotWalker::abortWalk()
@@ -563,6 +769,99 @@ void RobotWalker::abortWalk()
     ihmc_msgs::AbortWalkingRosMessage msg;
     msg.unique_id = 1;
     abort_footsteps_pub_.publish(msg);
+    std::lock_guard<std::mutex> lock(steps_mtx_);
+    active_steps_.footstep_data_list.clear();
+}
+
+int RobotWalker::stepsInFlight()
+{
+    std::lock_guard<std::mutex> lock(steps_mtx_);
+    return static_cast<int>(active_steps_.footstep_data_list.size()) - step_counter_;
+}
+
+void RobotWalker::setStepTimingOptimization(bool enable)
+{
+    optimize_timing_ = enable;
+}
+
+void RobotWalker::setPlanStreaming(int batchSize)
+{
+    stream_batch_size_ = std::max(0, batchSize);
+}
+
+void RobotWalker::setStepValidation(bool enable)
+{
+    validate_steps_ = enable;
+    if(validate_steps_ && !map_sub_)
+    {
+        map_sub_       = nh_.subscribe("/map", 1, &RobotWalker::mapCB, this);
+        elevation_sub_ = nh_.subscribe("elevation_map", 1, &RobotWalker::elevationCB, this);
+    }
+    else if(!validate_steps_)
+    {
+        map_sub_.shutdown();
+        elevation_sub_.shutdown();
+    }
+}
+
+bool RobotWalker::validateSteps(const ihmc_msgs::FootstepDataListRosMessage& list, std::vector<StepValidity>& result, size_t firstStep)
+{
+    std::lock_guard<std::mutex> lock(steps_mtx_);
+    if(!validator_.hasMap())
+    {
+        ROS_WARN_THROTTLE(10, "No map received yet, footsteps are not validated");
+        result.clear();
+        return true;
+    }
+    return validator_.validate(list, result, firstStep);
+}
+
+void RobotWalker::mapCB(const nav_msgs::OccupancyGridConstPtr &msg)
+{
+    {
+        std::lock_guard<std::mutex> lock(steps_mtx_);
+        validator_.setOccupancy(msg);
+    }
+    revalidateActiveSteps();
+}
+
+void RobotWalker::elevationCB(const sensor_msgs::PointCloud2ConstPtr &msg)
+{
+    {
+        std::lock_guard<std::mutex> lock(steps_mtx_);
+        validator_.setElevation(*msg, elevation_resolution_);
+    }
+    revalidateActiveSteps();
+}
+
+// stops the walk before a step that the new map shows is no longer safe
+void RobotWalker::revalidateActiveSteps()
+{
+    // the steps are copied, validateSteps and abortWalk take the lock themselves
+    ihmc_msgs::FootstepDataListRosMessage activeSteps;
+    int stepCounter;
+    {
+        std::lock_guard<std::mutex> lock(steps_mtx_);
+        activeSteps = active_steps_;
+        stepCounter = step_counter_;
+    }
+    if(activeSteps.footstep_data_list.empty())
+        return;
+
+    std::vector<StepValidity> validity;
+    if(!validateSteps(activeSteps, validity, stepCounter))
+    {
+        for(size_t i = 0; i < validity.size(); ++i)
+        {
+            if(!validity[i].valid)
+            {
+                ROS_WARN("Step %zu became invalid after a map update: support %.2f collision %d, aborting the walk",
+                         stepCounter + i, validity[i].support_ratio, validity[i].collision);
+                break;
+            }
+        }
+        abortWalk();
+    }
 }
 
 double RobotWalker::getSwingHeight() const
@@ -589,200 +888,75 @@ void RobotWalker::getCurrentStep(int side , ihmc_msgs::FootstepDataRosMessage &
     return;
 }
 
-// gives footstep which are offset from current step (only for straight line)
-
-ihmc_msgs::FootstepDataRosMessage::Ptr RobotWalker::getOffsetStep(int side , float x, float y)
+// gives footsteps which are offset from the current steps
+void RobotWalker::getOffsetSteps(int startLeg, const std::vector<float> &xOffset, const std::vector<float> &yOffset, bool wrtPelvis,
+                                 ihmc_msgs::FootstepDataListRosMessage &list)
 {
+    ihmc_msgs::FootstepDataRosMessage feet[2];
+    getCurrentStep(LEFT, feet[LEFT]);
+    getCurrentStep(RIGHT, feet[RIGHT]);
+
+    tf::Transform pelvisToWorld;
+    tf::Vector3 feetInPelvis[2];
+    if (wrtPelvis){
+        geometry_msgs::Pose pelvisPose;
+        current_state_->getCurrentPose(rd_->getPelvisFrame(), pelvisPose, rd_->getWorldFrame());
+        tf::poseMsgToTF(pelvisPose, pelvisToWorld);
+        for (int side = LEFT; side <= RIGHT; ++side){
+            tf::Vector3 foot;
+            tf::pointMsgToTF(feet[side].location, foot);
+            feetInPelvis[side] = pelvisToWorld.inverse()*foot;
+        }
+    }
 
-    ihmc_msgs::FootstepDataRosMessage::Ptr next(new ihmc_msgs::FootstepDataRosMessage());
-
-    this->getCurrentStep(side, *next);
-    next->location.x+=x;
-    next->location.y+=y;
-    next->swing_height = swing_height_;
-    return next;
-
+    const size_t first = list.footstep_data_list.size();
+    const size_t numberOfSteps = std::min(xOffset.size(), yOffset.size());
+    list.footstep_data_list.resize(first + numberOfSteps);
+    for (size_t m = 0; m < numberOfSteps; ++m) {
+        const int side = m%2 == 0 ? startLeg : (startLeg+1)%2;
+        ihmc_msgs::FootstepDataRosMessage &step = list.footstep_data_list[first + m];
+        step = feet[side];
+        if (wrtPelvis){
+            tf::pointTFToMsg(pelvisToWorld*(feetInPelvis[side] + tf::Vector3(xOffset[m], yOffset[m], 0.0)), step.location);
+        }
+        else{
+            step.location.x += xOffset[m];
+            step.location.y += yOffset[m];
+        }
+        step.swing_height = swing_height_;
+    }
 }
 
-ihmc_msgs::FootstepDataRosMessage::Ptr RobotWalker::getOffsetStepWRTPelvis(int side , float x, float y)
+// places a step template at the current stance
+void RobotWalker::getTemplateSteps(const std::vector<TemplateStep> &steps, ihmc_msgs::FootstepDataListRosMessage &list)
 {
-
-    ihmc_msgs::FootstepDataRosMessage::Ptr next(new ihmc_msgs::FootstepDataRosMessage());
-    geometry_msgs::Point currentFootPosition;
-
-    // get the current step
-    getCurrentStep(side, *next);
-
-    // transform the step to pelvis
-    current_state_->transformPoint(next->location ,currentFootPosition,TOUGH_COMMON_NAMES::WORLD_TF,rd_->getPelvisFrame());
-    // add the offsets wrt to pelvis
-    currentFootPosition.x+=x;
-    currentFootPosition.y+=y;
-    // tranform back the point to world coordinates
-    current_state_->transformPoint(currentFootPosition,next->location,rd_->getPelvisFrame(),TOUGH_COMMON_NAMES::WORLD_TF);
-
-    next->swing_height = swing_height_;
-
-    // return it
-    return next;
+    ihmc_msgs::FootstepDataRosMessage feet[2];
+    getCurrentStep(LEFT, feet[LEFT]);
+    getCurrentStep(RIGHT, feet[RIGHT]);
+
+    // stance frame between the feet, facing the mean of their yaws
+    const double leftYaw  = tf::getYaw(feet[LEFT].orientation);
+    const double rightYaw = tf::getYaw(feet[RIGHT].orientation);
+    const double yaw = std::atan2(std::sin(leftYaw) + std::sin(rightYaw), std::cos(leftYaw) + std::cos(rightYaw));
+    const tf::Transform stance(tf::createQuaternionFromYaw(yaw),
+                               tf::Vector3((feet[LEFT].location.x + feet[RIGHT].location.x)/2,
+                                           (feet[LEFT].location.y + feet[RIGHT].location.y)/2,
+                                           (feet[LEFT].location.z + feet[RIGHT].location.z)/2));
+
+    const size_t first = list.footstep_data_list.size();
+    list.footstep_data_list.resize(first + steps.size());
+    for (size_t m = 0; m < steps.size(); ++m) {
+        ihmc_msgs::FootstepDataRosMessage &step = list.footstep_data_list[first + m];
+        step = feet[steps[m].side];
+        tf::pointTFToMsg(stance*tf::Vector3(steps[m].x, steps[m].y, 0.0), step.location);
+        tf::quaternionTFToMsg(tf::createQuaternionFromYaw(yaw + steps[m].yaw), step.orientation);
+        step.swing_height = swing_height_;
+    }
 }
 
 bool RobotWalker::turn(RobotSide side)
 {
-    ihmc_msgs::FootstepDataListRosMessage list ;
-    list.default_transfer_duration = transfer_time_;
-    list.default_swing_duration    = swing_time_;
-    list.execution_mode        = execution_mode_;
-    list.unique_id             = RobotWalker::id;
-
-    ihmc_msgs::FootstepDataRosMessage step;
-
-    geometry_msgs::PointStamped world_values;
-    geometry_msgs::QuaternionStamped world_quat;
-
-    std::vector<geometry_msgs::PointStamped>    pelvis_valuesL;
-    std::vector<geometry_msgs::QuaternionStamped> pelvis_quatL;
-    std::vector<geometry_msgs::PointStamped>    pelvis_valuesR;
-    std::vector<geometry_msgs::QuaternionStamped> pelvis_quatR;
-
-    // resizing vector based on number of footsteps
-    pelvis_valuesL.resize(5);
-    pelvis_valuesR.resize(5);
-    pelvis_quatL.resize(5);
-    pelvis_quatR.resize(5);
-
-    // Left
-    pelvis_valuesL[0].point.x= 0.135900;
-    pelvis_valuesL[0].point.y= -0.154233;
-    pelvis_valuesL[0].point.z= 0.086523;
-    pelvis_quatL[0].quaternion.w= 0.980231;
-    pelvis_quatL[0].quaternion.x= 0.000016;
-    pelvis_quatL[0].quaternion.y= 0.000160;
-    pelvis_quatL[0].quaternion.z= 0.197856;
-
-    pelvis_valuesL[1].point.x= -0.055072;
-    pelvis_valuesL[1].point.y= 0.034846;
-    pelvis_valuesL[1].point.z= 0.086575;
-    pelvis_quatL[1].quaternion.w= 0.941065;
-    pelvis_quatL[1].quaternion.x= 0.000039;
-    pelvis_quatL[1].quaternion.y= 0.000155;
-    pelvis_quatL[1].quaternion.z= 0.338227;
-
-    pelvis_valuesL[2].point.x= 0.105901;
-    pelvis_valuesL[2].point.y= -0.154402;
-    pelvis_valuesL[2].point.z= 0.086533;
-    pelvis_quatL[2].quaternion.w= 0.902780;
-    pelvis_quatL[2].quaternion.x= 0.000055;
-    pelvis_quatL[2].quaternion.y= 0.000151;
-    pelvis_quatL[2].quaternion.z= 0.430103;
-
-    pelvis_valuesL[3].point.x= -0.084986;
-    pelvis_valuesL[3].point.y= 0.004761;
-    pelvis_valuesL[3].point.z= 0.086586;
-    pelvis_quatL[3].quaternion.w= 0.706102;
-    pelvis_quatL[3].quaternion.x= 0.000101;
-    pelvis_quatL[3].quaternion.y= 0.000123;
-    pelvis_quatL[3].quaternion.z= 0.708111;
-
-    pelvis_valuesL[4].point.x= 0.090027;
-    pelvis_valuesL[4].point.y= 0.000439;
-    pelvis_valuesL[4].point.z= 0.086533;
-    pelvis_quatL[4].quaternion.w= 0.705392;
-    pelvis_quatL[4].quaternion.x= 0.000102;
-    pelvis_quatL[4].quaternion.y= 0.000124;
-    pelvis_quatL[4].quaternion.z= 0.708818;
-
-    // Right
-
-    pelvis_valuesR[0].point.x= -0.064089;
-    pelvis_valuesR[0].point.y= -0.145396;
-    pelvis_valuesR[0].point.z= 0.078471;
-    pelvis_quatR[0].quaternion.w= 0.981378;
-    pelvis_quatR[0].quaternion.x= -0.000023;
-    pelvis_quatR[0].quaternion.y= 0.000136;
-    pelvis_quatR[0].quaternion.z= -0.192087;
-
-    pelvis_valuesR[1].point.x= 0.034601;
-    pelvis_valuesR[1].point.y= 0.085171;
-    pelvis_valuesR[1].point.z= 0.078451;
-    pelvis_quatR[1].quaternion.w= 0.924822;
-    pelvis_quatR[1].quaternion.x= -0.000049;
-    pelvis_quatR[1].quaternion.y= 0.000129;
-    pelvis_quatR[1].quaternion.z= -0.380401;
-
-    pelvis_valuesR[2].point.x= -0.144394;
-    pelvis_valuesR[2].point.y= -0.095886;
-    pelvis_valuesR[2].point.z= 0.078494;
-    pelvis_quatR[2].quaternion.w= 0.833166;
-    pelvis_quatR[2].quaternion.x= -0.000074;
-    pelvis_quatR[2].quaternion.y= 0.000117;
-    pelvis_quatR[2].quaternion.z= -0.553023;
-
-    pelvis_valuesR[3].point.x= 0.084996;
-    pelvis_valuesR[3].point.y= 0.005419;
-    pelvis_valuesR[3].point.z= 0.078437;
-    pelvis_quatR[3].quaternion.w= 0.708850;
-    pelvis_quatR[3].quaternion.x= -0.000094;
-    pelvis_quatR[3].quaternion.y= 0.000100;
-    pelvis_quatR[3].quaternion.z= -0.705359;
-
-    pelvis_valuesR[4].point.x= -0.089976;
-    pelvis_valuesR[4].point.y= -0.000623;
-    pelvis_valuesR[4].point.z= 0.078479;
-    pelvis_quatR[4].quaternion.w= 0.709548;
-    pelvis_quatR[4].quaternion.x= -0.000095;
-    pelvis_quatR[4].quaternion.y= 0.000100;
-    pelvis_quatR[4].quaternion.z= -0.704657;
-
-
-    for (int i = 0; i < pelvis_valuesL.size(); ++i) {
-        pelvis_valuesL[i].header.frame_id=rd_->getPelvisFrame();
-        pelvis_quatL[i].header.frame_id=rd_->getPelvisFrame();
-    }
-
-    for (int i = 0; i < pelvis_valuesR.size(); ++i) {
-        pelvis_valuesR[i].header.frame_id=rd_->getPelvisFrame();
-        pelvis_quatR[i].header.frame_id=rd_->getPelvisFrame();
-    }
-
-
-    if(side==LEFT)
-    {
-        for (int i = 0; i < pelvis_valuesL.size(); ++i) {
-
-            current_state_->transformPoint(pelvis_valuesL[i], world_values);
-            current_state_->transformQuaternion(pelvis_quatL[i], world_quat);
-
-            step.robot_side=i%2 ? LEFT : RIGHT;
-            step.location=world_values.point;
-            step.orientation=world_quat.quaternion;
-
-            list.footstep_data_list.push_back(step);
-
-        }
-    }
-    else
-    {
-        for (int i = 0; i < pelvis_valuesR.size(); ++i) {
-
-            current_state_->transformPoint(pelvis_valuesR[i], world_values);
-            current_state_->transformQuaternion(pelvis_quatR[i], world_quat);
-
-            step.robot_side=i%2 ? LEFT : RIGHT;
-            step.location=world_values.point;
-            step.orientation=world_quat.quaternion;
-
-            list.footstep_data_list.push_back(step);
-
-        }
-    }
-
-    // publish footsteps
-
-    this->footsteps_pub_.publish(list);
-    RobotWalker::id++;
-    this->waitForSteps(list.footstep_data_list.size());
-
+    return walkRotate(side == LEFT ? M_PI_2 : -M_PI_2);
 }
 
 void RobotWalker::loadEEF(RobotSide side, EE_LOADING load)
@@ -798,18 +972,34 @@ void RobotWalker::loadEEF(RobotSide side, EE_LOADING load)
 
 bool RobotWalker::walkRotate(float angle)
 {
+    const std::vector<TemplateStep> &steps = templates_.getTurn(angle);
+    if(steps.empty())
+        return false;
 
-    // get current position
-    ihmc_msgs::FootstepDataRosMessage::Ptr current(new ihmc_msgs::FootstepDataRosMessage());
-    getCurrentStep(RIGHT, *current);
+    ihmc_msgs::FootstepDataListRosMessage list;
+    list.default_transfer_duration = transfer_time_;
+    list.default_swing_duration = swing_time_;
+    list.execution_mode = execution_mode_;
+    list.unique_id = RobotWalker::id;
 
-    geometry_msgs::Pose2D goal;
-    goal.x = current->location.x;
-    goal.y = current->location.y;
-    goal.theta = tf::getYaw(current->orientation)+angle;
-    walkToGoal(goal);
-    return true;
+    getTemplateSteps(steps, list);
+    return this->walkGivenSteps(list);
+}
+
+bool RobotWalker::sidestep(float distance, bool waitForSteps)
+{
+    const std::vector<TemplateStep> &steps = templates_.getSidestep(distance);
+    if(steps.empty())
+        return false;
+
+    ihmc_msgs::FootstepDataListRosMessage list;
+    list.default_transfer_duration = transfer_time_;
+    list.default_swing_duration = swing_time_;
+    list.execution_mode = execution_mode_;
+    list.unique_id = RobotWalker::id;
 
+    getTemplateSteps(steps, list);
+    return this->walkGivenSteps(list, waitForSteps);
 }
 
 bool RobotWalker::climbStair(const std::vector<float> xOffset, const std::vector<float> zOffset, RobotSide startLeg)
@@ -876,15 +1066,19 @@ bool RobotWalker::climbStair(const std::vector<float> xOffset, const std::vector
         list.footstep_data_list.push_back(*newFootStep);
     }
 
-    this->walkGivenSteps(list);
-    return true;
+    return this->walkGivenSteps(list);
 }
 
 // wait till all the steps are taken
 void RobotWalker::waitForSteps(const int numSteps)
 {
-    while (step_counter_ < numSteps && ros::ok())
+    while (ros::ok())
     {
+        {
+            std::lock_guard<std::mutex> lock(steps_mtx_);
+            if (step_counter_ >= numSteps)
+                break;
+        }
         ros::spinOnce();
 
         // hack to detect if robot has fallen and to exit this block
@@ -897,6 +1091,7 @@ void RobotWalker::waitForSteps(const int numSteps)
     }
 
     // reset back the counter
+    std::lock_guard<std::mutex> lock(steps_mtx_);
     step_counter_ = 0;
     return;
 }
@@ -0,0 +1,143 @@
+#include "tough_footstep/StepTemplateLibrary.h"
+#include "tough_common/robot_description.h"
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+
+const float StepTemplateLibrary::ANGLE_RESOLUTION    = M_PI/180.0;
+const float StepTemplateLibrary::DISTANCE_RESOLUTION = 0.01f;
+const float StepTemplateLibrary::POSITION_TOLERANCE  = 0.02f;
+const int   StepTemplateLibrary::MAX_STEP_PAIRS      = 20;
+
+StepTemplateLibrary::StepTemplateLibrary(const StepLimits &limits)
+{
+    setLimits(limits);
+}
+
+StepTemplateLibrary::~StepTemplateLibrary()
+{
+}
+
+StepLimits StepTemplateLibrary::loadLimits(const ros::NodeHandle &nh, const std::string &ns)
+{
+    StepLimits limits;
+    nh.param<float>(ns + "/foot/max/step/x", limits.max_x, limits.max_x);
+    nh.param<float>(ns + "/foot/max/step/y", limits.max_y, limits.max_y);
+    nh.param<float>(ns + "/foot/max/step/theta", limits.max_theta, limits.max_theta);
+    nh.param<float>(ns + "/foot/max/inverse/step/x", limits.min_x, limits.min_x);
+    nh.param<float>(ns + "/foot/max/inverse/step/y", limits.min_y, limits.min_y);
+    nh.param<float>(ns + "/foot/max/inverse/step/theta", limits.min_theta, limits.min_theta);
+    nh.param<float>(ns + "/foot/separation", limits.separation, limits.separation);
+    return limits;
+}
+
+void StepTemplateLibrary::setLimits(const StepLimits &limits)
+{
+    limits_ = limits;
+    turns_.clear();
+    sidesteps_.clear();
+    for(int degrees = -180; degrees <= 180; degrees += 15)
+        getTurn(degrees*ANGLE_RESOLUTION);
+    for(int cm = -100; cm <= 100; cm += 5)
+        getSidestep(cm*DISTANCE_RESOLUTION);
+}
+
+TemplateStep StepTemplateLibrary::clampToLimits(const TemplateStep &support, const TemplateStep &swing) const
+{
+    const float c  = std::cos(support.yaw), s = std::sin(support.yaw);
+    const float wx = swing.x - support.x, wy = swing.y - support.y;
+    // displacement in the frame of the support foot, mirrored for the right foot
+    const float mirror = swing.side == RIGHT ? -1.0f : 1.0f;
+    float dx     = c*wx + s*wy;
+    float dy     = mirror*(-s*wx + c*wy);
+    float dtheta = mirror*std::atan2(std::sin(swing.yaw - support.yaw), std::cos(swing.yaw - support.yaw));
+
+    dx     = std::max(limits_.min_x, std::min(dx, limits_.max_x));
+    dy     = std::max(limits_.min_y, std::min(dy, limits_.max_y));
+    dtheta = std::max(limits_.min_theta, std::min(dtheta, limits_.max_theta));
+
+    dy     *= mirror;
+    dtheta *= mirror;
+    return TemplateStep{swing.side, support.x + c*dx - s*dy, support.y + s*dx + c*dy, support.yaw + dtheta};
+}
+
+/**
+ * @note tries more and more step pairs. Each step goes where place puts it, pulled back within the limits
+ * from the foot left on the ground. The sequence is kept once no step is pulled back by more than
+ * POSITION_TOLERANCE or turned less than asked. The feet start side by side at the separation.
+ */
+template <typename PlaceFn>
+std::vector<TemplateStep> StepTemplateLibrary::buildTemplate(int lead, PlaceFn place) const
+{
+    const int trail = lead == LEFT ? RIGHT : LEFT;
+    std::vector<TemplateStep> steps;
+    for(int pairs = 1; pairs <= MAX_STEP_PAIRS; ++pairs)
+    {
+        TemplateStep feet[2] = {place(LEFT, 0.0f), place(RIGHT, 0.0f)};
+        bool feasible = true;
+        steps.clear();
+        for(int k = 1; k <= pairs && feasible; ++k)
+        {
+            const float fraction = static_cast<float>(k)/pairs;
+            for(int side : {lead, trail})
+            {
+                const TemplateStep target = place(side, fraction);
+                const TemplateStep step = clampToLimits(feet[side == LEFT ? RIGHT : LEFT], target);
+                feasible = feasible && std::hypot(step.x - target.x, step.y - target.y) <= POSITION_TOLERANCE &&
+                           std::fabs(step.yaw - target.yaw) < 1e-4f;
+                feet[side] = step;
+                steps.push_back(step);
+            }
+        }
+        if(feasible)
+            return steps;
+    }
+    return std::vector<TemplateStep>();
+}
+
+const std::vector<TemplateStep>& StepTemplateLibrary::getTurn(float angle)
+{
+    const int key = std::lround(angle/ANGLE_RESOLUTION);
+    auto cached = turns_.find(key);
+    if(cached != turns_.end())
+        return cached->second;
+
+    std::vector<TemplateStep> steps;
+    if(key != 0)
+    {
+        // both feet turn about the center of the stance
+        const float total = key*ANGLE_RESOLUTION;
+        const float half  = limits_.separation/2;
+        steps = buildTemplate(total > 0 ? LEFT : RIGHT, [&](int side, float fraction)
+        {
+            const float a = total*fraction;
+            const float offset = side == LEFT ? half : -half;
+            return TemplateStep{side, -offset*std::sin(a), offset*std::cos(a), a};
+        });
+        if(steps.empty())
+            ROS_WARN("StepTemplateLibrary: no turn of %.2f rad within the step limits", total);
+    }
+    return turns_[key] = steps;
+}
+
+const std::vector<TemplateStep>& StepTemplateLibrary::getSidestep(float distance)
+{
+    const int key = std::lround(distance/DISTANCE_RESOLUTION);
+    auto cached = sidesteps_.find(key);
+    if(cached != sidesteps_.end())
+        return cached->second;
+
+    std::vector<TemplateStep> steps;
+    if(key != 0)
+    {
+        const float total = key*DISTANCE_RESOLUTION;
+        const float half  = limits_.separation/2;
+        steps = buildTemplate(total > 0 ? LEFT : RIGHT, [&](int side, float fraction)
+        {
+            return TemplateStep{side, 0.0f, (side == LEFT ? half : -half) + total*fraction, 0.0f};
+        });
+        if(steps.empty())
+            ROS_WARN("StepTemplateLibrary: no sidestep of %.2f m within the step limits", total);
+    }
+    return sidesteps_[key] = steps;
+}
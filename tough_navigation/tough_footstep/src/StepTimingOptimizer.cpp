@@ -0,0 +1,59 @@
+#include "tough_footstep/StepTimingOptimizer.h"
+#include "tough_common/robot_description.h"
+#include <tf/tf.h>
+#include <algorithm>
+#include <cmath>
+
+StepTimingOptimizer::StepTimingOptimizer(const StepTimingParams &params): params_(params)
+{
+}
+
+StepTimingOptimizer::~StepTimingOptimizer()
+{
+}
+
+StepTimingParams StepTimingOptimizer::loadParams(const ros::NodeHandle &nh, const std::string &ns)
+{
+    StepTimingParams params;
+    nh.param<double>(ns + "/min_swing", params.min_swing, params.min_swing);
+    nh.param<double>(ns + "/min_transfer", params.min_transfer, params.min_transfer);
+    nh.param<double>(ns + "/swing_speed", params.swing_speed, params.swing_speed);
+    nh.param<double>(ns + "/swing_turn_rate", params.swing_turn_rate, params.swing_turn_rate);
+    nh.param<double>(ns + "/step_up_speed", params.step_up_speed, params.step_up_speed);
+    nh.param<double>(ns + "/transfer_speed", params.transfer_speed, params.transfer_speed);
+    nh.param<double>(ns + "/transfer_up_speed", params.transfer_up_speed, params.transfer_up_speed);
+    return params;
+}
+
+/**
+ * @note the transfer before a step moves the weight from between the feet onto the support foot, about half
+ * the distance between them. The swing then takes the foot from its previous step to the new one.
+ */
+void StepTimingOptimizer::apply(const ihmc_msgs::FootstepDataRosMessage feet[2], ihmc_msgs::FootstepDataListRosMessage &list) const
+{
+    geometry_msgs::Point location[2] = {feet[LEFT].location, feet[RIGHT].location};
+    double yaw[2] = {tf::getYaw(feet[LEFT].orientation), tf::getYaw(feet[RIGHT].orientation)};
+
+    for (ihmc_msgs::FootstepDataRosMessage &step : list.footstep_data_list) {
+        const int swing   = step.robot_side == LEFT ? LEFT : RIGHT;
+        const int support = swing == LEFT ? RIGHT : LEFT;
+
+        const double shift   = std::hypot(location[support].x - location[swing].x, location[support].y - location[swing].y)/2;
+        const double shiftUp = std::fabs(location[support].z - location[swing].z);
+        const double transfer = std::max(params_.min_transfer, std::max(shift/params_.transfer_speed,
+                                                                        shiftUp/params_.transfer_up_speed));
+
+        const double stepYaw  = tf::getYaw(step.orientation);
+        const double distance = std::hypot(step.location.x - location[swing].x, step.location.y - location[swing].y);
+        const double turn     = std::fabs(std::atan2(std::sin(stepYaw - yaw[swing]), std::cos(stepYaw - yaw[swing])));
+        const double stepUp   = std::fabs(step.location.z - location[swing].z);
+        const double swingTime = std::max(std::max(params_.min_swing, distance/params_.swing_speed),
+                                          std::max(turn/params_.swing_turn_rate, stepUp/params_.step_up_speed));
+
+        step.transfer_duration = std::min(transfer, list.default_transfer_duration);
+        step.swing_duration    = std::min(swingTime, list.default_swing_duration);
+
+        location[swing] = step.location;
+        yaw[swing]      = stepYaw;
+    }
+}
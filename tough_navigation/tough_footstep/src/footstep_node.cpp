@@ -3,43 +3,145 @@
 #include <tf/transform_broadcaster.h>
 #include <tough_footstep/RobotWalker.h>
 #include <visualization_msgs/MarkerArray.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include "tough_common/robot_description.h"
 
-RobotWalker *walk;
-RobotStateInformer *current_state;
-RobotDescription *rd_;
-ihmc_msgs::FootstepDataListRosMessage list;
-geometry_msgs::Pose pelvisPose;
-
-void WalkToGoal(const geometry_msgs::Pose2D goal) {
-    current_state->getCurrentPose(rd_->getPelvisFrame(), pelvisPose);
-    list.footstep_data_list.clear();
-    list.default_transfer_duration = 1.0;
-    list.default_swing_duration = 1.0;
-    list.execution_mode = 0;
-    list.unique_id = RobotWalker::id;
-
-    bool success = walk->getFootstep(goal,list);
-    std::string result = success ? "Succeded" : "Failed";
-}
-
 double distanceBetweenPoints(const geometry_msgs::Point &point1, const geometry_msgs::Point &point2){
     return sqrt(pow(point1.x - point2.x, 2) + pow(point1.y - point2.y, 2) + pow(point1.z - point2.z, 2));
 }
 
-void publish_footsteps_cb(const std_msgs::Empty msg){
-    if(list.footstep_data_list.empty())
-        return;
-
-    geometry_msgs::Pose currPelvisPose;
-    current_state->getCurrentPose(rd_->getPelvisFrame(), currPelvisPose);
-
-    if(distanceBetweenPoints(currPelvisPose.position, pelvisPose.position) > 0.05)
-        return;
+/**
+ * @brief plans the footsteps to the goals on a fixed pool of threads and keeps the plan until it is approved.
+ * Only the latest goal counts: a new goal replaces the one waiting to be planned and the plans of older
+ * goals are dropped, before planning if they are still waiting and when they finish otherwise.
+ */
+class FootstepPlanQueue
+{
+public:
+    FootstepPlanQueue(RobotWalker *walker, RobotStateInformer *state, RobotDescription *rd, int numWorkers):
+        walker_(walker), state_(state), rd_(rd), stop_(false), latestId_(0)
+    {
+        for (int i = 0; i < std::max(1, numWorkers); ++i){
+            workers_.emplace_back(&FootstepPlanQueue::work, this);
+        }
+    }
+
+    ~FootstepPlanQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &worker : workers_){
+            worker.join();
+        }
+    }
+
+    void addGoal(const geometry_msgs::Pose2D &goal)
+    {
+        std::shared_ptr<PlanRequest> request(new PlanRequest());
+        request->goal = goal;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            request->id = ++latestId_;
+            waiting_ = request;
+            plan_.reset();
+        }
+        cv_.notify_one();
+    }
+
+    // walks the latest plan if the robot did not move since it was planned
+    void approve()
+    {
+        std::shared_ptr<PlanRequest> plan;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            plan = plan_;
+        }
+        if (!plan || plan->list.footstep_data_list.empty()){
+            return;
+        }
+
+        geometry_msgs::Pose currPelvisPose;
+        state_->getCurrentPose(rd_->getPelvisFrame(), currPelvisPose);
+        if (distanceBetweenPoints(currPelvisPose.position, plan->pelvisPose.position) > 0.05){
+            return;
+        }
+
+        {
+            // a newer goal may have come in meanwhile
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (plan_ != plan){
+                return;
+            }
+            plan_.reset();
+        }
+        plan->list.unique_id = RobotWalker::id;
+        walker_->walkGivenSteps(plan->list, false);
+    }
+
+private:
+    struct PlanRequest
+    {
+        uint64_t                                id;
+        geometry_msgs::Pose2D                   goal;
+        geometry_msgs::Pose                     pelvisPose;     // where the robot was when the plan started
+        ihmc_msgs::FootstepDataListRosMessage   list;
+    };
+
+    void work()
+    {
+        while (true){
+            std::shared_ptr<PlanRequest> request;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]{ return stop_ || waiting_; });
+                if (stop_){
+                    return;
+                }
+                request.swap(waiting_);
+            }
+
+            state_->getCurrentPose(rd_->getPelvisFrame(), request->pelvisPose);
+            request->list.default_transfer_duration = 1.0;
+            request->list.default_swing_duration = 1.0;
+            request->list.execution_mode = 0;
+
+            // the planner call cannot be interrupted, a plan that is stale by then is dropped
+            bool success = walker_->getFootstep(request->goal, request->list);
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (request->id != latestId_){
+                ROS_INFO("Dropped the plan to an older goal");
+                continue;
+            }
+            ROS_INFO("Footstep planning %s", success ? "succeeded" : "failed");
+            if (success){
+                plan_ = request;
+            }
+        }
+    }
+
+    RobotWalker *walker_;
+    RobotStateInformer *state_;
+    RobotDescription *rd_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_;
+    uint64_t latestId_;
+    std::shared_ptr<PlanRequest> waiting_;      // latest goal, until a worker takes it
+    std::shared_ptr<PlanRequest> plan_;         // plan to the latest goal, until it is approved
+    std::vector<std::thread> workers_;
+};
+
+FootstepPlanQueue *planQueue;
 
-    walk->walkGivenSteps(list, false);
-    list.footstep_data_list.clear();
+void publish_footsteps_cb(const std_msgs::Empty msg){
+    planQueue->approve();
 }
 
 void nav_goal_cb(const geometry_msgs::PoseStamped::Ptr &goal_3d)
@@ -49,8 +151,7 @@ void nav_goal_cb(const geometry_msgs::PoseStamped::Ptr &goal_3d)
     goal_2d.x = goal_3d->pose.position.x;
     goal_2d.y = goal_3d->pose.position.y;
     goal_2d.theta = tf::getYaw(goal_3d->pose.orientation);
-    std::thread t1 = std::thread(WalkToGoal, goal_2d);
-    t1.detach();
+    planQueue->addGoal(goal_2d);
 }
 
 int main(int argc, char** argv)
@@ -58,9 +159,14 @@ int main(int argc, char** argv)
     ros::init(argc, argv, "footstep_node");
     ros::NodeHandle nh;
 
-    current_state = RobotStateInformer::getRobotStateInformer(nh);
-    rd_ = RobotDescription::getRobotDescription(nh);
-    walk = new RobotWalker(nh, 0.8f, 0.8f, 0, 0.18);
+    RobotStateInformer *current_state = RobotStateInformer::getRobotStateInformer(nh);
+    RobotDescription *rd = RobotDescription::getRobotDescription(nh);
+    RobotWalker *walk = new RobotWalker(nh, 0.8f, 0.8f, 0, 0.18);
+
+    // the planner serves one request at a time, more workers only help if it is run elsewhere
+    int planningWorkers;
+    ros::param::param<int>("~planning_workers", planningWorkers, 1);
+    planQueue = new FootstepPlanQueue(walk, current_state, rd, planningWorkers);
 
     ros::Subscriber nav_goal_sub    = nh.subscribe("/goal", 1, &nav_goal_cb);
     ros::Subscriber nav_goal_sub2    = nh.subscribe("/move_base_simple/goal", 1, &nav_goal_cb);
@@ -68,6 +174,7 @@ int main(int argc, char** argv)
 
     footstep_planner::FootstepPlannerNode planner;
     ros::spin();
+    delete planQueue;
     delete walk;
     return 0;
 
@@ -1,6 +1,54 @@
 #ifndef VAL_SELF_FILTER_H
 #define VAL_SELF_FILTER_H
 
+#include <ros/ros.h>
+#include <visualization_msgs/Marker.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud_conversion.h>
+#include <pcl/filters/extract_indices.h>
+#include <atomic>
 
+#include "robot_self_filter/self_mask.h"
+
+/**
+ * @brief robot_filter removes the points of the laser cloud that fall on the robot links listed in
+ * the self_see_links parameter
+ */
+class robot_filter
+{
+public:
+
+    /**
+     * @brief robot_filter subscribes to the laser cloud and publishes the filtered clouds
+     * @param nh node handle of the topics, the nodelet passes its own
+     * @param pnh private node handle of the self_see_links parameter
+     */
+    robot_filter(ros::NodeHandle nh = ros::NodeHandle(), ros::NodeHandle pnh = ros::NodeHandle("~"));
+
+    ~robot_filter(void);
+
+    void run(sensor_msgs::PointCloud::ConstPtr msg_in);
+
+    void subtractPointClouds(pcl::PointCloud<pcl::PointXYZ>::Ptr full_cloud, const pcl::PointIndices::Ptr outliers);
+
+protected:
+
+    double uniform(double magnitude)
+    {
+        return (2.0 * drand48() - 1.0) * magnitude;
+    }
+
+    tf::TransformListener                           tf_;
+    robot_self_filter::SelfMask<pcl::PointXYZ>      *sf_;
+    ros::Publisher                                  vmPub_;
+    ros::Publisher                                  vmOutputPub_;
+    ros::Publisher                                  vmOutputPub2_;
+    ros::Subscriber                                 vmSub_;
+    ros::NodeHandle                                 nodeHandle_;
+    pcl::PointCloud<pcl::PointXYZ>                  maskCloud_;
+
+    int                                             id_;
+    std::atomic<bool>                               isFiltering_;   // a scan that comes in while one is filtered is dropped
+};
 
 #endif // VAL_SELF_FILTER_H
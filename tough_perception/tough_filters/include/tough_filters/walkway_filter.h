@@ -7,7 +7,6 @@
 #define FOOT_GROUND_THRESHOLD 0.05
 
 #include <ros/ros.h>
-#include <pcl/filters/extract_indices.h>
 #include <pcl/point_types.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl/filters/passthrough.h>
@@ -18,10 +17,18 @@
 
 class WalkwayFilter{
 public:
-    WalkwayFilter(ros::NodeHandle &n);
+    /**
+     * @param n node handle of the topics
+     * @param pnh private node handle used to read the parameters, the nodelet passes its own
+     */
+    WalkwayFilter(ros::NodeHandle &n, ros::NodeHandle pnh = ros::NodeHandle("~"));
     ~WalkwayFilter();
-    void generateMap(pcl::PointCloud<pcl::PointXYZ>::Ptr msg);
-    void subtractPointClouds(pcl::PointCloud<pcl::PointXYZ>::Ptr full_cloud, const pcl::PointIndices::Ptr outliers);
+    void generateMap(const sensor_msgs::PointCloud2ConstPtr &msg);
+    /**
+     * @brief removes the points of the ground band below the feet. The kept points are moved to the front
+     * of the cloud in a single pass, keeping their order, and the cloud is shrunk without a copy.
+     */
+    void removeGroundBand(pcl::PointCloud<pcl::PointXYZ> &cloud, float foot_height);
 
 private:
     ros::Publisher mapPub_;
@@ -30,7 +37,20 @@ private:
     ros::NodeHandle nh_;
     tf::TransformListener       tf_listener_;
     RobotDescription* rd_;
-    double getCurrentFootHeight(void);
+
+    // foot height of the last lookup, reused by clouds with the same stamp and when tf fails
+    ros::Time foot_height_stamp_;
+    double foot_height_;
+    bool foot_height_valid_;
+    double tf_timeout_;
+
+    /**
+     * @brief gives the height of the lower foot at the time of the cloud
+     * @param stamp time of the cloud
+     * @param height the height of the lower foot in world
+     * @return false if the height was never available
+     */
+    bool getFootHeight(const ros::Time &stamp, double &height);
 };
 
 #endif // WALKWAY_FILTER_H
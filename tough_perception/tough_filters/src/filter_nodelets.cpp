@@ -0,0 +1,41 @@
+/**
+ ********************************************************************************************************
+ * @file    filter_nodelets.cpp
+ * @brief   nodelet wrappers of the laser cloud filters
+ * @details The robot self filter and the walkway filter loaded in the perception nodelet manager receive
+ *          and publish their clouds as shared pointers instead of serializing them.
+ ********************************************************************************************************
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <tough_filters/robot_filter.h>
+#include <tough_filters/walkway_filter.h>
+#include <memory>
+
+namespace tough_filters {
+
+class RobotFilterNodelet : public nodelet::Nodelet
+{
+    std::unique_ptr<robot_filter> filter_;
+
+    virtual void onInit()
+    {
+        filter_.reset(new robot_filter(getNodeHandle(), getPrivateNodeHandle()));
+    }
+};
+
+class WalkwayFilterNodelet : public nodelet::Nodelet
+{
+    std::unique_ptr<WalkwayFilter> filter_;
+
+    virtual void onInit()
+    {
+        filter_.reset(new WalkwayFilter(getNodeHandle(), getPrivateNodeHandle()));
+    }
+};
+
+} /* namespace tough_filters */
+
+PLUGINLIB_EXPORT_CLASS(tough_filters::RobotFilterNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(tough_filters::WalkwayFilterNodelet, nodelet::Nodelet)
@@ -0,0 +1,12 @@
+#include "tough_filters/robot_filter.h"
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "robot_filter");
+
+    robot_filter t;
+    ros::spin();
+    //    t.run();
+
+    return 0;
+}
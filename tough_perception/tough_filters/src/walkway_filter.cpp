@@ -5,9 +5,13 @@
 #include <tough_common/tough_common_names.h>
 #include <tough_filters/walkway_filter.h>
 #include <tough_perception_common/perception_common_names.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <algorithm>
 
-WalkwayFilter::WalkwayFilter(ros::NodeHandle &n):nh_(n)
+WalkwayFilter::WalkwayFilter(ros::NodeHandle &n, ros::NodeHandle pnh):nh_(n), foot_height_(0.0), foot_height_valid_(false)
 {
+    pnh.param<double>("tf_timeout", tf_timeout_, 0.1);
+
     pointcloudPub_ = nh_.advertise<pcl::PointCloud<pcl::PointXYZ> >("walkway_filtered_points2",1, true);
     pointcloudSub_ = nh_.subscribe(PERCEPTION_COMMON_NAMES::ASSEMBLED_LASER_CLOUD_TOPIC_FOR_OCTOMAP, 1,  &WalkwayFilter::generateMap, this);
     rd_ = RobotDescription::getRobotDescription(nh_);
@@ -19,56 +23,66 @@ WalkwayFilter::~WalkwayFilter()
     pointcloudSub_.shutdown();
 }
 
-void WalkwayFilter::generateMap(pcl::PointCloud<pcl::PointXYZ>::Ptr cloud)
+void WalkwayFilter::generateMap(const sensor_msgs::PointCloud2ConstPtr &msg)
 {
+    // subscribed as PointCloud2 so that the cloud is not serialized inside a nodelet manager, it is still
+    // copied into the pcl cloud
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::fromROSMsg(*msg, *cloud);
     if(cloud->empty())
         return;
 
-    pcl::PointIndices::Ptr outliers(new pcl::PointIndices());
-    outliers->header = cloud->header;
-
-    float foot_height = getCurrentFootHeight();
-    std::cout<<  foot_height << std::endl;
+    double foot_height;
+    if(!getFootHeight(msg->header.stamp, foot_height))
+        return;
 
-    for (size_t i = 0; i< cloud->size(); ++i){
-        if( cloud->at(i).z < foot_height - FOOT_GROUND_THRESHOLD
-                && cloud->at(i).z > foot_height - FOOT_GROUND_THRESHOLD - (GROUND_THRESHOLD)){
-            outliers->indices.insert(outliers->indices.end(),i);
-        }
-    }
-    subtractPointClouds(cloud,outliers);
+    removeGroundBand(*cloud, foot_height);
     pointcloudPub_.publish(cloud);
 }
 
-double WalkwayFilter::getCurrentFootHeight(void)
+void WalkwayFilter::removeGroundBand(pcl::PointCloud<pcl::PointXYZ> &cloud, float foot_height)
 {
-    double height_foot;
-
-    tf::StampedTransform transformStamped;
-    tf_listener_.lookupTransform( TOUGH_COMMON_NAMES::WORLD_TF, rd_->getLeftFootFrameName(), ros::Time(0),transformStamped);
-    height_foot = transformStamped.getOrigin().getZ();
+    const float max_z = foot_height - FOOT_GROUND_THRESHOLD;
+    const float min_z = max_z - GROUND_THRESHOLD;
 
-    tf_listener_.lookupTransform( TOUGH_COMMON_NAMES::WORLD_TF, rd_->getRightFootFrameName(), ros::Time(0),transformStamped);
+    auto kept_end = std::remove_if(cloud.points.begin(), cloud.points.end(),
+                                   [min_z, max_z](const pcl::PointXYZ &pt) { return pt.z < max_z && pt.z > min_z; });
+    cloud.points.erase(kept_end, cloud.points.end());
+    cloud.width  = cloud.points.size();
+    cloud.height = 1;
+}
 
-    height_foot = height_foot > transformStamped.getOrigin().getZ() ? transformStamped.getOrigin().getZ() : height_foot;
+bool WalkwayFilter::getFootHeight(const ros::Time &stamp, double &height)
+{
+    if(foot_height_valid_ && stamp == foot_height_stamp_)
+    {
+        height = foot_height_;
+        return true;
+    }
 
-    return height_foot;
-}
+    try
+    {
+        tf::StampedTransform left_foot, right_foot;
+        tf_listener_.waitForTransform(TOUGH_COMMON_NAMES::WORLD_TF, rd_->getLeftFootFrameName(), stamp, ros::Duration(tf_timeout_));
+        tf_listener_.lookupTransform(TOUGH_COMMON_NAMES::WORLD_TF, rd_->getLeftFootFrameName(), stamp, left_foot);
+        tf_listener_.waitForTransform(TOUGH_COMMON_NAMES::WORLD_TF, rd_->getRightFootFrameName(), stamp, ros::Duration(tf_timeout_));
+        tf_listener_.lookupTransform(TOUGH_COMMON_NAMES::WORLD_TF, rd_->getRightFootFrameName(), stamp, right_foot);
 
-void WalkwayFilter::subtractPointClouds(pcl::PointCloud<pcl::PointXYZ>::Ptr full_cloud, const pcl::PointIndices::Ptr outliers){
-    pcl::ExtractIndices<pcl::PointXYZ> extract ;
-    extract.setInputCloud(full_cloud);
-    extract.setIndices(outliers);
-    extract.setNegative (true);
-    extract.filter (*full_cloud);
-    return;
-}
+        foot_height_       = std::min(left_foot.getOrigin().getZ(), right_foot.getOrigin().getZ());
+        foot_height_stamp_ = stamp;
+        foot_height_valid_ = true;
+    }
+    catch(tf::TransformException &ex)
+    {
+        // the feet barely move vertically between clouds, the last height is better than dropping the update
+        if(!foot_height_valid_)
+        {
+            ROS_WARN_THROTTLE(1.0, "WalkwayFilter::getFootHeight : %s", ex.what());
+            return false;
+        }
+        ROS_WARN_THROTTLE(1.0, "WalkwayFilter::getFootHeight : using the last foot height, %s", ex.what());
+    }
 
-int main(int argc, char** argv){
-    ros::init(argc, argv, "walkway_filter");
-    ROS_INFO("Starting walkway filter node");
-    ros::NodeHandle n;
-    WalkwayFilter m(n);
-    ros::spin();
-    return 0;
+    height = foot_height_;
+    return true;
 }
@@ -0,0 +1,10 @@
+#include <tough_filters/walkway_filter.h>
+
+int main(int argc, char** argv){
+    ros::init(argc, argv, "walkway_filter");
+    ROS_INFO("Starting walkway filter node");
+    ros::NodeHandle n;
+    WalkwayFilter m(n);
+    ros::spin();
+    return 0;
+}
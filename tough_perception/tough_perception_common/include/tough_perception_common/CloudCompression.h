@@ -0,0 +1,107 @@
+/**
+ ********************************************************************************************************
+ * @file    CloudCompression.h
+ * @brief   octree based point cloud codec
+ * @details Compresses xyz clouds with quantized coordinates. Key frames are followed by delta frames
+ *          that only encode the change of the octree with respect to the previous cloud.
+ ********************************************************************************************************
+ */
+
+#ifndef CLOUDCOMPRESSION_H_
+#define CLOUDCOMPRESSION_H_
+
+#include <tough_perception_common/global.h>
+#include <tough_perception_common/CompressedCloud.h>
+#include <pcl/compression/octree_pointcloud_compression.h>
+#include <memory>
+
+namespace tough_perception {
+
+/**
+ * @brief OctreeCodec exposes the type of the last encoded frame of the pcl codec
+ */
+class OctreeCodec : public pcl::io::OctreePointCloudCompression<pcl::PointXYZ>
+{
+public:
+    OctreeCodec(double point_resolution, double octree_resolution, unsigned int key_frame_rate):
+        pcl::io::OctreePointCloudCompression<pcl::PointXYZ>(pcl::io::MANUAL_CONFIGURATION, false, point_resolution,
+                                                             octree_resolution, false, key_frame_rate, false)
+    {
+    }
+
+    bool isKeyFrame() const
+    {
+        return i_frame_;
+    }
+};
+
+class CloudEncoder
+{
+    DISALLOW_COPY_AND_ASSIGN(CloudEncoder)
+
+    std::unique_ptr<OctreeCodec>    codec_;
+    double                          point_resolution_;
+    double                          octree_resolution_;
+    unsigned int                    key_frame_rate_;
+    uint32_t                        seq_;
+
+public:
+    /**
+     * @brief Constructor
+     * @param point_resolution precision of the coordinates in meters
+     * @param octree_resolution size of the octree leaves in meters. Points in the same leaf are
+     *                          encoded relative to the leaf.
+     * @param key_frame_rate a key frame is sent every key_frame_rate frames
+     */
+    CloudEncoder(double point_resolution, double octree_resolution, unsigned int key_frame_rate);
+
+    /**
+     * @brief encodes a cloud as a key frame or as a delta against the previous cloud
+     * @param cloud the cloud
+     * @param msg the compressed cloud, the header is copied from the cloud
+     */
+    void encode(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &cloud, tough_perception_common::CompressedCloud &msg);
+
+    /**
+     * @brief the next frame is encoded as a key frame
+     */
+    void forceKeyFrame();
+
+    virtual ~CloudEncoder();
+};
+
+class CloudDecoder
+{
+    DISALLOW_COPY_AND_ASSIGN(CloudDecoder)
+
+    OctreeCodec     codec_;
+    uint32_t        last_seq_;
+    bool            synced_;
+    uint64_t        dropped_;
+
+public:
+    CloudDecoder();
+
+    /**
+     * @brief decodes a compressed cloud. Delta frames are dropped after a missed frame until the
+     *        next key frame is received.
+     * @param msg the compressed cloud
+     * @param cloud the decoded cloud
+     * @return false if the frame was dropped
+     */
+    bool decode(const tough_perception_common::CompressedCloud &msg, pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud);
+
+    /**
+     * @brief number of delta frames dropped because a previous frame was missed
+     */
+    uint64_t droppedFrames() const
+    {
+        return dropped_;
+    }
+
+    virtual ~CloudDecoder();
+};
+
+} /* namespace tough_perception */
+
+#endif /* CLOUDCOMPRESSION_H_ */
@@ -0,0 +1,89 @@
+/**
+ ********************************************************************************************************
+ * @file    DepthConditioner.h
+ * @brief   confidence filtering and temporal fusion of depth images
+ * @details Masks the depth pixels whose stereo matching cost is too high and fuses the remaining ones
+ *          over the last frames with a per pixel running mean and variance. The history is dropped
+ *          when the camera moves, so that frames are only fused while the head holds still.
+ ********************************************************************************************************
+ */
+
+#ifndef DEPTHCONDITIONER_H_
+#define DEPTHCONDITIONER_H_
+
+#include <tough_perception_common/global.h>
+
+namespace tough_perception {
+
+/**
+ * @brief parameters of the depth conditioner. Depths are in meters and angles in radians.
+ */
+struct DepthConditionerParams
+{
+    int     max_cost;           // pixels with a higher matching cost are masked
+    float   min_depth;          // valid depth range
+    float   max_depth;
+    int     window;             // number of frames fused per pixel
+    int     min_samples;        // fewest fused frames to output a pixel
+    float   depth_noise;        // std dev of a single measurement is depth_noise*depth^2
+    float   outlier_gate;       // a measurement this many std dev away from the mean restarts the pixel
+    float   max_translation;    // camera motion between frames above which the history is dropped
+    float   max_rotation;
+    int     num_threads;        // 0 to use all the available cores
+
+    DepthConditionerParams():
+        max_cost(64), min_depth(0.3f), max_depth(10.0f), window(5), min_samples(1), depth_noise(0.005f),
+        outlier_gate(3.0f), max_translation(0.01f), max_rotation(0.003f), num_threads(0)
+    {
+    }
+};
+
+class DepthConditioner
+{
+    DISALLOW_COPY_AND_ASSIGN(DepthConditioner)
+
+    DepthConditionerParams  params_;
+
+    // per pixel history, reused between frames of the same size
+    cv::Mat                 mean_;          // CV_32FC1
+    cv::Mat                 variance_;      // CV_32FC1, variance of the measurements
+    cv::Mat                 count_;         // CV_8UC1, frames fused
+    cv::Mat                 cost_;          // cost resized to the depth when their sizes differ
+
+    bool                    has_pose_;
+    Eigen::Vector3f         last_translation_;
+    Eigen::Matrix3f         last_rotation_;
+
+    /**
+     * @brief checks the camera motion since the previous frame
+     * @return true if the history can be fused with the new frame
+     */
+    bool isStill(const Eigen::Affine3f &camera_pose);
+    void update(int row_begin, int row_end, const cv::Mat &depth, const cv::Mat &cost, cv::Mat &conditioned, cv::Mat &variance);
+
+public:
+    DepthConditioner(const DepthConditionerParams &params = DepthConditionerParams());
+
+    /**
+     * @brief masks and fuses a depth frame
+     * @param depth depth image as CV_32FC1, invalid pixels are 0 or not finite
+     * @param cost matching cost as CV_8UC1, resized to the depth if needed. An empty cost masks nothing.
+     * @param camera_pose pose of the camera in a fixed frame at the time of the frame
+     * @param conditioned fused depth as CV_32FC1, NaN where masked or not fused enough
+     * @param variance variance of the fused depth as CV_32FC1, NaN where conditioned is NaN
+     * @return false if the images are not of the expected types
+     */
+    bool condition(const cv::Mat &depth, const cv::Mat &cost, const Eigen::Affine3f &camera_pose,
+                   cv::Mat &conditioned, cv::Mat &variance);
+
+    /**
+     * @brief drops the history of all the pixels
+     */
+    void reset();
+
+    virtual ~DepthConditioner();
+};
+
+} /* namespace tough_perception */
+
+#endif /* DEPTHCONDITIONER_H_ */
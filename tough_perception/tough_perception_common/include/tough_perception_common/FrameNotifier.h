@@ -0,0 +1,88 @@
+/**
+ ********************************************************************************************************
+ * @file    FrameNotifier.h
+ * @brief   push based delivery of frames to registered consumers
+ * @details Used by MultisenseImage and MultisensePointCloud to call consumer callbacks and to fulfill
+ *          futures waiting for the next frame after a given time.
+ ********************************************************************************************************
+ */
+
+#ifndef FRAMENOTIFIER_H_
+#define FRAMENOTIFIER_H_
+
+#include <ros/ros.h>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+
+namespace tough_perception {
+
+template <typename T>
+class FrameNotifier
+{
+public:
+    typedef std::function<void(const T &frame, const ros::Time &stamp)> Callback;
+
+    /**
+     * @brief registers a callback that is called for every new frame
+     * @param callback the callback, executed by the thread that receives the frame
+     */
+    void registerCallback(const Callback &callback)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callbacks_.push_back(callback);
+    }
+
+    /**
+     * @brief gives a future that is fulfilled by the first frame stamped after time
+     * @param time frames stamped at or before this time are ignored
+     * @return the future
+     */
+    std::future<T> nextAfter(const ros::Time &time)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waiters_.emplace_back(time, std::promise<T>());
+        return waiters_.back().second.get_future();
+    }
+
+    /**
+     * @brief delivers a new frame to the callbacks and the waiting futures
+     * @param frame the frame
+     * @param stamp the time the frame was captured
+     */
+    void notify(const T &frame, const ros::Time &stamp)
+    {
+        std::vector<Callback> callbacks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            callbacks = callbacks_;
+            for(auto it = waiters_.begin(); it != waiters_.end();)
+            {
+                if(stamp > it->first)
+                {
+                    it->second.set_value(frame);
+                    it = waiters_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        // callbacks are called without the lock so that they can register more consumers
+        for(const auto &callback : callbacks)
+        {
+            callback(frame, stamp);
+        }
+    }
+
+private:
+    std::mutex                                          mutex_;
+    std::vector<Callback>                               callbacks_;
+    std::vector<std::pair<ros::Time, std::promise<T>>>  waiters_;
+};
+
+} /* namespace tough_perception */
+
+#endif /* FRAMENOTIFIER_H_ */
@@ -0,0 +1,90 @@
+/**
+ ********************************************************************************************************
+ * @file    ImageSynchronizer.h
+ * @brief   bounded memory approximate time synchronizer for image streams
+ * @details Frames of each stream are kept in a small fixed ring. A set of frames is emitted when every
+ *          stream has a frame within the stamp tolerance of the newest frame.
+ ********************************************************************************************************
+ */
+
+#ifndef IMAGESYNCHRONIZER_H_
+#define IMAGESYNCHRONIZER_H_
+
+#include <tough_perception_common/global.h>
+#include <sensor_msgs/Image.h>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace tough_perception {
+
+class ImageSynchronizer
+{
+    DISALLOW_COPY_AND_ASSIGN(ImageSynchronizer)
+
+public:
+    typedef std::vector<sensor_msgs::ImageConstPtr>         ImageSet;
+    typedef std::function<void(const ImageSet &images)>     Callback;
+
+    struct Statistics
+    {
+        uint64_t    matched;        // number of sets emitted
+        uint64_t    dropped;        // number of frames discarded without being part of a set
+        double      mean_latency;   // mean age in seconds of a set when it is emitted
+        double      max_latency;    // max age in seconds of a set when it is emitted
+    };
+
+    /**
+     * @brief Constructor
+     * @param num_streams number of image streams that are synchronized
+     * @param ring_size   number of frames kept per stream, older frames are dropped
+     * @param tolerance   max difference between the stamps of the frames of a set
+     * @param callback    called with one frame per stream, in the order of the streams
+     */
+    ImageSynchronizer(size_t num_streams, size_t ring_size, const ros::Duration &tolerance, const Callback &callback);
+
+    /**
+     * @brief adds a frame of a stream. This is thread safe and the callback is executed by the calling thread.
+     * @param stream index of the stream
+     * @param image  the frame
+     */
+    void add(size_t stream, const sensor_msgs::ImageConstPtr &image);
+
+    Statistics getStatistics() const;
+
+    virtual ~ImageSynchronizer();
+
+private:
+    // fixed size ring of the frames of one stream
+    struct Ring
+    {
+        std::vector<sensor_msgs::ImageConstPtr> frames;
+        size_t                                  head;   // index of the oldest frame
+        size_t                                  count;
+    };
+
+    const sensor_msgs::ImageConstPtr& frameAt(const Ring &ring, size_t i) const
+    {
+        return ring.frames[(ring.head + i) % ring.frames.size()];
+    }
+    /**
+     * @brief removes the oldest frames of a ring
+     * @param ring the ring
+     * @param n number of frames removed
+     */
+    void popFront(Ring &ring, size_t n);
+
+    std::vector<Ring>       rings_;
+    ros::Duration           tolerance_;
+    Callback                callback_;
+
+    mutable std::mutex      mutex_;
+    uint64_t                matched_;
+    uint64_t                dropped_;
+    double                  latency_sum_;
+    double                  max_latency_;
+};
+
+} /* namespace tough_perception */
+
+#endif /* IMAGESYNCHRONIZER_H_ */
@@ -12,17 +12,16 @@
 
 /*** INCLUDE FILES ***/
 #include <tough_perception_common/global.h>
+#include <tough_perception_common/StereoMatcher.h>
 #include <image_transport/image_transport.h>
 #include <multisense_ros/RawCamConfig.h>
 #include <stereo_msgs/DisparityImage.h>
 #include <cv_bridge/cv_bridge.h>
 
-#include <message_filters/subscriber.h>
-#include <message_filters/synchronizer.h>
-#include <message_filters/sync_policies/exact_time.h>
-#include <message_filters/sync_policies/approximate_time.h>
+#include <tough_perception_common/ImageSynchronizer.h>
+#include <tough_perception_common/FrameNotifier.h>
 #include <sensor_msgs/Image.h>
-#include <image_transport/subscriber_filter.h>
+#include <atomic>
 #include <memory>
 
 namespace tough_perception {
@@ -64,36 +63,41 @@ class MultisenseImage {
     depth_cost_topic_,
     multisense_topic_;
 
-    bool					new_image_;
-    bool            		new_disp_;
-    bool            		new_depth_;
-    bool            		new_cost_;
+    std::atomic<bool>		new_image_;
+    std::atomic<bool>		new_disp_;
+    std::atomic<bool>		new_depth_;
+    std::atomic<bool>		new_cost_;
 
-    static bool				image_callback_active_;
-    static bool				disp_callback_active_;
-    static bool				config_callback_active_;
-    static bool				cost_callback_active_;
-    static bool				depth_callback_active_;
+    // subscribers are started per object on the first request
+    std::atomic<bool>		image_callback_active_;
+    std::atomic<bool>		disp_callback_active_;
+    std::atomic<bool>		config_callback_active_;
+    std::atomic<bool>		cost_callback_active_;
+    std::atomic<bool>		depth_callback_active_;
+
+    FrameNotifier<cv::Mat>  image_notifier_;
+    FrameNotifier<cv::Mat>  disparity_notifier_;
+    FrameNotifier<cv::Mat>  depth_notifier_;
 
     image_transport::ImageTransport it_;
 
     image_transport::Subscriber 		cam_sub_;
-    image_transport::SubscriberFilter   *sync_cam_sub_;
-    image_transport::SubscriberFilter   *sync_cam_depth_sub_;
-    image_transport::SubscriberFilter   *sync_cam_cost_sub_;
-#ifndef GAZEBO_SIMULATION
-    typedef message_filters::sync_policies::ExactTime<sensor_msgs::Image, sensor_msgs::Image> exactTimePolicy;
-    std::shared_ptr<message_filters::Synchronizer< exactTimePolicy > > sync_;
-    image_transport::SubscriberFilter   *sync_disp_sub_;
 
+    // synchronizers are declared before their subscribers so that the subscribers are shutdown first
+    size_t                              sync_ring_size_;
+    ros::Duration                       sync_tolerance_;
+    std::unique_ptr<ImageSynchronizer>  sync_;              // color + disparity
+    std::unique_ptr<ImageSynchronizer>  sync_depth_;        // color + depth + cost
+    image_transport::Subscriber         sync_cam_sub_;
+    image_transport::Subscriber         sync_depth_cam_sub_;
+    image_transport::Subscriber         sync_cam_depth_sub_;
+    image_transport::Subscriber         sync_cam_cost_sub_;
+#ifndef GAZEBO_SIMULATION
+    image_transport::Subscriber         sync_disp_sub_;
 #else
-    typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, stereo_msgs::DisparityImage> approxTimePolicy;
-    std::shared_ptr<message_filters::Synchronizer< approxTimePolicy > > sync_;
+    ros::Subscriber                     sync_disp_sub_;     // stereo_msgs::DisparityImage
 #endif
 
-    typedef message_filters::sync_policies::ExactTime<sensor_msgs::Image, sensor_msgs::Image, sensor_msgs::Image> depthImageCostExactTimePolicy;
-    std::shared_ptr<message_filters::Synchronizer< depthImageCostExactTimePolicy > > sync_depth_;
-
     image_transport::Subscriber 		depth_sub_;
     image_transport::Subscriber 		cost_sub_;
 #ifndef GAZEBO_SIMULATION
@@ -101,10 +105,17 @@ class MultisenseImage {
 
 #else
     ros::Subscriber 					disp_sub_;
-    message_filters::Subscriber<stereo_msgs::DisparityImage> *sync_disp_sub_;
 #endif
     ros::Subscriber						multisense_sub_;
 
+    // CPU stereo fallback, computes disparity, depth and cost from the rectified left and right images
+    bool                                use_cpu_stereo_;
+    std::string                         right_image_topic_;
+    std::unique_ptr<StereoMatcher>      stereo_matcher_;
+    std::unique_ptr<ImageSynchronizer>  sync_stereo_;       // left + right
+    image_transport::Subscriber         sync_left_sub_;
+    image_transport::Subscriber         sync_right_sub_;
+
     /**
      * @brief this function is the callback for loading the images, as of now it needs the image topic to
      *        have the camerainfo be published, but I think this should be removed as multisense head does
@@ -142,12 +153,37 @@ class MultisenseImage {
     void loadDisparityImageStereoMsgs(const stereo_msgs::DisparityImageConstPtr &img);
 #endif
 
-#ifndef GAZEBO_SIMULATION
-    void syncCallback(const sensor_msgs::ImageConstPtr &img, const sensor_msgs::ImageConstPtr &dimg);
-#else
-    void syncCallback(const sensor_msgs::ImageConstPtr &img, const stereo_msgs::DisparityImageConstPtr &dimg);
-#endif
-    void syncDepthCallback(const sensor_msgs::ImageConstPtr &img, const sensor_msgs::ImageConstPtr &dimg, const sensor_msgs::ImageConstPtr &cimg);
+    /**
+     * @brief callback of the color + disparity synchronizer
+     * @param images the color and disparity image
+     */
+    void syncCallback(const ImageSynchronizer::ImageSet &images);
+    /**
+     * @brief callback of the color + depth + cost synchronizer
+     * @param images the color, depth and cost image
+     */
+    void syncDepthCallback(const ImageSynchronizer::ImageSet &images);
+
+    /**
+     * @brief this function is the callback for a synchronized left and right image pair when the CPU stereo
+     *        is used. It fills the image, disparity, depth and cost.
+     * @param images the rectified left and right image
+     */
+    void stereoPairCallback(const ImageSynchronizer::ImageSet &images);
+
+    /**
+     * @brief starts the left and right image subscribers used by the CPU stereo if not started
+     */
+    void startCpuStereo();
+
+    /**
+     * @brief these functions start the subscribers if not started, they do not wait for data
+     */
+    void subscribeImage();
+    void subscribeDisparity();
+    void subscribeDepth();
+    void subscribeCost();
+    void subscribeConfig();
 public:
     /**
      * @brief Constructor
@@ -209,6 +245,59 @@ public:
 
     bool giveSyncDepthImageswTime(cv::Mat &color, cv::Mat &disp, cv::Mat &cost, ros::Time &time);
 
+    /**
+     * @brief gives the matched/dropped frame and latency counters of the synchronizer used by giveSyncImages
+     * @param stats the statistics
+     * @return false if giveSyncImages was not called yet
+     */
+    bool giveSyncStatistics(ImageSynchronizer::Statistics &stats);
+
+    /**
+     * @brief gives the matched/dropped frame and latency counters of the synchronizer used by giveSyncDepthImages
+     * @param stats the statistics
+     * @return false if giveSyncDepthImages was not called yet
+     */
+    bool giveSyncDepthStatistics(ImageSynchronizer::Statistics &stats);
+
+    /**
+     * @brief computes the disparity, depth and cost from a rectified image pair with the CPU stereo matcher.
+     *        This can be used offline, the camera settings must be available to compute the depth.
+     * @param left  the rectified left image
+     * @param right the rectified right image
+     * @param disp  the disparity image as CV_32F
+     * @param depth the depth image as CV_32F in meters, empty if the camera settings are not available
+     * @param cost  the matching cost as CV_8U
+     * @return false if the disparity could not be computed
+     */
+    bool computeStereo(const cv::Mat &left, const cv::Mat &right, cv::Mat &disp, cv::Mat &depth, cv::Mat &cost);
+
+    /**
+     * @brief registers a callback called with every new image. Starts the subscriber if not started.
+     *        The callback is executed by the ros spinner thread and must not modify the image.
+     * @param callback the callback
+     */
+    void registerImageCallback(const FrameNotifier<cv::Mat>::Callback &callback);
+    /**
+     * @brief registers a callback called with every new disparity image
+     * @param callback the callback
+     */
+    void registerDisparityCallback(const FrameNotifier<cv::Mat>::Callback &callback);
+    /**
+     * @brief registers a callback called with every new depth image
+     * @param callback the callback
+     */
+    void registerDepthCallback(const FrameNotifier<cv::Mat>::Callback &callback);
+
+    /**
+     * @brief gives a future for the first image stamped after time. The future is fulfilled by the
+     *        ros spinner, do not wait on it from the spinning thread.
+     * @param time the time after which the image is wanted
+     * @return the future
+     */
+    std::future<cv::Mat> nextImageAfter(const ros::Time &time);
+    std::future<cv::Mat> nextDisparityAfter(const ros::Time &time);
+    std::future<cv::Mat> nextDepthAfter(const ros::Time &time);
+
     /**
      * @brief A function to get the height in situations where you have not yet received an image.
      *        The height is read directly from the config message.
@@ -27,14 +27,13 @@
 #include "tf/tf.h"
 #include "tf/transform_listener.h"
 
-namespace tough_perception {
+#include <tough_perception_common/FrameNotifier.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
-/**
- * TODO: Currently the laser cloud is retured for any call to the unified datatype
- * 		 Once unified datatype is implement replace it.
- */
-typedef LaserPointCloud						UnifiedPointCloud;
-typedef LaserPoint							UnifiedPoint;
+namespace tough_perception {
 
 class MultisensePointCloud
 {
@@ -59,19 +58,62 @@ class MultisensePointCloud
 	std::string 						laser_topic_,
 										stereo_topic_;
 
-	bool 								new_stereo_;
-	bool								new_laser_;    
-    bool                                new_laser_wrt_l_foot_;
-	bool								new_unified_;
+	std::atomic<bool> 					new_stereo_;
+	std::atomic<bool>					new_laser_;
+    std::atomic<bool>                   new_laser_wrt_l_foot_;
+	std::atomic<bool>					new_unified_;
 
-	static bool							laser_callback_active_;
-    static bool                         laser_wrt_l_foot_callback_active_;
-	static bool							stereo_callback_active_;
+	// subscribers are started per object on the first request
+	std::atomic<bool>					laser_callback_active_;
+    std::atomic<bool>                   laser_wrt_l_foot_callback_active_;
+	std::atomic<bool>					stereo_callback_active_;
+
+    FrameNotifier<LaserPointCloud::ConstPtr>    laser_notifier_;
+    FrameNotifier<StereoPointCloud::ConstPtr>   stereo_notifier_;
+    FrameNotifier<UnifiedPointCloud::ConstPtr>  unified_notifier_;
 
     int                                 spindle_rate_;
 
     tf::TransformListener 				tf_listener;
 
+    // unified cloud is produced by a background thread from the latest laser and stereo clouds
+    std::atomic<bool>                   unified_callback_active_;
+    std::thread                         fusion_thread_;
+    std::mutex                          fusion_mutex_;
+    std::condition_variable             fusion_cv_;
+    std::atomic<bool>                   fusion_running_;
+    bool                                fusion_input_ready_;
+    LaserPointCloud::ConstPtr           fusion_laser_;
+    StereoPointCloud::ConstPtr          fusion_stereo_;
+
+    float                               unified_voxel_size_;
+    float                               stereo_confidence_range_;
+    float                               stereo_max_range_;
+
+    /**
+     * @brief fusionLoop is executed by the fusion thread. It waits for a new laser or stereo cloud,
+     *        transforms each source once to the base frame and publishes the fused result to unified_cloud_
+     */
+    void fusionLoop();
+    /**
+     * @brief transformToBase looks up the transform of a cloud to base_frame_ at the stamp of the cloud
+     * @param frame the frame of the cloud
+     * @param pcl_stamp the stamp of the cloud as stored in the pcl header (micro seconds)
+     * @param transform the transform from frame to base_frame_
+     * @return false if no transform was available
+     */
+    bool transformToBase(const std::string &frame, uint64_t pcl_stamp, Eigen::Affine3f &transform);
+    /**
+     * @brief fuseClouds merges the laser and stereo cloud, both in base frame, into a voxel deduplicated cloud.
+     *        Points falling in the same voxel are averaged weighted by their confidence.
+     * @param laser      laser cloud in base frame, can be null
+     * @param stereo_cam stereo cloud in camera frame, used to compute the confidence of the stereo points
+     * @param stereo     stereo cloud in base frame, can be null
+     * @param out        the unified cloud
+     */
+    void fuseClouds(const LaserPointCloud::ConstPtr &laser, const StereoPointCloud::ConstPtr &stereo_cam,
+                    const StereoPointCloud::ConstPtr &stereo, UnifiedPointCloud &out);
+
     /**
      * @brief This function is an internal function which is the actual callback executed when
      *        the laser subscriber is active.
@@ -96,6 +138,14 @@ class MultisensePointCloud
 	void saveToLaserCloud(const sensor_msgs::PointCloud2ConstPtr &msg);
     void saveToLaserCloudWrtLFoot(const sensor_msgs::PointCloud2ConstPtr &msg);
 
+    /**
+     * @brief these functions start the subscribers if not started
+     */
+    void subscribeLaser();
+    void subscribeLaserWrtLFoot();
+    void subscribeStereo();
+    void startFusion();
+
 public:
     /**
      * @brief This function removes the points that correspond to the robot
@@ -131,16 +181,46 @@ public:
      */
     bool giveLaserCloudWrtLFoot(LaserPointCloud::Ptr &out);
 	/**
-	 * @brief this function gives the unified point cloud
-	 * 		  TODO: Implement it
+	 * @brief this function gives the unified point cloud. It is the latest fused laser + stereo cloud in
+	 *        base frame, voxel deduplicated and with a per point source and confidence.
+	 *        The first call starts the laser and stereo subscribers and the fusion thread, it never blocks
+	 *        on the fusion itself.
 	 * @param out the unified point cloud
-	 * @return
+	 * @return true if a new fused cloud is available
 	 */
 	bool giveUnifiedCloud(UnifiedPointCloud::Ptr &out);
 	virtual ~MultisensePointCloud();
 
 	void setLaserTopic(const std::string &name);
     bool giveLaserCloudForTime(const ros::Time &time, LaserPointCloud::Ptr &out);
+
+    /**
+     * @brief registers a callback called with every new laser cloud. Starts the subscriber if not started.
+     *        The callback is executed by the ros spinner thread and must not modify the cloud.
+     * @param callback the callback
+     */
+    void registerLaserCallback(const FrameNotifier<LaserPointCloud::ConstPtr>::Callback &callback);
+    /**
+     * @brief registers a callback called with every new stereo cloud. Starts the subscriber if not started.
+     * @param callback the callback
+     */
+    void registerStereoCallback(const FrameNotifier<StereoPointCloud::ConstPtr>::Callback &callback);
+    /**
+     * @brief registers a callback called with every new unified cloud. Starts the fusion if not started.
+     *        The callback is executed by the fusion thread.
+     * @param callback the callback
+     */
+    void registerUnifiedCallback(const FrameNotifier<UnifiedPointCloud::ConstPtr>::Callback &callback);
+
+    /**
+     * @brief gives a future for the first laser cloud stamped after time. The future is fulfilled
+     *        by the ros spinner, do not wait on it from the spinning thread.
+     * @param time the time after which the cloud is wanted
+     * @return the future
+     */
+    std::future<LaserPointCloud::ConstPtr> nextLaserCloudAfter(const ros::Time &time);
+    std::future<StereoPointCloud::ConstPtr> nextStereoCloudAfter(const ros::Time &time);
+    std::future<UnifiedPointCloud::ConstPtr> nextUnifiedCloudAfter(const ros::Time &time);
 };
 
 //might be shifted to a hpp file which has the instantiation of all the templates
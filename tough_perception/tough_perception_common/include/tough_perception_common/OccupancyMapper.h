@@ -0,0 +1,138 @@
+/**
+ ********************************************************************************************************
+ * @file    OccupancyMapper.h
+ * @brief   incremental 3D occupancy map
+ * @details Hashed log odds voxel map updated in process from laser scans. The points of a scan are
+ *          raycast once per endpoint voxel, rays are traced in parallel and the voxels that change
+ *          state are kept so that the map can be published incrementally.
+ ********************************************************************************************************
+ */
+
+#ifndef OCCUPANCYMAPPER_H_
+#define OCCUPANCYMAPPER_H_
+
+#include <tough_perception_common/global.h>
+#include <nav_msgs/OccupancyGrid.h>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace tough_perception {
+
+/**
+ * @brief parameters of the occupancy mapper. The sensor model follows the octomap_server parameters.
+ */
+struct OccupancyMapperParams
+{
+    float   resolution;         // voxel size in meters
+    float   prob_hit;           // probability of a voxel containing an endpoint
+    float   prob_miss;          // probability of a voxel traversed by a ray
+    float   clamp_min;          // lower bound of the occupancy probability
+    float   clamp_max;          // upper bound of the occupancy probability
+    float   occupancy_thres;    // a voxel is occupied above this probability
+    float   max_range;          // points further than this from the sensor only clear space
+    float   projection_min_z;   // voxels between these heights are projected in the 2D map
+    float   projection_max_z;
+    int     num_threads;        // 0 to use all the available cores
+
+    OccupancyMapperParams():
+        resolution(0.05f), prob_hit(0.85f), prob_miss(0.45f), clamp_min(0.1f), clamp_max(0.65f),
+        occupancy_thres(0.5f), max_range(35.0f), projection_min_z(0.0f), projection_max_z(2.0f),
+        num_threads(0)
+    {
+    }
+};
+
+class OccupancyMapper
+{
+    DISALLOW_COPY_AND_ASSIGN(OccupancyMapper)
+
+    // occupied and free voxels of a 2D map cell between projection_min_z and projection_max_z
+    struct Column
+    {
+        int     occupied;
+        int     known;
+    };
+
+    OccupancyMapperParams                   params_;
+    float                                   log_odds_hit_;
+    float                                   log_odds_miss_;
+    float                                   log_odds_min_;
+    float                                   log_odds_max_;
+    float                                   log_odds_thres_;
+    int                                     projection_min_z_;
+    int                                     projection_max_z_;
+
+    mutable std::mutex                      mutex_;
+    std::unordered_map<uint64_t, float>     voxels_;
+    std::unordered_map<uint64_t, Column>    columns_;
+    std::unordered_set<uint64_t>            occupied_changes_;
+    std::unordered_set<uint64_t>            freed_changes_;
+
+    static uint64_t toKey(int x, int y, int z);
+    static void fromKey(uint64_t key, int &x, int &y, int &z);
+    int toIndex(float v) const
+    {
+        return static_cast<int>(std::floor(v/params_.resolution));
+    }
+
+    /**
+     * @brief traces the voxels between the sensor and an endpoint with a 3D DDA. The voxel of the
+     *        endpoint is not added.
+     * @param origin sensor origin
+     * @param end endpoint of the ray
+     * @param free the traversed voxels
+     */
+    void traceRay(const Eigen::Vector3f &origin, const Eigen::Vector3f &end, std::unordered_set<uint64_t> &free) const;
+    /**
+     * @brief updates the log odds of a voxel and records a change of its occupancy state
+     */
+    void updateVoxel(uint64_t key, float log_odds_update);
+    void voxelCenter(uint64_t key, pcl::PointXYZ &pt) const;
+
+public:
+    OccupancyMapper(const OccupancyMapperParams &params = OccupancyMapperParams());
+
+    /**
+     * @brief inserts a scan in the map. Points that fall in the same voxel are traced once.
+     * @param cloud the scan in the map frame
+     * @param origin the sensor origin in the map frame when the scan was taken
+     * @return the number of rays that were traced
+     */
+    size_t insertCloud(const pcl::PointCloud<pcl::PointXYZ> &cloud, const Eigen::Vector3f &origin);
+
+    /**
+     * @brief gives the voxels that became occupied and free since the last call and clears them
+     * @param occupied centers of the newly occupied voxels
+     * @param freed centers of the voxels that are no longer occupied
+     */
+    void takeChanges(pcl::PointCloud<pcl::PointXYZ> &occupied, pcl::PointCloud<pcl::PointXYZ> &freed);
+
+    /**
+     * @brief gives the centers of all the occupied voxels
+     */
+    void getOccupiedCells(pcl::PointCloud<pcl::PointXYZ> &occupied) const;
+
+    /**
+     * @brief projects the voxels between projection_min_z and projection_max_z to a 2D map. A cell is
+     *        occupied if one of its voxels is occupied, free if one is known and unknown otherwise.
+     * @param grid the map, the header is not filled
+     * @return false if the map is empty
+     */
+    bool getProjectedMap(nav_msgs::OccupancyGrid &grid) const;
+
+    /**
+     * @brief removes all the voxels
+     */
+    void clear();
+
+    size_t size() const;
+
+    virtual ~OccupancyMapper();
+};
+
+} /* namespace tough_perception */
+
+#endif /* OCCUPANCYMAPPER_H_ */
@@ -0,0 +1,117 @@
+/**
+ ********************************************************************************************************
+ * @file    OrganizedNormalEstimator.h
+ * @brief   normal estimation for organized clouds
+ * @details Computes the normals of an organized cloud, such as the one from generateOrganizedRGBDCloud,
+ *          from integral images of the point coordinates instead of a KdTree search. The window of a
+ *          pixel grows with its depth and stops at depth discontinuities. Buffers are reused between
+ *          frames of the same size.
+ ********************************************************************************************************
+ */
+
+#ifndef ORGANIZEDNORMALESTIMATOR_H_
+#define ORGANIZEDNORMALESTIMATOR_H_
+
+#include <tough_perception_common/global.h>
+#include <tough_common/parallel_for.h>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace tough_perception {
+
+/**
+ * @brief parameters of the normal estimator. Window sizes are half sizes in pixels.
+ */
+struct OrganizedNormalEstimatorParams
+{
+    float   smoothing_size;             // window half size of a point at the sensor
+    float   depth_smoothing_factor;     // pixels added to the window half size per meter of depth
+    float   max_smoothing_size;         // upper bound of the window half size
+    float   max_depth_change_factor;    // neighbours whose depth differs by more than this times the depth are across an edge
+    int     min_points;                 // fewest valid points in a window to compute a normal
+    int     num_threads;                // 0 to use all the available cores
+
+    OrganizedNormalEstimatorParams():
+        smoothing_size(3.0f), depth_smoothing_factor(2.0f), max_smoothing_size(15.0f),
+        max_depth_change_factor(0.02f), min_points(5), num_threads(0)
+    {
+    }
+};
+
+class OrganizedNormalEstimator
+{
+    DISALLOW_COPY_AND_ASSIGN(OrganizedNormalEstimator)
+
+    // running sums of a window, the covariance is computed from them
+    struct Moments
+    {
+        double  n;
+        double  x, y, z;
+        double  xx, xy, xz, yy, yz, zz;
+    };
+
+    OrganizedNormalEstimatorParams  params_;
+    int                             width_;
+    int                             height_;
+
+    // buffers are reused between frames of the same size
+    std::vector<float>              points_;        // xyz of every pixel, NaN when invalid
+    std::vector<Moments>            integral_;      // (height + 1) x (width + 1), first row and column are zero
+    cv::Mat                         edges_;         // 0 at depth discontinuities and invalid pixels
+    cv::Mat                         edge_distance_;
+
+    void resize(int width, int height);
+    /**
+     * @brief marks the pixels whose depth jumps to one of their 4 neighbours and computes the distance of
+     *        every pixel to the closest of them. It bounds the window so that it does not cross edges.
+     */
+    void computeEdgeDistance();
+    /**
+     * @brief computeIntegralImage sums the moments along the rows in parallel, then along the columns
+     */
+    void computeIntegralImage();
+    void computeNormals(int row_begin, int row_end, pcl::PointCloud<pcl::Normal> &normals) const;
+    void computeNormals(pcl::PointCloud<pcl::Normal> &normals);
+
+public:
+    OrganizedNormalEstimator(const OrganizedNormalEstimatorParams &params = OrganizedNormalEstimatorParams());
+
+    /**
+     * @brief computes the normals of an organized cloud in the sensor frame. Normals point towards the
+     *        sensor and the curvature is the surface variation of the window.
+     * @param cloud organized cloud, invalid points are NaN or have a depth of 0
+     * @param normals organized normals of the same size, NaN where no normal could be computed
+     */
+    template <typename PointT>
+    void compute(const pcl::PointCloud<PointT> &cloud, pcl::PointCloud<pcl::Normal> &normals)
+    {
+        if(!cloud.isOrganized())
+        {
+            ROS_ERROR("OrganizedNormalEstimator: the cloud is not organized");
+            return;
+        }
+
+        resize(cloud.width, cloud.height);
+        parallelFor(params_.num_threads, 0, height_, [&](int row_begin, int row_end)
+        {
+            for(size_t i = static_cast<size_t>(row_begin)*width_; i < static_cast<size_t>(row_end)*width_; ++i)
+            {
+                const PointT &pt = cloud.points[i];
+                const bool valid = pcl::isFinite(pt) && pt.z > 0.0f;
+                points_[3*i]     = valid ? pt.x : std::numeric_limits<float>::quiet_NaN();
+                points_[3*i + 1] = valid ? pt.y : std::numeric_limits<float>::quiet_NaN();
+                points_[3*i + 2] = valid ? pt.z : std::numeric_limits<float>::quiet_NaN();
+            }
+        });
+
+        normals.header = cloud.header;
+        computeNormals(normals);
+    }
+
+    virtual ~OrganizedNormalEstimator();
+};
+
+} /* namespace tough_perception */
+
+#endif /* ORGANIZEDNORMALESTIMATOR_H_ */
@@ -0,0 +1,115 @@
+/**
+ ********************************************************************************************************
+ * @file    PlaneSegmenter.h
+ * @brief   multi plane segmentation
+ * @details Extracts all the significant planes of a cloud with normals, such as every tread and riser
+ *          of a stair run, in a single pass. Planes are found one after the other with a parallel
+ *          RANSAC that stops as soon as the best plane is found with the requested confidence. The
+ *          inliers of a plane are split in connected patches and each patch is given its outline.
+ ********************************************************************************************************
+ */
+
+#ifndef PLANESEGMENTER_H_
+#define PLANESEGMENTER_H_
+
+#include <tough_perception_common/global.h>
+#include <cstdint>
+#include <vector>
+
+namespace tough_perception {
+
+/**
+ * @brief parameters of the plane segmenter. Angles are in radians.
+ */
+struct PlaneSegmenterParams
+{
+    float   distance_threshold;     // largest distance of an inlier to the plane
+    float   normal_threshold;       // largest angle between the normal of an inlier and the plane normal
+    int     min_inliers;            // smallest patch kept as a plane
+    int     max_planes;             // the search stops after this many planes
+    int     max_iterations;         // RANSAC hypotheses tested per plane at most
+    float   probability;            // confidence of having drawn an all inliers sample before stopping
+    float   orientation_tolerance;  // largest angle to the horizontal or the vertical to classify a plane
+    bool    keep_slanted;           // keep planes that are neither horizontal nor vertical
+    float   cluster_tolerance;      // inliers further apart than this are in different patches
+    int     num_threads;            // 0 to use all the available cores
+
+    PlaneSegmenterParams():
+        distance_threshold(0.02f), normal_threshold(0.35f), min_inliers(100), max_planes(20),
+        max_iterations(1000), probability(0.99f), orientation_tolerance(0.15f), keep_slanted(false),
+        cluster_tolerance(0.05f), num_threads(0)
+    {
+    }
+};
+
+/**
+ * @brief plane patch n.dot(p) + d = 0. Horizontal normals point up. The hull is the convex outline of the
+ *        inliers projected on the plane, counter clockwise around the normal.
+ */
+struct PlanarPatch
+{
+    enum Type : uint8_t
+    {
+        HORIZONTAL = 0,
+        VERTICAL,
+        SLANTED
+    };
+
+    Type                            type;
+    Eigen::Vector3f                 normal;
+    float                           d;
+    Eigen::Vector3f                 centroid;
+    float                           area;
+    std::vector<int>                inliers;
+    std::vector<Eigen::Vector3f>    hull;
+};
+
+class PlaneSegmenter
+{
+    DISALLOW_COPY_AND_ASSIGN(PlaneSegmenter)
+
+    PlaneSegmenterParams    params_;
+    float                   cos_normal_threshold_;
+    uint32_t                seed_;
+
+    /**
+     * @brief runs RANSAC on the candidate points. Each thread draws its own hypotheses, a hypothesis is
+     *        rejected as soon as it cannot beat the best one and the number of hypotheses needed is
+     *        updated every time a better plane is found.
+     * @return the number of inliers of the best plane
+     */
+    size_t findBestPlane(const pcl::PointCloud<pcl::PointXYZ> &cloud, const pcl::PointCloud<pcl::Normal> &normals,
+                         const std::vector<int> &candidates, Eigen::Vector3f &normal, float &d);
+    /**
+     * @brief fits a plane to the points by least squares
+     * @return false if the points are degenerate
+     */
+    static bool fitPlane(const pcl::PointCloud<pcl::PointXYZ> &cloud, const std::vector<int> &indices,
+                         Eigen::Vector3f &normal, float &d, Eigen::Vector3f &centroid);
+    bool isInlier(const pcl::PointXYZ &pt, const pcl::Normal &pt_normal, const Eigen::Vector3f &normal, float d) const;
+    /**
+     * @brief splits the inliers in patches connected within cluster_tolerance on the plane
+     */
+    void splitPatches(const pcl::PointCloud<pcl::PointXYZ> &cloud, const std::vector<int> &inliers,
+                      const Eigen::Vector3f &normal, std::vector<std::vector<int>> &patches) const;
+    bool makePatch(const pcl::PointCloud<pcl::PointXYZ> &cloud, std::vector<int> &indices, PlanarPatch &patch) const;
+    static void computeHull(const pcl::PointCloud<pcl::PointXYZ> &cloud, PlanarPatch &patch);
+
+public:
+    PlaneSegmenter(const PlaneSegmenterParams &params = PlaneSegmenterParams());
+
+    /**
+     * @brief finds the planes of a cloud
+     * @param cloud the cloud, unorganized or organized
+     * @param normals normals of the cloud, points with a NaN normal are ignored
+     * @param patches the planes found, largest first
+     */
+    void segment(const pcl::PointCloud<pcl::PointXYZ> &cloud, const pcl::PointCloud<pcl::Normal> &normals,
+                 std::vector<PlanarPatch> &patches);
+
+    virtual ~PlaneSegmenter();
+};
+
+} /* namespace tough_perception */
+
+#endif /* PLANESEGMENTER_H_ */
@@ -13,6 +13,25 @@
 
 namespace tough_perception {
 
+/**
+ * @brief box used to crop a cloud. The bounds are given in the box frame, the rigid transform places the box
+ *        in the cloud frame. An identity transform gives an axis aligned box that is tested without rotating points.
+ *        Members are not vectorizable Eigen types so regions can be kept in std::vector.
+ */
+struct CropRegion
+{
+	Eigen::Vector3f	min;
+	Eigen::Vector3f	max;
+	Eigen::Matrix3f	rotation;
+	Eigen::Vector3f	translation;
+
+	CropRegion(const Eigen::Vector3f &min_pt, const Eigen::Vector3f &max_pt,
+			   const Eigen::Affine3f &box_transform = Eigen::Affine3f::Identity()):
+		min(min_pt), max(max_pt), rotation(box_transform.linear()), translation(box_transform.translation())
+	{
+	}
+};
+
 class PointCloudHelper {
 public:
 	/**
@@ -36,6 +55,96 @@ public:
 	static void filterLaserScan(const pcl::PointCloud<pcl::PointXYZI>::Ptr &laserCloud,
 								std::vector<int> &indices);
 
+	/**
+	 * @brief keeps the points inside the keep region that are not in any of the exclusion regions. The points
+	 *        are compacted in place in a single pass, the cloud becomes unorganized.
+	 * @param cloud the cloud that is cropped
+	 * @param keep the region that is kept
+	 * @param exclusions regions that are removed
+	 */
+	template <typename PointT>
+	static void cropInPlace(pcl::PointCloud<PointT> &cloud, const CropRegion &keep,
+							const std::vector<CropRegion> &exclusions = std::vector<CropRegion>())
+	{
+		cropRegionsInPlace(cloud, &keep, exclusions);
+	}
+
+	/**
+	 * @brief removes the points that are in any of the exclusion regions, in place and in a single pass
+	 */
+	template <typename PointT>
+	static void removeRegionsInPlace(pcl::PointCloud<PointT> &cloud, const std::vector<CropRegion> &exclusions)
+	{
+		cropRegionsInPlace(cloud, nullptr, exclusions);
+	}
+
+private:
+	// region with the rotation from the cloud frame to the box frame
+	struct CropTest
+	{
+		Eigen::Array3f	min;
+		Eigen::Array3f	max;
+		Eigen::Matrix3f	inverse_rotation;
+		Eigen::Vector3f	translation;
+		bool			axis_aligned;
+
+		explicit CropTest(const CropRegion &region):
+			min(region.min.array()), max(region.max.array()), inverse_rotation(region.rotation.transpose()),
+			translation(region.translation),
+			axis_aligned(region.rotation.isIdentity() && region.translation.isZero())
+		{
+		}
+
+		bool contains(const Eigen::Vector3f &pt) const
+		{
+			if(axis_aligned)
+				return (pt.array() >= min).all() && (pt.array() <= max).all();
+			const Eigen::Array3f p = (inverse_rotation*(pt - translation)).array();
+			return (p >= min).all() && (p <= max).all();
+		}
+	};
+
+	template <typename PointT>
+	static void cropRegionsInPlace(pcl::PointCloud<PointT> &cloud, const CropRegion *keep, const std::vector<CropRegion> &exclusions)
+	{
+		std::vector<CropTest> excluded;
+		excluded.reserve(exclusions.size());
+		for(const auto &region : exclusions)
+			excluded.emplace_back(region);
+		const CropTest kept = keep ? CropTest(*keep) : CropTest(CropRegion(Eigen::Vector3f::Zero(), Eigen::Vector3f::Zero()));
+
+		size_t count = 0;
+		for(size_t i = 0; i < cloud.points.size(); ++i)
+		{
+			const Eigen::Vector3f pt = cloud.points[i].getVector3fMap();
+			if(!pcl_isfinite(pt[0]) || !pcl_isfinite(pt[1]) || !pcl_isfinite(pt[2]))
+				continue;
+			if(keep && !kept.contains(pt))
+				continue;
+
+			bool is_excluded = false;
+			for(const auto &region : excluded)
+			{
+				if(region.contains(pt))
+				{
+					is_excluded = true;
+					break;
+				}
+			}
+			if(is_excluded)
+				continue;
+
+			if(count != i)
+				cloud.points[count] = cloud.points[i];
+			++count;
+		}
+
+		cloud.points.resize(count);
+		cloud.width    = count;
+		cloud.height   = 1;
+		cloud.is_dense = true;
+	}
+
 };
 
 }
@@ -0,0 +1,67 @@
+/**
+ ********************************************************************************************************
+ * @file    ScanAccumulator.h
+ * @brief   in process replacement of the laser_assembler service
+ * @details Keeps a bounded, time ordered ring of scan clouds already transformed to the fixed frame and
+ *          concatenates the scans of a time window into one cloud without a service round trip.
+ ********************************************************************************************************
+ */
+
+#ifndef SCANACCUMULATOR_H_
+#define SCANACCUMULATOR_H_
+
+#include <tough_perception_common/global.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <tf/transform_listener.h>
+#include <deque>
+#include <mutex>
+
+namespace tough_perception {
+
+class ScanAccumulator
+{
+    DISALLOW_COPY_AND_ASSIGN(ScanAccumulator)
+
+public:
+    /**
+     * @brief Constructor
+     * @param nh node handle used to subscribe to the scans
+     * @param cloud_topic topic of the scan clouds
+     * @param fixed_frame frame of the stored scans and of the assembled cloud
+     * @param max_clouds number of scans kept, older scans are dropped
+     */
+    ScanAccumulator(ros::NodeHandle &nh, const std::string &cloud_topic, const std::string &fixed_frame, size_t max_clouds);
+
+    /**
+     * @brief concatenates the scans stamped in [begin, end). Scans whose fields differ from the first
+     *        scan of the window are skipped.
+     * @param begin start of the window
+     * @param end end of the window
+     * @param cloud the assembled cloud in the fixed frame, stamped with end
+     * @return the number of scans assembled
+     */
+    size_t assemble(const ros::Time &begin, const ros::Time &end, sensor_msgs::PointCloud2 &cloud) const;
+
+    /**
+     * @brief drops all the scans
+     */
+    void clear();
+
+    virtual ~ScanAccumulator();
+
+private:
+    void cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg);
+
+    ros::Subscriber                                 cloud_sub_;
+    tf::TransformListener                           listener_;
+    std::string                                     fixed_frame_;
+    size_t                                          max_clouds_;
+
+    mutable std::mutex                              mutex_;
+    // scans in the fixed frame, ordered by stamp
+    std::deque<sensor_msgs::PointCloud2ConstPtr>    scans_;
+};
+
+} /* namespace tough_perception */
+
+#endif /* SCANACCUMULATOR_H_ */
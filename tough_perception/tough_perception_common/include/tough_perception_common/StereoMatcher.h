@@ -0,0 +1,120 @@
+/**
+ ********************************************************************************************************
+ * @file    StereoMatcher.h
+ * @brief   CPU semi global stereo matcher
+ * @details Computes a disparity and a cost image from a rectified stereo pair. It is used as a
+ *          fallback when the disparity from the multisense head is not available and to test the
+ *          depth pipeline offline from image pairs.
+ ********************************************************************************************************
+ */
+
+#ifndef STEREOMATCHER_H_
+#define STEREOMATCHER_H_
+
+#include <tough_perception_common/global.h>
+#include <vector>
+
+namespace tough_perception {
+
+/**
+ * @brief parameters of the stereo matcher. Disparities and the region of interest are given
+ *        in pixels of the full resolution image.
+ */
+struct StereoMatcherParams
+{
+    int         min_disparity;      // smallest disparity searched
+    int         num_disparities;    // number of disparities searched
+    int         p1;                 // penalty for a disparity change of 1 pixel between neighbours
+    int         p2;                 // penalty for a larger disparity change between neighbours
+    int         uniqueness_ratio;   // in percent, margin by which the best match must win
+    int         downscale;          // matching is done on the image downscaled by this factor
+    cv::Rect    roi;                // region where disparity is computed, empty for the whole image
+    int         num_threads;        // 0 to use all the available cores
+
+    StereoMatcherParams():
+        min_disparity(0), num_disparities(64), p1(8), p2(32), uniqueness_ratio(10),
+        downscale(1), roi(), num_threads(0)
+    {
+    }
+};
+
+class StereoMatcher
+{
+    DISALLOW_COPY_AND_ASSIGN(StereoMatcher)
+
+    StereoMatcherParams     params_;
+
+    // size of the image being matched and the disparity range at the working resolution
+    int                     width_;
+    int                     height_;
+    int                     min_disparity_;
+    int                     disparities_;
+
+    // buffers are reused between frames of the same size
+    std::vector<uint64_t>   census_left_;
+    std::vector<uint64_t>   census_right_;
+    std::vector<uint8_t>    pixel_cost_;
+    std::vector<uint16_t>   aggregated_cost_;
+
+    /**
+     * @brief censusTransform computes a 7x5 census signature of every pixel
+     * @param img  8 bit single channel image
+     * @param census output signature, row major
+     */
+    void censusTransform(const cv::Mat &img, std::vector<uint64_t> &census) const;
+    /**
+     * @brief computePixelCost computes the hamming distance between the census signatures of the
+     *        left pixel and the right pixel at each disparity
+     */
+    void computePixelCost(int row_begin, int row_end);
+    /**
+     * @brief aggregateHorizontal aggregates the costs along the left to right and right to left
+     *        paths. Rows are independent so a range of rows is processed per thread.
+     */
+    void aggregateHorizontal(int row_begin, int row_end);
+    /**
+     * @brief aggregateVertical adds the costs aggregated along the top to bottom and bottom to top
+     *        paths. Columns are independent so a range of columns is processed per thread.
+     */
+    void aggregateVertical(int col_begin, int col_end);
+    /**
+     * @brief selectDisparity picks the disparity with the lowest aggregated cost, refines it to
+     *        sub pixel and rejects ambiguous matches
+     */
+    void selectDisparity(int row_begin, int row_end, cv::Mat &disparity, cv::Mat &cost) const;
+
+public:
+    StereoMatcher(const StereoMatcherParams &params = StereoMatcherParams());
+
+    void setParams(const StereoMatcherParams &params);
+    const StereoMatcherParams& getParams() const
+    {
+        return params_;
+    }
+
+    /**
+     * @brief compute the disparity of the left image
+     * @param left  rectified left image, color or mono
+     * @param right rectified right image, color or mono
+     * @param disparity CV_32F disparity in pixels of the full resolution image, same size as left.
+     *                  Pixels outside the roi or without a valid match are 0.
+     * @param cost CV_8U matching cost, 0 for a perfect match and 255 for invalid pixels
+     * @return false if the images can not be matched
+     */
+    bool compute(const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity, cv::Mat &cost);
+
+    /**
+     * @brief disparityToDepth converts a disparity image into a CV_32F depth image in meters
+     * @param disparity CV_32F disparity image
+     * @param focal_length focal length in pixels
+     * @param baseline baseline of the stereo pair in meters
+     * @param depth the depth image, 0 where the disparity is invalid
+     */
+    static void disparityToDepth(const cv::Mat &disparity, float focal_length, float baseline, cv::Mat &depth);
+
+    virtual ~StereoMatcher();
+};
+
+} /* namespace tough_perception */
+
+#endif /* STEREOMATCHER_H_ */
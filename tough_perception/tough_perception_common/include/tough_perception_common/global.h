@@ -14,6 +14,7 @@
 #include <pcl_ros/point_cloud.h>
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
+#include <pcl/register_point_struct.h>
 #include <opencv2/opencv.hpp>
 
 /*** MACROS ***/
@@ -38,6 +39,35 @@ namespace tough_perception
 	typedef pcl::PointCloud<LaserPoint>		 	LaserPointCloud;
 	typedef pcl::PointCloud<StereoPoint> 		StereoPointCloud;
 	typedef pcl::PointCloud<StereoPointColor> 	StereoPointCloudColor;
+
+	/**
+	 * @brief sensor that contributed to a unified point. A point seen by both sensors has both bits set.
+	 */
+	enum UNIFIED_POINT_SOURCE
+	{
+		SOURCE_LASER  = 1,
+		SOURCE_STEREO = 2,
+		SOURCE_FUSED  = SOURCE_LASER | SOURCE_STEREO
+	};
+
+	/**
+	 * @brief point of the fused stereo + laser cloud. confidence is in [0,1], source is a UNIFIED_POINT_SOURCE
+	 */
+	struct EIGEN_ALIGN16 UnifiedPoint
+	{
+		PCL_ADD_POINT4D;
+		float		confidence;
+		uint32_t	source;
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+	};
+	typedef pcl::PointCloud<UnifiedPoint>		UnifiedPointCloud;
 }
 
+POINT_CLOUD_REGISTER_POINT_STRUCT(tough_perception::UnifiedPoint,
+								  (float, x, x)
+								  (float, y, y)
+								  (float, z, z)
+								  (float, confidence, confidence)
+								  (uint32_t, source, source))
+
 #endif /* GLOBAL_H_ */
@@ -60,6 +60,23 @@ private:
      */
     std::string m_baseFrame;
 
+    /**
+     * @brief m_deskewKnots number of sensor poses looked up over the duration of a scan. The pose of every
+     * beam is interpolated between the two closest knots. Less than 2 uses the laser_geometry projection, which
+     * interpolates once between the poses at the start and at the end of the scan.
+     */
+    int m_deskewKnots;
+
+    /**
+     * @brief deskewScan projects a scan to the base frame with the pose of the sensor at the time of each beam,
+     * interpolated piecewise between the knots so that motion that is not uniform over the scan, like the
+     * spindle turning while the head moves, is followed more closely than with a single interpolation
+     * @param scan_in   the laser scan
+     * @param cloud     the projected points in the base frame
+     * @return false if the sensor poses are not available
+     */
+    bool deskewScan(const sensor_msgs::LaserScan &scan_in, sensor_msgs::PointCloud &cloud);
+
     /**
      * @brief scanCallBack Callback function to be called when the laser_scan topic pushes any data
      * @param scan_in   constant pointer to a laserscan message. Don't call this function manually, it is handled by ROS
@@ -77,8 +94,10 @@ public:
      * @param laserScanTopic an std::string specifying the laser_scan topic to subscribe to.
      * @param baseFrame an std::string specifying the frame that is to be used as a reference for creating pointcloud
      * @param pointCloudTopic an std::string specifying the topic name on which pointcloud2 data will be published
+     * @param pnh private node handle used to read the parameters, the nodelet passes its own
      */
-    Laser2PointCloud(ros::NodeHandle n, const std::string laserScanTopic, const std::string baseFrame, const std::string pointCloudTopic, const std::string pointCloud2Topic);
+    Laser2PointCloud(ros::NodeHandle n, const std::string laserScanTopic, const std::string baseFrame, const std::string pointCloudTopic, const std::string pointCloud2Topic,
+                     ros::NodeHandle pnh = ros::NodeHandle("~"));
 
 
 };
@@ -20,6 +20,7 @@ namespace PERCEPTION_COMMON_NAMES
 	//image topics
     static const std::string MULTISENSE_LEFT_IMAGE_COLOR_TOPIC = "/multisense/camera/left/image_rect_color";
     static const std::string MULTISENSE_LEFT_DISPARITY_TOPIC = "/multisense/camera/disparity";
+    static const std::string MULTISENSE_RIGHT_IMAGE_TOPIC = "/multisense/camera/right/image_rect";
     // TODO: add a depth image
 	static const std::string MULTISENSE_LEFT_DEPTH_TOPIC = "/multisense/depth";
 	static const std::string MULTISENSE_DEPTH_COST_TOPIC = "/multisense/left/cost";
@@ -38,6 +38,9 @@
 #include <tough_perception_common/MultisenseImage.h>
 #include <tough_perception_common/MultisensePointCloud.h>
 #include <tough_perception_common/PointCloudHelper.h>
+#include <tough_perception_common/ScanAccumulator.h>
+#include <memory>
+#include <tough_perception_common/perception_common_names.h>
 #include <tough_common/tough_common_names.h>
 #include <std_msgs/Bool.h>
 #include <std_msgs/Int8.h>
@@ -61,8 +64,10 @@ public:
      * @brief PeriodicSnapshotter requests a point cloud from the
      * point_cloud_assembler every x seconds, and then publishes the
      * resulting data
+     * @param nh node handle of the topics and the timer
+     * @param pnh private node handle used to read the parameters, the nodelet passes its own
      */
-    PeriodicSnapshotter();
+    PeriodicSnapshotter(ros::NodeHandle nh = ros::NodeHandle(), ros::NodeHandle pnh = ros::NodeHandle("~"));
 
     /**
      * @brief timerCallback This callback is executed after a set timeout. This timeout is specified
@@ -119,10 +124,17 @@ private:
     float filter_min_z;
     float filter_max_z;
 
+    std::vector<tough_perception::CropRegion> exclusion_regions_;
+
+    int icp_iterations_;
+
+    bool use_assembler_service_;
+    std::unique_ptr<tough_perception::ScanAccumulator> scan_accumulator_;
+
 } ;
 
 
-void convertROStoPCL(const sensor_msgs::PointCloud2::Ptr ros_msg, pcl::PointCloud<pcl::PointXYZ>::Ptr &pcl_msg){
+inline void convertROStoPCL(const sensor_msgs::PointCloud2::Ptr ros_msg, pcl::PointCloud<pcl::PointXYZ>::Ptr &pcl_msg){
 
     pcl::PCLPointCloud2 pcl_pc2;
     pcl_conversions::toPCL(*ros_msg,pcl_pc2);
@@ -130,7 +142,7 @@ void convertROStoPCL(const sensor_msgs::PointCloud2::Ptr ros_msg, pcl::PointClou
 
 }
 
-void convertPCLtoROS(const pcl::PointCloud<pcl::PointXYZ>::Ptr pcl_msg, sensor_msgs::PointCloud2::Ptr &ros_msg ){
+inline void convertPCLtoROS(const pcl::PointCloud<pcl::PointXYZ>::Ptr pcl_msg, sensor_msgs::PointCloud2::Ptr &ros_msg ){
     pcl::PCLPointCloud2 pcl_pc2;
     pcl::toPCLPointCloud2(*pcl_msg, pcl_pc2);
     pcl_conversions::moveFromPCL(pcl_pc2, *ros_msg);
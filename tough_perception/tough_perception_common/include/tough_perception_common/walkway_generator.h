@@ -18,7 +18,7 @@ class WalkwayGenerator{
 public:
     WalkwayGenerator(ros::NodeHandle &n);
     ~WalkwayGenerator();
-    void generateWalkwayPoints(const pcl::PointCloud<pcl::PointXYZ>::Ptr cloud);
+    void generateWalkwayPoints(const sensor_msgs::PointCloud2ConstPtr &msg);
 
 private:
     ros::Publisher pointcloudPub_;
@@ -0,0 +1,93 @@
+/**
+ ********************************************************************************************************
+ * @file    CloudCompression.cpp
+ * @brief   CloudEncoder and CloudDecoder class definitions
+ * @details octree compression of xyz clouds with key frames and delta frames
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/CloudCompression.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <sstream>
+
+namespace tough_perception {
+
+CloudEncoder::CloudEncoder(double point_resolution, double octree_resolution, unsigned int key_frame_rate):
+    point_resolution_(point_resolution), octree_resolution_(octree_resolution),
+    key_frame_rate_(key_frame_rate), seq_(0)
+{
+    forceKeyFrame();
+}
+
+/**
+ * @note a new codec starts with a key frame
+ */
+void CloudEncoder::forceKeyFrame()
+{
+    codec_.reset(new OctreeCodec(point_resolution_, octree_resolution_, key_frame_rate_));
+}
+
+void CloudEncoder::encode(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr &cloud, tough_perception_common::CompressedCloud &msg)
+{
+    std::stringstream compressed;
+    codec_->encodePointCloud(cloud, compressed);
+
+    const std::string data = compressed.str();
+    msg.header    = pcl_conversions::fromPCL(cloud->header);
+    msg.seq       = seq_++;
+    msg.key_frame = codec_->isKeyFrame();
+    msg.data.assign(data.begin(), data.end());
+
+    ROS_DEBUG("Compressed %lu points to %lu bytes, %s frame", cloud->size(), msg.data.size(), msg.key_frame ? "key" : "delta");
+}
+
+CloudEncoder::~CloudEncoder()
+{
+}
+
+/**
+ * @note the resolutions and the key frame rate are read from the compressed stream
+ */
+CloudDecoder::CloudDecoder():
+    codec_(0.001, 0.01, 30), last_seq_(0), synced_(false), dropped_(0)
+{
+}
+
+bool CloudDecoder::decode(const tough_perception_common::CompressedCloud &msg, pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud)
+{
+    // a delta frame can only be applied on top of the frame just before it
+    if(!msg.key_frame && (!synced_ || msg.seq != last_seq_ + 1))
+    {
+        if(synced_)
+            ROS_WARN("Missed compressed cloud %u, dropping delta frames until the next key frame", last_seq_ + 1);
+        synced_ = false;
+        ++dropped_;
+        return false;
+    }
+
+    std::stringstream compressed;
+    compressed.write(reinterpret_cast<const char*>(msg.data.data()), msg.data.size());
+
+    cloud.reset(new pcl::PointCloud<pcl::PointXYZ>);
+    try
+    {
+        codec_.decodePointCloud(compressed, cloud);
+    }
+    catch(std::exception &ex)
+    {
+        ROS_ERROR_STREAM("Exception: " << ex.what());
+        synced_ = false;
+        return false;
+    }
+    pcl_conversions::toPCL(msg.header, cloud->header);
+
+    last_seq_ = msg.seq;
+    synced_   = true;
+    return true;
+}
+
+CloudDecoder::~CloudDecoder()
+{
+}
+
+} /* namespace tough_perception */
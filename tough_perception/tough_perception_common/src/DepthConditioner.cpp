@@ -0,0 +1,167 @@
+/**
+ ********************************************************************************************************
+ * @file    DepthConditioner.cpp
+ * @brief   DepthConditioner class definition
+ * @details Cost masking and windowed running mean and variance of depth images
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/DepthConditioner.h>
+#include <tough_common/parallel_for.h>
+#include <algorithm>
+#include <limits>
+
+namespace tough_perception {
+
+DepthConditioner::DepthConditioner(const DepthConditionerParams &params):
+    params_(params), has_pose_(false)
+{
+    params_.window      = std::max(1, std::min(params_.window, 255));
+    params_.min_samples = std::max(1, std::min(params_.min_samples, params_.window));
+}
+
+void DepthConditioner::reset()
+{
+    if(!count_.empty())
+        count_.setTo(0);
+    has_pose_ = false;
+}
+
+bool DepthConditioner::isStill(const Eigen::Affine3f &camera_pose)
+{
+    const Eigen::Vector3f translation = camera_pose.translation();
+    const Eigen::Matrix3f rotation = camera_pose.rotation();
+
+    bool still = has_pose_;
+    if(has_pose_)
+    {
+        const float moved   = (translation - last_translation_).norm();
+        const float rotated = Eigen::AngleAxisf(last_rotation_.transpose()*rotation).angle();
+        still = moved <= params_.max_translation && rotated <= params_.max_rotation;
+    }
+
+    has_pose_         = true;
+    last_translation_ = translation;
+    last_rotation_    = rotation;
+    return still;
+}
+
+/**
+ * @note the mean and variance are a running estimate over min(count, window) frames. Once the window is
+ *       full it becomes an exponential average with a weight of 1/window for the new frame. A pixel that
+ *       is masked loses one frame of history so that it expires after window masked frames.
+ */
+void DepthConditioner::update(int row_begin, int row_end, const cv::Mat &depth, const cv::Mat &cost,
+                              cv::Mat &conditioned, cv::Mat &variance)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const uint8_t window = params_.window;
+    const uint8_t max_cost = static_cast<uint8_t>(std::max(0, std::min(params_.max_cost, 255)));
+
+    for(int y = row_begin; y < row_end; ++y)
+    {
+        const float *depth_row   = depth.ptr<float>(y);
+        const uint8_t *cost_row  = cost.empty() ? nullptr : cost.ptr<uint8_t>(y);
+        float *mean_row          = mean_.ptr<float>(y);
+        float *var_row           = variance_.ptr<float>(y);
+        uint8_t *count_row       = count_.ptr<uint8_t>(y);
+        float *out_row           = conditioned.ptr<float>(y);
+        float *out_var_row       = variance.ptr<float>(y);
+
+        for(int x = 0; x < depth.cols; ++x)
+        {
+            const float d = depth_row[x];
+            const bool valid = std::isfinite(d) && d >= params_.min_depth && d <= params_.max_depth &&
+                               (cost_row == nullptr || cost_row[x] <= max_cost);
+            uint8_t &count = count_row[x];
+            float &mean    = mean_row[x];
+            float &var     = var_row[x];
+
+            if(!valid)
+            {
+                if(count > 0)
+                    --count;
+            }
+            else
+            {
+                const float sigma = params_.depth_noise*d*d;
+                if(count == 0 || std::fabs(d - mean) > params_.outlier_gate*std::sqrt(var + sigma*sigma))
+                {
+                    // first frame or the scene changed under this pixel
+                    count = 1;
+                    mean  = d;
+                    var   = 0.0f;
+                }
+                else
+                {
+                    if(count < window)
+                        ++count;
+                    const float n     = count;
+                    const float delta = d - mean;
+                    mean += delta/n;
+                    var   = (n - 1.0f)/n*(var + delta*delta/n);
+                }
+            }
+
+            if(count < params_.min_samples)
+            {
+                out_row[x]     = nan;
+                out_var_row[x] = nan;
+                continue;
+            }
+            // a single frame has no spread, the sensor noise bounds the variance from below
+            const float sigma = params_.depth_noise*mean*mean;
+            out_row[x]     = mean;
+            out_var_row[x] = std::max(var, sigma*sigma)/count;
+        }
+    }
+}
+
+bool DepthConditioner::condition(const cv::Mat &depth, const cv::Mat &cost, const Eigen::Affine3f &camera_pose,
+                                 cv::Mat &conditioned, cv::Mat &variance)
+{
+    if(depth.empty() || depth.type() != CV_32FC1)
+    {
+        ROS_ERROR("DepthConditioner: depth must be CV_32FC1");
+        return false;
+    }
+    if(!cost.empty() && cost.type() != CV_8UC1)
+    {
+        ROS_ERROR("DepthConditioner: cost must be CV_8UC1");
+        return false;
+    }
+
+    if(count_.size() != depth.size())
+    {
+        mean_.create(depth.size(), CV_32FC1);
+        variance_.create(depth.size(), CV_32FC1);
+        count_.create(depth.size(), CV_8UC1);
+        count_.setTo(0);
+    }
+    if(!isStill(camera_pose))
+    {
+        count_.setTo(0);
+    }
+
+    // the cost of the multisense can be at a lower resolution than the depth
+    cv::Mat frame_cost = cost;
+    if(!cost.empty() && cost.size() != depth.size())
+    {
+        cv::resize(cost, cost_, depth.size(), 0, 0, cv::INTER_NEAREST);
+        frame_cost = cost_;
+    }
+
+    conditioned.create(depth.size(), CV_32FC1);
+    variance.create(depth.size(), CV_32FC1);
+    parallelFor(params_.num_threads, 0, depth.rows, [&](int row_begin, int row_end)
+    {
+        update(row_begin, row_end, depth, frame_cost, conditioned, variance);
+    });
+    return true;
+}
+
+DepthConditioner::~DepthConditioner()
+{
+}
+
+} /* namespace tough_perception */
@@ -0,0 +1,118 @@
+/**
+ ********************************************************************************************************
+ * @file    ImageSynchronizer.cpp
+ * @brief   ImageSynchronizer class definition
+ * @details Pairs frames of multiple image streams by stamp from fixed size rings
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/ImageSynchronizer.h>
+
+namespace tough_perception {
+
+ImageSynchronizer::ImageSynchronizer(size_t num_streams, size_t ring_size, const ros::Duration &tolerance, const Callback &callback):
+    rings_(num_streams), tolerance_(tolerance), callback_(callback),
+    matched_(0), dropped_(0), latency_sum_(0.0), max_latency_(0.0)
+{
+    for(auto &ring : rings_)
+    {
+        ring.frames.resize(std::max<size_t>(1, ring_size));
+        ring.head  = 0;
+        ring.count = 0;
+    }
+}
+
+void ImageSynchronizer::popFront(Ring &ring, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        ring.frames[ring.head].reset();
+        ring.head = (ring.head + 1) % ring.frames.size();
+    }
+    ring.count -= n;
+}
+
+/**
+ * @note the new frame is matched with the closest frame of every other stream. Frames older than the
+ *       matched ones can not be part of a later set and are dropped.
+ */
+void ImageSynchronizer::add(size_t stream, const sensor_msgs::ImageConstPtr &image)
+{
+    if(stream >= rings_.size())
+    {
+        ROS_ERROR("ImageSynchronizer: invalid stream %lu", stream);
+        return;
+    }
+
+    ImageSet matched_set;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Ring &ring = rings_[stream];
+        if(ring.count == ring.frames.size())
+        {
+            popFront(ring, 1);
+            ++dropped_;
+        }
+        ring.frames[(ring.head + ring.count) % ring.frames.size()] = image;
+        ++ring.count;
+
+        const ros::Time stamp = image->header.stamp;
+        std::vector<size_t> match(rings_.size());
+        for(size_t s = 0; s < rings_.size(); ++s)
+        {
+            const Ring &other = rings_[s];
+            if(other.count == 0)
+                return;
+
+            size_t       best      = 0;
+            ros::Duration best_diff(-1.0);
+            for(size_t i = 0; i < other.count; ++i)
+            {
+                ros::Duration diff = frameAt(other, i)->header.stamp - stamp;
+                if(diff < ros::Duration(0))
+                    diff = -diff;
+                if(best_diff < ros::Duration(0) || diff < best_diff)
+                {
+                    best_diff = diff;
+                    best      = i;
+                }
+            }
+            if(best_diff > tolerance_)
+                return;
+            match[s] = best;
+        }
+
+        matched_set.resize(rings_.size());
+        for(size_t s = 0; s < rings_.size(); ++s)
+        {
+            matched_set[s] = frameAt(rings_[s], match[s]);
+            dropped_ += match[s];
+            popFront(rings_[s], match[s] + 1);
+        }
+
+        const double latency = (ros::Time::now() - stamp).toSec();
+        ++matched_;
+        latency_sum_ += latency;
+        max_latency_  = std::max(max_latency_, latency);
+    }
+
+    callback_(matched_set);
+}
+
+ImageSynchronizer::Statistics ImageSynchronizer::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Statistics stats;
+    stats.matched      = matched_;
+    stats.dropped      = dropped_;
+    stats.mean_latency = matched_ > 0 ? latency_sum_/matched_ : 0.0;
+    stats.max_latency  = max_latency_;
+    return stats;
+}
+
+ImageSynchronizer::~ImageSynchronizer()
+{
+}
+
+} /* namespace tough_perception */
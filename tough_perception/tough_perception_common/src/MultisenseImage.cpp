@@ -20,15 +20,6 @@ namespace tough_perception {
 
 using namespace std;
 
-/**
- *  These variables are needed to prevent multiple subscribers from being generated and to be only
- *  generated in request.
- */
-bool MultisenseImage::image_callback_active_=false;
-bool MultisenseImage::disp_callback_active_=false;
-bool MultisenseImage::config_callback_active_=false;
-bool MultisenseImage::depth_callback_active_=false;
-bool MultisenseImage::cost_callback_active_=false;
 /**
  *  @note do we need the NodeHandle passed??? Think benny
  */
@@ -37,8 +28,13 @@ MultisenseImage::MultisenseImage(ros::NodeHandle &n):nh_(n),
 													 new_disp_(false),
 													 new_depth_(false),
 													 new_cost_(false),
+													 image_callback_active_(false),
+													 disp_callback_active_(false),
+													 config_callback_active_(false),
+													 cost_callback_active_(false),
+													 depth_callback_active_(false),
 													 it_(nh_),
-													 sync_(nullptr )
+													 use_cpu_stereo_(false)
 {
 
 	ros::NodeHandle pnh("~");
@@ -63,6 +59,34 @@ MultisenseImage::MultisenseImage(ros::NodeHandle &n):nh_(n),
     {
         depth_cost_topic_ = PERCEPTION_COMMON_NAMES::MULTISENSE_DEPTH_COST_TOPIC;
     }
+    // frames kept per synchronized stream and the max stamp difference of synchronized frames
+    int ring_size;
+    double tolerance;
+    pnh.param<int>("sync_ring_size", ring_size, 5);
+    pnh.param<double>("sync_tolerance", tolerance, 0.01);
+    sync_ring_size_=std::max(1, ring_size);
+    sync_tolerance_=ros::Duration(tolerance);
+
+    if(!pnh.getParam("right_image_topic",right_image_topic_))
+    {
+        right_image_topic_ = PERCEPTION_COMMON_NAMES::MULTISENSE_RIGHT_IMAGE_TOPIC;
+    }
+
+    // CPU stereo replaces the disparity, depth and cost topics of the head when enabled
+    pnh.param<bool>("use_cpu_stereo", use_cpu_stereo_, false);
+    StereoMatcherParams stereo_params;
+    pnh.param<int>("stereo_min_disparity", stereo_params.min_disparity, stereo_params.min_disparity);
+    pnh.param<int>("stereo_num_disparities", stereo_params.num_disparities, stereo_params.num_disparities);
+    pnh.param<int>("stereo_p1", stereo_params.p1, stereo_params.p1);
+    pnh.param<int>("stereo_p2", stereo_params.p2, stereo_params.p2);
+    pnh.param<int>("stereo_uniqueness_ratio", stereo_params.uniqueness_ratio, stereo_params.uniqueness_ratio);
+    pnh.param<int>("stereo_downscale", stereo_params.downscale, stereo_params.downscale);
+    pnh.param<int>("stereo_threads", stereo_params.num_threads, stereo_params.num_threads);
+    pnh.param<int>("stereo_roi_x", stereo_params.roi.x, 0);
+    pnh.param<int>("stereo_roi_y", stereo_params.roi.y, 0);
+    pnh.param<int>("stereo_roi_width", stereo_params.roi.width, 0);
+    pnh.param<int>("stereo_roi_height", stereo_params.roi.height, 0);
+    stereo_matcher_.reset(new StereoMatcher(stereo_params));
     //hard coded values specific to simulation, later on can be made to be not hard coded.
 #ifdef GAZEBO_SIMULATION
     std::cout<<"Using SRCSIM dummy camera configs"<<std::endl;
@@ -129,28 +153,88 @@ void MultisenseImage::loadCameraConfig(const multisense_ros::RawCamConfigConstPt
 
 	ROS_INFO_STREAM_ONCE("Received new config: "<<settings.Q_matrix_);
 }
-#ifndef GAZEBO_SIMULATION
-void MultisenseImage::syncCallback(const sensor_msgs::ImageConstPtr &img, const sensor_msgs::ImageConstPtr &dimg)
+void MultisenseImage::syncCallback(const ImageSynchronizer::ImageSet &images)
 {
 
-	loadImage(img);
-    loadDisparityImageSensorMsgs(dimg);
+	loadImage(images[0]);
+    loadDisparityImageSensorMsgs(images[1]);
 }
-#else
-void MultisenseImage::syncCallback(const sensor_msgs::ImageConstPtr &img, const stereo_msgs::DisparityImageConstPtr &dimg)
+
+void MultisenseImage::stereoPairCallback(const ImageSynchronizer::ImageSet &images)
+{
+	cv_bridge::CvImageConstPtr right_ptr;
+	try
+	{
+		right_ptr = cv_bridge::toCvShare(images[1], sensor_msgs::image_encodings::MONO8);
+	}
+	catch (cv_bridge::Exception& e)
+	{
+		ROS_ERROR_STREAM("Exception: " << e.what());
+		return;
+	}
+
+	loadImage(images[0]);
+	if(!new_image_)
+		return;
+
+	cv::Mat disp, depth, cost;
+	if(!computeStereo(image_, right_ptr->image, disp, depth, cost))
+		return;
+
+	disparity_=disp;
+	cost_=cost;
+	disp_header_=img_header_;
+	cost_header_=img_header_;
+	new_disp_=true;
+	new_cost_=true;
+	if(!depth.empty())
+	{
+		depth_=depth;
+		depth_header_=img_header_;
+		new_depth_=true;
+		depth_notifier_.notify(depth_, depth_header_.stamp);
+	}
+	disparity_notifier_.notify(disparity_, disp_header_.stamp);
+	ROS_INFO_ONCE("Computed CPU stereo disparity size: %d x %d",disparity_.rows,disparity_.cols);
+}
+
+bool MultisenseImage::computeStereo(const cv::Mat &left, const cv::Mat &right, cv::Mat &disp, cv::Mat &depth, cv::Mat &cost)
 {
+	if(!stereo_matcher_->compute(left, right, disp, cost))
+		return false;
+
+	depth.release();
+	if(settings.camera_.empty())
+	{
+		ROS_WARN_THROTTLE(5, "Camera config not received, depth is not computed");
+		return true;
+	}
+	StereoMatcher::disparityToDepth(disp, settings.camera_.at<float>(0,0), settings.baselength_, depth);
+	return true;
+}
 
-	loadImage(img);
-    loadDisparityImageStereoMsgs(dimg);
+void MultisenseImage::startCpuStereo()
+{
+	if(sync_stereo_!=nullptr)
+		return;
+
+	// focal length and baseline are needed for the depth
+	subscribeConfig();
+	cam_sub_.shutdown();
+	sync_stereo_.reset(new ImageSynchronizer(2, sync_ring_size_, sync_tolerance_,
+	                                         boost::bind(&MultisenseImage::stereoPairCallback, this, _1)));
+	sync_left_sub_=it_.subscribe(image_topic_, 1, boost::bind(&ImageSynchronizer::add, sync_stereo_.get(), 0, _1));
+	sync_right_sub_=it_.subscribe(right_image_topic_, 1, boost::bind(&ImageSynchronizer::add, sync_stereo_.get(), 1, _1));
+	image_callback_active_=true;
+	ROS_INFO_STREAM("CPU stereo listening to: "<<sync_left_sub_.getTopic()<<" and "<<sync_right_sub_.getTopic()<<endl);
 }
-#endif
 
-void MultisenseImage::syncDepthCallback(const sensor_msgs::ImageConstPtr &img, const sensor_msgs::ImageConstPtr &dimg, const sensor_msgs::ImageConstPtr &cimg)
+void MultisenseImage::syncDepthCallback(const ImageSynchronizer::ImageSet &images)
 {
 
-	loadImage(img);
-	loadDepthImage(dimg);
-	loadCostImage(cimg);
+	loadImage(images[0]);
+	loadDepthImage(images[1]);
+	loadCostImage(images[2]);
 }
 
 /**
@@ -173,6 +257,7 @@ void MultisenseImage::loadImage(const sensor_msgs::ImageConstPtr &img)
 		image_=cv_ptr_->image.clone();
 		new_image_=true;
 		img_header_=cv_ptr_->header;
+		image_notifier_.notify(image_, img_header_.stamp);
 
 		ROS_INFO_ONCE("Received new image size: %d x %d",image_.rows,image_.cols);
 	 }
@@ -204,6 +289,7 @@ void MultisenseImage::loadDepthImage(const sensor_msgs::ImageConstPtr &img)
 		depth_=cv_ptr_->image.clone();
 		new_depth_=true;
 		depth_header_=cv_ptr_->header;
+		depth_notifier_.notify(depth_, depth_header_.stamp);
 
 		ROS_INFO_ONCE("Received new depth image size: %d x %d",depth_.rows,depth_.cols);
 	 }
@@ -273,7 +359,11 @@ void MultisenseImage::loadDisparityImageStereoMsgs(const stereo_msgs::DisparityI
     		disp_header_=img->image.header;
     	}
     	else
+    	{
     		ROS_WARN("disparity depth not recognized");
+    		return;
+    	}
+    	disparity_notifier_.notify(disparity_, disp_header_.stamp);
 
     	ROS_INFO_ONCE("Received new disparity image size: %d x %d",disparity_.rows,disparity_.cols);
 
@@ -315,7 +405,11 @@ void MultisenseImage::loadDisparityImageSensorMsgs(const sensor_msgs::ImageConst
     		disp_header_=img->header;
     	}
     	else
+    	{
     		ROS_WARN("disparity depth not recognized");
+    		return;
+    	}
+    	disparity_notifier_.notify(disparity_, disp_header_.stamp);
 
     	ROS_INFO_ONCE("Received new disparity image size: %d x %d , depth: %d",disparity_.rows,disparity_.cols,depth);
 
@@ -331,23 +425,56 @@ void MultisenseImage::loadDisparityImageSensorMsgs(const sensor_msgs::ImageConst
 
 
 
+void MultisenseImage::subscribeImage()
+{
+	if(image_callback_active_.exchange(true))
+		return;
+	cam_sub_ =it_.subscribe(image_topic_, 1, &MultisenseImage::loadImage, this);
+	ROS_INFO_STREAM("Listening to: "<<cam_sub_.getTopic()<<endl);
+}
+
+void MultisenseImage::subscribeDisparity()
+{
+	if(disp_callback_active_.exchange(true))
+		return;
+#ifndef GAZEBO_SIMULATION
+	disp_sub_ = it_.subscribe(disp_topic_, 1, &MultisenseImage::loadDisparityImageSensorMsgs, this);
+#else
+	disp_sub_ = nh_.subscribe(disp_topic_, 1, &MultisenseImage::loadDisparityImageStereoMsgs, this);
+#endif
+	ROS_INFO_STREAM("Listening to: "<<disp_sub_.getTopic()<<endl);
+}
+
+void MultisenseImage::subscribeDepth()
+{
+	if(depth_callback_active_.exchange(true))
+		return;
+	depth_sub_ = it_.subscribe(depth_topic_, 1, &MultisenseImage::loadDepthImage, this);
+	ROS_INFO_STREAM("Listening to: "<<depth_sub_.getTopic()<<endl);
+}
+
+void MultisenseImage::subscribeCost()
+{
+	if(cost_callback_active_.exchange(true))
+		return;
+	cost_sub_ =it_.subscribe(depth_cost_topic_, 1, &MultisenseImage::loadCostImage, this);
+	ROS_INFO_STREAM("Listening to: "<<cost_sub_.getTopic()<<endl);
+}
+
+void MultisenseImage::subscribeConfig()
+{
+	if(config_callback_active_.exchange(true))
+		return;
+	multisense_sub_=nh_.subscribe(multisense_topic_,1,&MultisenseImage::loadCameraConfig, this);
+	ROS_INFO_STREAM("Listening to: "<<multisense_sub_.getTopic()<<endl);
+}
+
 /**
  * @note starts the subscriber if not started
  */
 bool MultisenseImage::giveDisparityImage(cv::Mat &disp_img)
 {
-	if(!disp_callback_active_)
-	{
-#ifndef GAZEBO_SIMULATION
-         disp_sub_ = it_.subscribe(disp_topic_, 1, &MultisenseImage::loadDisparityImageSensorMsgs, this);
-#else
-         disp_sub_ = nh_.subscribe(disp_topic_, 1, &MultisenseImage::loadDisparityImageStereoMsgs, this);
-#endif
-		 disp_callback_active_=true;
-		 ROS_INFO_STREAM("Listening to: "<<disp_sub_.getTopic()<<endl);
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
-	}
+	subscribeDisparity();
     if (new_disp_)
     {
         if(disparity_.empty())
@@ -362,14 +489,7 @@ bool MultisenseImage::giveDisparityImage(cv::Mat &disp_img)
 
 bool MultisenseImage::giveDepthImage(cv::Mat &depth_img)
 {
-	if(!depth_callback_active_)
-	{
-		 depth_sub_ = it_.subscribe(depth_topic_, 1, &MultisenseImage::loadDepthImage, this);
-		 depth_callback_active_=true;
-		 ROS_INFO_STREAM("Listening to: "<<depth_sub_.getTopic()<<endl);
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
-	}
+	subscribeDepth();
     if (new_depth_)
     {
         if(depth_.empty())
@@ -382,19 +502,11 @@ bool MultisenseImage::giveDepthImage(cv::Mat &depth_img)
     return false;
 }
 /**
- * @note starts subscriber if not srtaed. TODO: try breaking it using multiple objects of the class
+ * @note starts subscriber if not started. Every object has its own subscriber.
  */
 bool MultisenseImage::giveImage(cv::Mat &img)
 {
-	if(!image_callback_active_)
-	{
-		cam_sub_ =it_.subscribe(image_topic_, 1, &MultisenseImage::loadImage, this);
-		image_callback_active_=true;
-		ROS_INFO_STREAM("Listening to: "<<cam_sub_.getTopic()<<endl);
-		ros::Duration(1).sleep();
-		ros::spinOnce();
-	}
-
+	subscribeImage();
 	if(new_image_)
 	{
 		img=image_;
@@ -411,15 +523,7 @@ bool MultisenseImage::giveCostImage(cv::Mat &img)
 #ifdef GAZEBO_SIMULATION
 	return false;
 #endif
-	if(!cost_callback_active_)
-	{
-		cost_sub_ =it_.subscribe(depth_cost_topic_, 1, &MultisenseImage::loadCostImage, this);
-		cost_callback_active_=true;
-		ROS_INFO_STREAM("Listening to: "<<cost_sub_.getTopic()<<endl);
-		ros::Duration(1).sleep();
-		ros::spinOnce();
-	}
-
+	subscribeCost();
 	if(new_cost_)
 	{
 		img=cost_;
@@ -436,14 +540,7 @@ bool MultisenseImage::giveCostImage(cv::Mat &img)
  */
 bool MultisenseImage::giveCameraInfo(cv::Mat &cam)
 {
-	if(!config_callback_active_)
-	{
-		 multisense_sub_=nh_.subscribe(multisense_topic_,1,&MultisenseImage::loadCameraConfig, this);
-		 config_callback_active_=true;
-		 ROS_INFO_STREAM("Listening to: "<<multisense_sub_.getTopic()<<endl);
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
-	}
+	subscribeConfig();
 	if(!settings.camera_.empty())
 	{
 		cam=settings.camera_;
@@ -456,14 +553,7 @@ bool MultisenseImage::giveCameraInfo(cv::Mat &cam)
  */
 bool MultisenseImage::giveQMatrix(cv::Mat &Q)
 {
-	if(!config_callback_active_)
-	{
-		 multisense_sub_=nh_.subscribe(multisense_topic_,1,&MultisenseImage::loadCameraConfig, this);
-		 config_callback_active_=true;
-		 ROS_INFO_STREAM("Listening to: "<<multisense_sub_.getTopic()<<endl);
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
-	}
+	subscribeConfig();
 	if(!settings.Q_matrix_.empty())
 	{
 		Q=settings.Q_matrix_;
@@ -472,35 +562,91 @@ bool MultisenseImage::giveQMatrix(cv::Mat &Q)
 	return false;
 }
 
+void MultisenseImage::registerImageCallback(const FrameNotifier<cv::Mat>::Callback &callback)
+{
+	image_notifier_.registerCallback(callback);
+	subscribeImage();
+}
+
+void MultisenseImage::registerDisparityCallback(const FrameNotifier<cv::Mat>::Callback &callback)
+{
+	disparity_notifier_.registerCallback(callback);
+	if(use_cpu_stereo_)
+		startCpuStereo();
+	else
+		subscribeDisparity();
+}
+
+void MultisenseImage::registerDepthCallback(const FrameNotifier<cv::Mat>::Callback &callback)
+{
+	depth_notifier_.registerCallback(callback);
+	if(use_cpu_stereo_)
+		startCpuStereo();
+	else
+		subscribeDepth();
+}
+
+std::future<cv::Mat> MultisenseImage::nextImageAfter(const ros::Time &time)
+{
+	std::future<cv::Mat> next = image_notifier_.nextAfter(time);
+	subscribeImage();
+	return next;
+}
+
+std::future<cv::Mat> MultisenseImage::nextDisparityAfter(const ros::Time &time)
+{
+	std::future<cv::Mat> next = disparity_notifier_.nextAfter(time);
+	if(use_cpu_stereo_)
+		startCpuStereo();
+	else
+		subscribeDisparity();
+	return next;
+}
+
+std::future<cv::Mat> MultisenseImage::nextDepthAfter(const ros::Time &time)
+{
+	std::future<cv::Mat> next = depth_notifier_.nextAfter(time);
+	if(use_cpu_stereo_)
+		startCpuStereo();
+	else
+		subscribeDepth();
+	return next;
+}
+
 bool MultisenseImage::giveSyncImages(cv::Mat &color, cv::Mat &disp)
 {
 	ROS_INFO_STREAM_ONCE("Requesting synchornized image");
+	if(use_cpu_stereo_)
+	{
+		startCpuStereo();
+		if(!new_image_ || !new_disp_ || image_.empty())
+			return false;
+		color=image_;
+		disp=disparity_;
+		new_image_=new_disp_=false;
+		return true;
+	}
 	if(sync_==nullptr)
 	{
 		cam_sub_.shutdown();
-		sync_cam_sub_=new image_transport::SubscriberFilter(it_,image_topic_, 1);
-		//cam_sub_=sync_cam_sub_.getSubscriber();
-		image_callback_active_=true;
-		ROS_INFO_STREAM("Listening to: "<<sync_cam_sub_->getTopic()<<endl);
 		disp_sub_.shutdown();
+		sync_.reset(new ImageSynchronizer(2, sync_ring_size_, sync_tolerance_,
+		                                  boost::bind(&MultisenseImage::syncCallback, this, _1)));
+		ImageSynchronizer *sync = sync_.get();
+		sync_cam_sub_=it_.subscribe(image_topic_, 1, boost::bind(&ImageSynchronizer::add, sync, 0, _1));
+		image_callback_active_=true;
+		ROS_INFO_STREAM("Listening to: "<<sync_cam_sub_.getTopic()<<endl);
 #ifndef GAZEBO_SIMULATION
         ROS_INFO("DRCSIM not enabled");
-		sync_disp_sub_=new image_transport::SubscriberFilter(it_,disp_topic_, 1);
+		sync_disp_sub_=it_.subscribe(disp_topic_, 1, boost::bind(&ImageSynchronizer::add, sync, 1, _1));
 #else
 		ROS_INFO_STREAM("DRCSIM topics enabled");
-		sync_disp_sub_=new message_filters::Subscriber<stereo_msgs::DisparityImage>(nh_,disp_topic_, 1);
+		// the image of the disparity message shares its lifetime, so it is passed on without a copy
+		sync_disp_sub_=nh_.subscribe<stereo_msgs::DisparityImage>(disp_topic_, 1,
+		        [sync](const stereo_msgs::DisparityImageConstPtr &msg){ sync->add(1, sensor_msgs::ImageConstPtr(msg, &msg->image)); });
 #endif
-		//disp_sub_=sync_disp_sub_.getSubscriber();
 		disp_callback_active_=true;
-		ROS_INFO_STREAM("Listening to: "<<sync_disp_sub_->getTopic()<<endl);
-#ifndef GAZEBO_SIMULATION
-		sync_.reset( new message_filters::Synchronizer< exactTimePolicy >( exactTimePolicy( 1000 ), *sync_cam_sub_, *sync_disp_sub_ ));
-#else
-		sync_.reset( new message_filters::Synchronizer< approxTimePolicy >( approxTimePolicy( 100 ), *sync_cam_sub_, *sync_disp_sub_ ));
-#endif
-		sync_->registerCallback( boost::bind( &MultisenseImage::syncCallback, this, _1, _2 ) );
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
+		ROS_INFO_STREAM("Listening to: "<<sync_disp_sub_.getTopic()<<endl);
 
 	}
 
@@ -517,30 +663,39 @@ bool MultisenseImage::giveSyncImages(cv::Mat &color, cv::Mat &disp)
 bool MultisenseImage::giveSyncDepthImages(cv::Mat &color, cv::Mat &disp, cv::Mat &cost)
 {
 	ROS_INFO_STREAM_ONCE("Requesting synchornized depth image");
+	if(use_cpu_stereo_)
+	{
+		startCpuStereo();
+		if(!new_image_ || !new_depth_ || !new_cost_ || image_.empty())
+			return false;
+		color=image_;
+		disp=depth_;
+		cost=cost_;
+		new_image_=new_depth_=new_cost_=false;
+		return true;
+	}
 	if(sync_depth_==nullptr)
 	{
-		cam_sub_.shutdown();
-		sync_cam_sub_=new image_transport::SubscriberFilter(it_,image_topic_, 1);
-		//cam_sub_=sync_cam_sub_.getSubscriber();
-		image_callback_active_=true;
-		ROS_INFO_STREAM("Listening to: "<<sync_cam_sub_->getTopic()<<endl);
-		depth_sub_.shutdown();
-#ifndef GAZEBO_SIMULATION
-        ROS_INFO("DRCSIM not enabled");
-        sync_cam_depth_sub_=new image_transport::SubscriberFilter(it_,depth_topic_, 1);
-        sync_cam_cost_sub_=new image_transport::SubscriberFilter(it_,depth_cost_topic_, 1);
-#else
+#ifdef GAZEBO_SIMULATION
 		ROS_ERROR_STREAM("Depth Image not available in simulation");
 		return false;
 #endif
+		cam_sub_.shutdown();
+		depth_sub_.shutdown();
+		cost_sub_.shutdown();
+		sync_depth_.reset(new ImageSynchronizer(3, sync_ring_size_, sync_tolerance_,
+		                                        boost::bind(&MultisenseImage::syncDepthCallback, this, _1)));
+		ImageSynchronizer *sync = sync_depth_.get();
+		sync_depth_cam_sub_=it_.subscribe(image_topic_, 1, boost::bind(&ImageSynchronizer::add, sync, 0, _1));
+		sync_cam_depth_sub_=it_.subscribe(depth_topic_, 1, boost::bind(&ImageSynchronizer::add, sync, 1, _1));
+		sync_cam_cost_sub_=it_.subscribe(depth_cost_topic_, 1, boost::bind(&ImageSynchronizer::add, sync, 2, _1));
+		image_callback_active_=true;
+		depth_callback_active_=true;
+		cost_callback_active_=true;
 
-
-		ROS_INFO_STREAM("Listening to: "<<sync_cam_depth_sub_->getTopic()<<endl);
-		ROS_INFO_STREAM("Listening to: "<<sync_cam_cost_sub_->getTopic()<<endl);
-		sync_depth_.reset( new message_filters::Synchronizer< depthImageCostExactTimePolicy >( depthImageCostExactTimePolicy( 1000 ), *sync_cam_sub_, *sync_cam_depth_sub_, *sync_cam_cost_sub_ ));
-		sync_depth_->registerCallback( boost::bind( &MultisenseImage::syncDepthCallback, this, _1, _2, _3 ) );
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
+		ROS_INFO_STREAM("Listening to: "<<sync_depth_cam_sub_.getTopic()<<endl);
+		ROS_INFO_STREAM("Listening to: "<<sync_cam_depth_sub_.getTopic()<<endl);
+		ROS_INFO_STREAM("Listening to: "<<sync_cam_cost_sub_.getTopic()<<endl);
 
 	}
 
@@ -552,6 +707,24 @@ bool MultisenseImage::giveSyncDepthImages(cv::Mat &color, cv::Mat &disp, cv::Mat
 	return true;
 }
 
+bool MultisenseImage::giveSyncStatistics(ImageSynchronizer::Statistics &stats)
+{
+	ImageSynchronizer *sync = use_cpu_stereo_ ? sync_stereo_.get() : sync_.get();
+	if(sync==nullptr)
+		return false;
+	stats=sync->getStatistics();
+	return true;
+}
+
+bool MultisenseImage::giveSyncDepthStatistics(ImageSynchronizer::Statistics &stats)
+{
+	ImageSynchronizer *sync = use_cpu_stereo_ ? sync_stereo_.get() : sync_depth_.get();
+	if(sync==nullptr)
+		return false;
+	stats=sync->getStatistics();
+	return true;
+}
+
 //this function is a temp function that I am implementing, maybe the statistics on the fps must be maintained internally and
 //not by the called class;
 bool MultisenseImage::giveTime(ros::Time &time)
@@ -583,13 +756,14 @@ bool MultisenseImage::giveSyncDepthImageswTime(cv::Mat &color, cv::Mat &disp, cv
  * @note none
  */
 MultisenseImage::~MultisenseImage() {
-//	sync_->~Synchronizer();
-	//sync_->~Synchronizer();
-	//delete sync_;
-//	sync_cam_sub_->unsubscribe();
-//	sync_disp_sub_->unsubscribe();
-//	delete sync_cam_sub_;
-//	delete sync_disp_sub_;
+	// stop the callbacks before the synchronizers they feed are destroyed
+	sync_cam_sub_.shutdown();
+	sync_disp_sub_.shutdown();
+	sync_depth_cam_sub_.shutdown();
+	sync_cam_depth_sub_.shutdown();
+	sync_cam_cost_sub_.shutdown();
+	sync_left_sub_.shutdown();
+	sync_right_sub_.shutdown();
 }
 
 } /* namespace tough_perception */
@@ -11,14 +11,11 @@
 #include <tough_perception_common/perception_common_names.h>
 #include <tf_conversions/tf_eigen.h>
 #include <pcl/common/transforms.h>
+#include <unordered_map>
 
 
 namespace tough_perception {
 
-bool MultisensePointCloud::laser_wrt_l_foot_callback_active_ = false;
-bool MultisensePointCloud::laser_callback_active_=false;
-bool MultisensePointCloud::stereo_callback_active_=false;
-
 using namespace std;
 using namespace pcl;
 
@@ -39,7 +36,17 @@ MultisensePointCloud::MultisensePointCloud(ros::NodeHandle &nh, const string bas
     laser_cloud_wrt_l_foot_(new LaserPointCloud),
     laser_cloud_(new LaserPointCloud),
     stereo_cloud_(new StereoPointCloud),
-    unified_cloud_(new UnifiedPointCloud)
+    unified_cloud_(new UnifiedPointCloud),
+    new_stereo_(false),
+    new_laser_(false),
+    new_laser_wrt_l_foot_(false),
+    new_unified_(false),
+    laser_callback_active_(false),
+    laser_wrt_l_foot_callback_active_(false),
+    stereo_callback_active_(false),
+    unified_callback_active_(false),
+    fusion_running_(false),
+    fusion_input_ready_(false)
 {
 	ros::NodeHandle pnh("~");
 	if(!pnh.getParam("laser_topic",laser_topic_))
@@ -50,12 +57,14 @@ MultisensePointCloud::MultisensePointCloud(ros::NodeHandle &nh, const string bas
 	{
         stereo_topic_=PERCEPTION_COMMON_NAMES::MULTISENSE_STEREO_CLOUD_TOPIC;
 	}
+	// voxel size used to deduplicate the unified cloud
+	pnh.param<float>("unified_voxel_size", unified_voxel_size_, 0.02f);
+	// depth at which a stereo point has a confidence of 0.5. stereo depth error grows with the square of depth
+	pnh.param<float>("stereo_confidence_range", stereo_confidence_range_, 3.0f);
+	// stereo points further than this are not added to the unified cloud
+	pnh.param<float>("stereo_max_range", stereo_max_range_, 8.0f);
 
 
-	new_laser_=false;
-    new_laser_wrt_l_foot_=false;
-	new_stereo_=false;
-	new_unified_=false;
 	spindle_rate_=0.00;
 
 }
@@ -157,7 +166,8 @@ void MultisensePointCloud::saveToLaserCloudWrtLFoot(const sensor_msgs::PointClou
  */
 void MultisensePointCloud::laserCallback(const sensor_msgs::PointCloud2ConstPtr& msg)
 {
-
+	// fill a new cloud so that clouds already handed out are not modified
+	laser_cloud_.reset(new LaserPointCloud);
 
 	if(msg->fields[3].datatype==sensor_msgs::PointField::UINT32)
 	{
@@ -174,6 +184,15 @@ void MultisensePointCloud::laserCallback(const sensor_msgs::PointCloud2ConstPtr&
 	//saveToLaserCloud(msg);
 
 	new_laser_=true;
+	laser_notifier_.notify(laser_cloud_, pcl_conversions::fromPCL(laser_cloud_->header).stamp);
+
+	if(fusion_running_)
+	{
+		std::lock_guard<std::mutex> lock(fusion_mutex_);
+		fusion_laser_ = laser_cloud_;
+		fusion_input_ready_ = true;
+		fusion_cv_.notify_one();
+	}
 	ROS_INFO_ONCE("Laser Cloud: width = %d, height = %d, header = %s, isdense = %d\n", laser_cloud_->width, laser_cloud_->height,laser_cloud_->header.frame_id.c_str(),laser_cloud_->is_dense);
 }
 
@@ -227,14 +246,7 @@ void MultisensePointCloud::laserCallbackWrtLFoot(const sensor_msgs::PointCloud2C
 }
 bool MultisensePointCloud::giveLaserCloudForTime(const ros::Time &time, LaserPointCloud::Ptr &out)
 {
-	if(!laser_callback_active_)
-	{
-            laser_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(laser_topic_.c_str(), 1, &MultisensePointCloud::laserCallback, this);
-			ROS_INFO_STREAM("Listening to laser cloud in: "<<laser_sub_.getTopic()<<endl);
-			laser_callback_active_=true;
-			ros::Duration(1).sleep();
-			ros::spinOnce();
-	}
+	subscribeLaser();
 	if(!new_laser_)
 	{
 		return false;
@@ -269,42 +281,255 @@ bool MultisensePointCloud::giveLaserCloudForTime(const ros::Time &time, LaserPoi
  */
 void MultisensePointCloud::stereoCallback(const sensor_msgs::PointCloud2ConstPtr& msg)
 {
-	stereo_cloud_->clear();
+	stereo_cloud_.reset(new StereoPointCloud);
 	pcl::fromROSMsg(*msg,*stereo_cloud_);
 	new_stereo_=true;
+	stereo_notifier_.notify(stereo_cloud_, pcl_conversions::fromPCL(stereo_cloud_->header).stamp);
+
+	if(fusion_running_)
+	{
+		std::lock_guard<std::mutex> lock(fusion_mutex_);
+		fusion_stereo_ = stereo_cloud_;
+		fusion_input_ready_ = true;
+		fusion_cv_.notify_one();
+	}
 	ROS_INFO_ONCE("Stereo Cloud: width = %d, height = %d, header = %s, isdense = %d\n", msg->width, msg->height,stereo_cloud_->header.frame_id.c_str(),stereo_cloud_->is_dense);
 }
 /**
- * @note TODO: IMPLEMENT IT
+ * @note starts the subscribers and the fusion thread if not started
  */
 bool MultisensePointCloud::giveUnifiedCloud(UnifiedPointCloud::Ptr &out)
 {
+	startFusion();
+
+	std::lock_guard<std::mutex> lock(fusion_mutex_);
 	if(new_unified_)
 	{
 		out=unified_cloud_;
-		new_stereo_=false;
+		new_unified_=false;
 		return true;
 	}
 	return(false);
 }
+
 /**
- * @note stereo cloud without color
+ * @note a laser or stereo cloud is transformed only once, the transformed copy is reused for every
+ *       fusion until that source publishes a new cloud
  */
-bool MultisensePointCloud::giveStereoCloud(StereoPointCloud::Ptr &out)
+void MultisensePointCloud::fusionLoop()
 {
-	if(!stereo_callback_active_)
+	LaserPointCloud::ConstPtr  laser_src, laser_in;
+	StereoPointCloud::ConstPtr stereo_src, stereo_in, stereo_cam;
+	LaserPointCloud::Ptr       laser_base;
+	StereoPointCloud::Ptr      stereo_base;
+
+	while(true)
 	{
-		stereo_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(stereo_topic_.c_str(), 1, &MultisensePointCloud::stereoCallback, this);;
-		ROS_INFO_STREAM("Listening to stereo cloud in: "<<stereo_sub_.getTopic()<<endl);
-		stereo_callback_active_=true;
-		ros::Duration(1).sleep();
-		ros::spinOnce();
+		{
+			std::unique_lock<std::mutex> lock(fusion_mutex_);
+			fusion_cv_.wait(lock, [this]{ return fusion_input_ready_ || !fusion_running_; });
+			if(!fusion_running_)
+				return;
+			fusion_input_ready_ = false;
+			laser_in  = fusion_laser_;
+			stereo_in = fusion_stereo_;
+		}
+
+		Eigen::Affine3f transform;
+		if(laser_in && laser_in != laser_src)
+		{
+			if(transformToBase(laser_in->header.frame_id, laser_in->header.stamp, transform))
+			{
+				laser_base.reset(new LaserPointCloud);
+				pcl::transformPointCloud(*laser_in, *laser_base, transform);
+			}
+			laser_src = laser_in;
+		}
+		if(stereo_in && stereo_in != stereo_src)
+		{
+			if(transformToBase(stereo_in->header.frame_id, stereo_in->header.stamp, transform))
+			{
+				stereo_base.reset(new StereoPointCloud);
+				pcl::transformPointCloud(*stereo_in, *stereo_base, transform);
+				stereo_cam = stereo_in;
+			}
+			stereo_src = stereo_in;
+		}
+
+		UnifiedPointCloud::Ptr fused(new UnifiedPointCloud);
+		fuseClouds(laser_base, stereo_cam, stereo_base, *fused);
+
+		{
+			std::lock_guard<std::mutex> lock(fusion_mutex_);
+			unified_cloud_ = fused;
+			new_unified_   = true;
+		}
+		unified_notifier_.notify(fused, pcl_conversions::fromPCL(fused->header).stamp);
 	}
+}
 
-	if(new_stereo_)
+bool MultisensePointCloud::transformToBase(const std::string &frame, uint64_t pcl_stamp, Eigen::Affine3f &transform)
+{
+	if(frame == base_frame_)
+	{
+		transform = Eigen::Affine3f::Identity();
+		return true;
+	}
+
+	ros::Time stamp;
+	pcl_conversions::fromPCL(pcl_stamp, stamp);
+	tf::StampedTransform stamped_tf;
+	try
+	{
+		// fall back to the latest transform if the one at the stamp of the cloud is not available
+		if(!tf_listener.waitForTransform(base_frame_, frame, stamp, ros::Duration(0.5)))
+			stamp = ros::Time(0);
+		tf_listener.lookupTransform(base_frame_, frame, stamp, stamped_tf);
+	}
+	catch(tf::TransformException &ex)
+	{
+		ROS_ERROR("%s",ex.what());
+		return false;
+	}
+	Eigen::Affine3d transform_d;
+	tf::transformTFToEigen(stamped_tf, transform_d);
+	transform = transform_d.cast<float>();
+	return true;
+}
+
+void MultisensePointCloud::fuseClouds(const LaserPointCloud::ConstPtr &laser, const StereoPointCloud::ConstPtr &stereo_cam,
+                                      const StereoPointCloud::ConstPtr &stereo, UnifiedPointCloud &out)
+{
+	// running confidence weighted sum of the points in a voxel
+	struct VoxelAccumulator
+	{
+		Eigen::Vector3f weighted_sum;
+		float           weight;
+		float           miss_probability;
+		uint32_t        source;
+	};
+
+	const float inv_leaf = 1.0f/unified_voxel_size_;
+	// 21 bits per axis, offset so that negative indices are packed correctly
+	auto voxelKey = [inv_leaf](float x, float y, float z)
+	{
+		const int64_t offset = 1 << 20;
+		uint64_t ix = static_cast<uint64_t>(static_cast<int64_t>(std::floor(x*inv_leaf)) + offset) & 0x1FFFFF;
+		uint64_t iy = static_cast<uint64_t>(static_cast<int64_t>(std::floor(y*inv_leaf)) + offset) & 0x1FFFFF;
+		uint64_t iz = static_cast<uint64_t>(static_cast<int64_t>(std::floor(z*inv_leaf)) + offset) & 0x1FFFFF;
+		return (ix << 42) | (iy << 21) | iz;
+	};
+
+	std::vector<VoxelAccumulator>            voxels;
+	std::unordered_map<uint64_t, size_t>     voxel_index;
+	size_t expected = (laser ? laser->size() : 0) + (stereo ? stereo->size() : 0);
+	voxels.reserve(expected);
+	voxel_index.reserve(expected);
+
+	auto addPoint = [&](float x, float y, float z, float confidence, uint32_t source)
+	{
+		// the key is computed once and looked up once, emplace does nothing if the voxel already exists
+		auto inserted = voxel_index.emplace(voxelKey(x, y, z), voxels.size());
+		if(inserted.second)
+		{
+			voxels.push_back({Eigen::Vector3f(x, y, z)*confidence, confidence, 1.0f - confidence, source});
+			return;
+		}
+		VoxelAccumulator &voxel = voxels[inserted.first->second];
+		voxel.weighted_sum     += Eigen::Vector3f(x, y, z)*confidence;
+		voxel.weight           += confidence;
+		voxel.miss_probability *= (1.0f - confidence);
+		voxel.source           |= source;
+	};
+
+	if(laser)
+	{
+		for(const auto &pt : laser->points)
+		{
+			if(!pcl::isFinite(pt))
+				continue;
+			addPoint(pt.x, pt.y, pt.z, 1.0f, SOURCE_LASER);
+		}
+	}
+
+	if(stereo && stereo_cam && stereo_cam->size() == stereo->size())
+	{
+		// stereo points are weighted by their depth in the camera frame and not in the base frame
+		for(size_t i = 0; i < stereo->size(); ++i)
+		{
+			const StereoPoint &pt = stereo->points[i];
+			if(!pcl::isFinite(pt))
+				continue;
+			float depth = stereo_cam->points[i].z;
+			if(depth <= 0.0f || depth > stereo_max_range_)
+				continue;
+			float ratio = depth/stereo_confidence_range_;
+			addPoint(pt.x, pt.y, pt.z, 1.0f/(1.0f + ratio*ratio), SOURCE_STEREO);
+		}
+	}
+
+	out.points.resize(voxels.size());
+	for(size_t i = 0; i < voxels.size(); ++i)
+	{
+		UnifiedPoint &pt = out.points[i];
+		pt.getVector3fMap() = voxels[i].weighted_sum/voxels[i].weight;
+		pt.confidence       = 1.0f - voxels[i].miss_probability;
+		pt.source           = voxels[i].source;
+	}
+	out.width           = out.points.size();
+	out.height          = 1;
+	out.is_dense        = true;
+	out.header.frame_id = base_frame_;
+	if(laser)
+		out.header.stamp = laser->header.stamp;
+	if(stereo && stereo->header.stamp > out.header.stamp)
+		out.header.stamp = stereo->header.stamp;
+}
+
+void MultisensePointCloud::subscribeLaser()
+{
+	if(laser_callback_active_.exchange(true))
+		return;
+	laser_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(laser_topic_.c_str(), 1, &MultisensePointCloud::laserCallback, this);
+	ROS_INFO_STREAM("Listening to laser cloud in: "<<laser_sub_.getTopic()<<endl);
+}
+
+void MultisensePointCloud::subscribeLaserWrtLFoot()
+{
+	if(laser_wrt_l_foot_callback_active_.exchange(true))
+		return;
+	laser_sub_wrt_l_foot_ = nh_.subscribe<sensor_msgs::PointCloud2>(laser_topic_.c_str(), 1, &MultisensePointCloud::laserCallbackWrtLFoot, this);
+	ROS_INFO_STREAM("Listening to laser cloud in: "<<laser_sub_wrt_l_foot_.getTopic()<<endl);
+}
+
+void MultisensePointCloud::subscribeStereo()
+{
+	if(stereo_callback_active_.exchange(true))
+		return;
+	stereo_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(stereo_topic_.c_str(), 1, &MultisensePointCloud::stereoCallback, this);
+	ROS_INFO_STREAM("Listening to stereo cloud in: "<<stereo_sub_.getTopic()<<endl);
+}
+
+void MultisensePointCloud::startFusion()
+{
+	if(unified_callback_active_.exchange(true))
+		return;
+	fusion_running_=true;
+	fusion_thread_ = std::thread(&MultisensePointCloud::fusionLoop, this);
+	subscribeLaser();
+	subscribeStereo();
+	ROS_INFO_STREAM("Fusing laser and stereo clouds in "<<base_frame_<<" with voxel size "<<unified_voxel_size_);
+}
+
+/**
+ * @note stereo cloud without color
+ */
+bool MultisensePointCloud::giveStereoCloud(StereoPointCloud::Ptr &out)
+{
+	subscribeStereo();
+	if(new_stereo_.exchange(false))
 	{
 		out=stereo_cloud_;
-		new_stereo_=false;
 		return true;
 	}
 	return(false);
@@ -314,18 +539,10 @@ bool MultisensePointCloud::giveStereoCloud(StereoPointCloud::Ptr &out)
  */
 bool MultisensePointCloud::giveLaserCloud(LaserPointCloud::Ptr &out)
 {
-	if(!laser_callback_active_)
-	{
-		laser_sub_ = nh_.subscribe<sensor_msgs::PointCloud2>(laser_topic_.c_str(), 1, &MultisensePointCloud::laserCallback, this);
-		ROS_INFO_STREAM("Listening to laser cloud in: "<<laser_sub_.getTopic()<<endl);
-		laser_callback_active_=true;
-		 ros::Duration(1).sleep();
-		 ros::spinOnce();
-	}
-	if(new_laser_)
+	subscribeLaser();
+	if(new_laser_.exchange(false))
 	{
 		out=laser_cloud_;
-		new_laser_=false;
 		return true;
 	}
 	return(false);
@@ -336,28 +553,69 @@ bool MultisensePointCloud::giveLaserCloud(LaserPointCloud::Ptr &out)
  */
 bool MultisensePointCloud::giveLaserCloudWrtLFoot(LaserPointCloud::Ptr &out)
 {
-    if(!laser_wrt_l_foot_callback_active_)
-    {
-        laser_sub_wrt_l_foot_ = nh_.subscribe<sensor_msgs::PointCloud2>(laser_topic_.c_str(), 1, &MultisensePointCloud::laserCallbackWrtLFoot, this);
-        ROS_INFO_STREAM("Listening to laser cloud in: "<<laser_sub_wrt_l_foot_.getTopic()<<endl);
-        laser_wrt_l_foot_callback_active_ = true;
-         ros::Duration(1).sleep();
-         ros::spinOnce();
-    }
-    if(new_laser_wrt_l_foot_)
+    subscribeLaserWrtLFoot();
+    if(new_laser_wrt_l_foot_.exchange(false))
     {
         out=laser_cloud_wrt_l_foot_;
-        new_laser_wrt_l_foot_ = false;
         return true;
     }
     return(false);
 }
 
+void MultisensePointCloud::registerLaserCallback(const FrameNotifier<LaserPointCloud::ConstPtr>::Callback &callback)
+{
+	laser_notifier_.registerCallback(callback);
+	subscribeLaser();
+}
+
+void MultisensePointCloud::registerStereoCallback(const FrameNotifier<StereoPointCloud::ConstPtr>::Callback &callback)
+{
+	stereo_notifier_.registerCallback(callback);
+	subscribeStereo();
+}
+
+void MultisensePointCloud::registerUnifiedCallback(const FrameNotifier<UnifiedPointCloud::ConstPtr>::Callback &callback)
+{
+	unified_notifier_.registerCallback(callback);
+	startFusion();
+}
+
+std::future<LaserPointCloud::ConstPtr> MultisensePointCloud::nextLaserCloudAfter(const ros::Time &time)
+{
+	std::future<LaserPointCloud::ConstPtr> next = laser_notifier_.nextAfter(time);
+	subscribeLaser();
+	return next;
+}
+
+std::future<StereoPointCloud::ConstPtr> MultisensePointCloud::nextStereoCloudAfter(const ros::Time &time)
+{
+	std::future<StereoPointCloud::ConstPtr> next = stereo_notifier_.nextAfter(time);
+	subscribeStereo();
+	return next;
+}
+
+std::future<UnifiedPointCloud::ConstPtr> MultisensePointCloud::nextUnifiedCloudAfter(const ros::Time &time)
+{
+	std::future<UnifiedPointCloud::ConstPtr> next = unified_notifier_.nextAfter(time);
+	startFusion();
+	return next;
+}
+
 /**
  * @note destructor
  */
 MultisensePointCloud::~MultisensePointCloud()
 {
+	if(fusion_thread_.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(fusion_mutex_);
+			fusion_running_=false;
+		}
+		fusion_cv_.notify_one();
+		fusion_thread_.join();
+	}
+
 	laser_sub_.shutdown();
 	stereo_sub_.shutdown();
 
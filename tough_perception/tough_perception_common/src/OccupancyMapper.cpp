@@ -0,0 +1,334 @@
+/**
+ ********************************************************************************************************
+ * @file    OccupancyMapper.cpp
+ * @brief   OccupancyMapper class definition
+ * @details Incremental log odds voxel map with parallel raycasting
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/OccupancyMapper.h>
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace tough_perception {
+
+namespace {
+
+const int      KEY_BITS   = 21;
+const int      KEY_OFFSET = 1 << (KEY_BITS - 1);
+const uint64_t KEY_MASK   = (1ULL << KEY_BITS) - 1;
+
+float logOdds(float probability)
+{
+    return std::log(probability/(1.0f - probability));
+}
+
+}
+
+OccupancyMapper::OccupancyMapper(const OccupancyMapperParams &params):
+    params_(params)
+{
+    log_odds_hit_     = logOdds(params_.prob_hit);
+    log_odds_miss_    = logOdds(params_.prob_miss);
+    log_odds_min_     = logOdds(params_.clamp_min);
+    log_odds_max_     = logOdds(params_.clamp_max);
+    log_odds_thres_   = logOdds(params_.occupancy_thres);
+    projection_min_z_ = toIndex(params_.projection_min_z);
+    projection_max_z_ = toIndex(params_.projection_max_z);
+}
+
+uint64_t OccupancyMapper::toKey(int x, int y, int z)
+{
+    return  (static_cast<uint64_t>(x + KEY_OFFSET) & KEY_MASK)                 |
+           ((static_cast<uint64_t>(y + KEY_OFFSET) & KEY_MASK) << KEY_BITS)    |
+           ((static_cast<uint64_t>(z + KEY_OFFSET) & KEY_MASK) << 2*KEY_BITS);
+}
+
+void OccupancyMapper::fromKey(uint64_t key, int &x, int &y, int &z)
+{
+    x = static_cast<int>( key                & KEY_MASK) - KEY_OFFSET;
+    y = static_cast<int>((key >> KEY_BITS)   & KEY_MASK) - KEY_OFFSET;
+    z = static_cast<int>((key >> 2*KEY_BITS) & KEY_MASK) - KEY_OFFSET;
+}
+
+void OccupancyMapper::voxelCenter(uint64_t key, pcl::PointXYZ &pt) const
+{
+    int x, y, z;
+    fromKey(key, x, y, z);
+    pt.x = (x + 0.5f)*params_.resolution;
+    pt.y = (y + 0.5f)*params_.resolution;
+    pt.z = (z + 0.5f)*params_.resolution;
+}
+
+/**
+ * @note Amanatides and Woo voxel traversal. t is the fraction of the ray travelled, tmax the fraction at
+ *       which the next voxel boundary of each axis is crossed.
+ */
+void OccupancyMapper::traceRay(const Eigen::Vector3f &origin, const Eigen::Vector3f &end, std::unordered_set<uint64_t> &free) const
+{
+    int current[3], last[3], step[3];
+    float tmax[3], tdelta[3];
+    const Eigen::Vector3f dir = end - origin;
+
+    for(int i = 0; i < 3; ++i)
+    {
+        current[i] = toIndex(origin[i]);
+        last[i]    = toIndex(end[i]);
+        if(dir[i] > 0.0f)
+        {
+            step[i]   = 1;
+            tmax[i]   = ((current[i] + 1)*params_.resolution - origin[i])/dir[i];
+            tdelta[i] = params_.resolution/dir[i];
+        }
+        else if(dir[i] < 0.0f)
+        {
+            step[i]   = -1;
+            tmax[i]   = (current[i]*params_.resolution - origin[i])/dir[i];
+            tdelta[i] = -params_.resolution/dir[i];
+        }
+        else
+        {
+            step[i]   = 0;
+            tmax[i]   = std::numeric_limits<float>::max();
+            tdelta[i] = std::numeric_limits<float>::max();
+        }
+    }
+
+    // bounds the traversal in case rounding makes it miss the last voxel
+    int steps = std::abs(last[0] - current[0]) + std::abs(last[1] - current[1]) + std::abs(last[2] - current[2]);
+    for(; steps > 0; --steps)
+    {
+        if(current[0] == last[0] && current[1] == last[1] && current[2] == last[2])
+            break;
+        free.insert(toKey(current[0], current[1], current[2]));
+
+        int axis = tmax[0] < tmax[1] ? (tmax[0] < tmax[2] ? 0 : 2) : (tmax[1] < tmax[2] ? 1 : 2);
+        current[axis] += step[axis];
+        tmax[axis]    += tdelta[axis];
+    }
+}
+
+void OccupancyMapper::updateVoxel(uint64_t key, float log_odds_update)
+{
+    auto inserted   = voxels_.insert(std::make_pair(key, 0.0f));
+    float &log_odds = inserted.first->second;
+    const bool is_new       = inserted.second;
+    const bool was_occupied = !is_new && log_odds > log_odds_thres_;
+
+    log_odds = std::min(log_odds_max_, std::max(log_odds_min_, log_odds + log_odds_update));
+    const bool occupied = log_odds > log_odds_thres_;
+
+    if(occupied != was_occupied)
+    {
+        // a voxel flipping back before the changes are taken cancels out
+        if(occupied)
+        {
+            if(freed_changes_.erase(key) == 0)
+                occupied_changes_.insert(key);
+        }
+        else if(occupied_changes_.erase(key) == 0)
+        {
+            freed_changes_.insert(key);
+        }
+    }
+
+    int x, y, z;
+    fromKey(key, x, y, z);
+    if(z < projection_min_z_ || z > projection_max_z_ || (!is_new && occupied == was_occupied))
+        return;
+
+    Column &column = columns_[toKey(x, y, 0)];
+    if(is_new)
+        ++column.known;
+    if(occupied != was_occupied)
+        column.occupied += occupied ? 1 : -1;
+}
+
+/**
+ * @note the rays are split between threads that collect the traversed voxels in their own sets. The
+ *       sets are merged and a voxel that holds an endpoint of this cloud is only updated as a hit.
+ */
+size_t OccupancyMapper::insertCloud(const pcl::PointCloud<pcl::PointXYZ> &cloud, const Eigen::Vector3f &origin)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // endpoints are deduplicated within this scan only, so that a voxel hit again after being freed is marked again
+    std::vector<Eigen::Vector3f> ends;
+    std::unordered_set<uint64_t> endpoints, hits;
+    for(const auto &pt : cloud.points)
+    {
+        if(!pcl::isFinite(pt))
+            continue;
+
+        const uint64_t key = toKey(toIndex(pt.x), toIndex(pt.y), toIndex(pt.z));
+        if(!endpoints.insert(key).second)
+            continue;
+
+        Eigen::Vector3f end = pt.getVector3fMap();
+        const float range = (end - origin).norm();
+        if(params_.max_range > 0.0f && range > params_.max_range)
+        {
+            end = origin + (end - origin)*(params_.max_range/range);
+        }
+        else
+        {
+            hits.insert(key);
+        }
+        ends.push_back(end);
+    }
+
+    if(ends.empty())
+        return 0;
+
+    int num_threads = params_.num_threads > 0 ? params_.num_threads : std::thread::hardware_concurrency();
+    num_threads = std::max(1, std::min<int>(num_threads, ends.size()));
+
+    std::vector<std::unordered_set<uint64_t>> free(num_threads);
+    auto trace = [&](int thread, size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+        {
+            traceRay(origin, ends[i], free[thread]);
+        }
+    };
+
+    const size_t chunk = (ends.size() + num_threads - 1)/num_threads;
+    if(num_threads == 1)
+    {
+        trace(0, 0, ends.size());
+    }
+    else
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(num_threads);
+        for(int t = 0; t < num_threads; ++t)
+        {
+            workers.emplace_back(trace, t, std::min(t*chunk, ends.size()), std::min((t + 1)*chunk, ends.size()));
+        }
+        for(auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    for(size_t t = 1; t < free.size(); ++t)
+    {
+        free[0].insert(free[t].begin(), free[t].end());
+        std::unordered_set<uint64_t>().swap(free[t]);
+    }
+    for(uint64_t key : free[0])
+    {
+        if(hits.count(key) == 0)
+            updateVoxel(key, log_odds_miss_);
+    }
+    for(uint64_t key : hits)
+    {
+        updateVoxel(key, log_odds_hit_);
+    }
+
+    return ends.size();
+}
+
+void OccupancyMapper::takeChanges(pcl::PointCloud<pcl::PointXYZ> &occupied, pcl::PointCloud<pcl::PointXYZ> &freed)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    occupied.clear();
+    freed.clear();
+    occupied.points.resize(occupied_changes_.size());
+    freed.points.resize(freed_changes_.size());
+
+    size_t i = 0;
+    for(uint64_t key : occupied_changes_)
+        voxelCenter(key, occupied.points[i++]);
+    i = 0;
+    for(uint64_t key : freed_changes_)
+        voxelCenter(key, freed.points[i++]);
+
+    occupied.width  = occupied.points.size();
+    occupied.height = 1;
+    freed.width     = freed.points.size();
+    freed.height    = 1;
+
+    occupied_changes_.clear();
+    freed_changes_.clear();
+}
+
+void OccupancyMapper::getOccupiedCells(pcl::PointCloud<pcl::PointXYZ> &occupied) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    occupied.clear();
+    pcl::PointXYZ pt;
+    for(const auto &voxel : voxels_)
+    {
+        if(voxel.second > log_odds_thres_)
+        {
+            voxelCenter(voxel.first, pt);
+            occupied.points.push_back(pt);
+        }
+    }
+    occupied.width  = occupied.points.size();
+    occupied.height = 1;
+}
+
+bool OccupancyMapper::getProjectedMap(nav_msgs::OccupancyGrid &grid) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if(columns_.empty())
+        return false;
+
+    int min_x = std::numeric_limits<int>::max(), min_y = std::numeric_limits<int>::max();
+    int max_x = std::numeric_limits<int>::min(), max_y = std::numeric_limits<int>::min();
+    int x, y, z;
+    for(const auto &column : columns_)
+    {
+        fromKey(column.first, x, y, z);
+        min_x = std::min(min_x, x);
+        min_y = std::min(min_y, y);
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+    }
+
+    grid.info.resolution        = params_.resolution;
+    grid.info.width             = max_x - min_x + 1;
+    grid.info.height            = max_y - min_y + 1;
+    grid.info.origin.position.x = min_x*params_.resolution;
+    grid.info.origin.position.y = min_y*params_.resolution;
+    grid.info.origin.position.z = 0.0;
+    grid.info.origin.orientation.x = 0.0;
+    grid.info.origin.orientation.y = 0.0;
+    grid.info.origin.orientation.z = 0.0;
+    grid.info.origin.orientation.w = 1.0;
+    grid.data.assign(grid.info.width*grid.info.height, -1);
+
+    for(const auto &column : columns_)
+    {
+        fromKey(column.first, x, y, z);
+        grid.data[(y - min_y)*grid.info.width + (x - min_x)] = column.second.occupied > 0 ? 100 : 0;
+    }
+    return true;
+}
+
+void OccupancyMapper::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    voxels_.clear();
+    columns_.clear();
+    occupied_changes_.clear();
+    freed_changes_.clear();
+}
+
+size_t OccupancyMapper::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return voxels_.size();
+}
+
+OccupancyMapper::~OccupancyMapper()
+{
+}
+
+} /* namespace tough_perception */
@@ -0,0 +1,196 @@
+/**
+ ********************************************************************************************************
+ * @file    OrganizedNormalEstimator.cpp
+ * @brief   OrganizedNormalEstimator class definition
+ * @details Integral image normal estimation with depth dependent smoothing
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/OrganizedNormalEstimator.h>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cstring>
+
+namespace tough_perception {
+
+OrganizedNormalEstimator::OrganizedNormalEstimator(const OrganizedNormalEstimatorParams &params):
+    params_(params), width_(0), height_(0)
+{
+}
+
+void OrganizedNormalEstimator::resize(int width, int height)
+{
+    if(width == width_ && height == height_)
+        return;
+
+    width_  = width;
+    height_ = height;
+    points_.resize(3*static_cast<size_t>(width_)*height_);
+    integral_.resize(static_cast<size_t>(width_ + 1)*(height_ + 1));
+    edges_.create(height_, width_, CV_8UC1);
+    edge_distance_.create(height_, width_, CV_32FC1);
+
+    // the first row and column of the integral image stay zero
+    std::memset(integral_.data(), 0, (width_ + 1)*sizeof(Moments));
+}
+
+void OrganizedNormalEstimator::computeEdgeDistance()
+{
+    const float factor = params_.max_depth_change_factor;
+    parallelFor(params_.num_threads, 0, height_, [&](int row_begin, int row_end)
+    {
+        for(int y = row_begin; y < row_end; ++y)
+        {
+            uint8_t *edge_row = edges_.ptr<uint8_t>(y);
+            for(int x = 0; x < width_; ++x)
+            {
+                const float z = points_[3*(static_cast<size_t>(y)*width_ + x) + 2];
+                bool edge = std::isnan(z);
+                const int nx[4] = {x - 1, x + 1, x, x};
+                const int ny[4] = {y, y, y - 1, y + 1};
+                for(int k = 0; k < 4 && !edge; ++k)
+                {
+                    if(nx[k] < 0 || nx[k] >= width_ || ny[k] < 0 || ny[k] >= height_)
+                        continue;
+                    const float nz = points_[3*(static_cast<size_t>(ny[k])*width_ + nx[k]) + 2];
+                    edge = !std::isnan(nz) && std::fabs(nz - z) > factor*z;
+                }
+                edge_row[x] = edge ? 0 : 255;
+            }
+        }
+    });
+
+    cv::distanceTransform(edges_, edge_distance_, CV_DIST_L2, 3);
+}
+
+/**
+ * @note invalid pixels add nothing to the sums so a window only averages the valid points it covers.
+ *       The coordinates are summed in double, in float the covariance of far windows loses all precision.
+ */
+void OrganizedNormalEstimator::computeIntegralImage()
+{
+    const size_t stride = width_ + 1;
+    parallelFor(params_.num_threads, 0, height_, [&](int row_begin, int row_end)
+    {
+        for(int y = row_begin; y < row_end; ++y)
+        {
+            Moments sum;
+            std::memset(&sum, 0, sizeof(Moments));
+            Moments *row = &integral_[(y + 1)*stride];
+            row[0] = sum;
+            const float *pt = &points_[3*static_cast<size_t>(y)*width_];
+            for(int x = 0; x < width_; ++x, pt += 3)
+            {
+                if(!std::isnan(pt[2]))
+                {
+                    const double px = pt[0], py = pt[1], pz = pt[2];
+                    sum.n  += 1.0;
+                    sum.x  += px;    sum.y  += py;    sum.z  += pz;
+                    sum.xx += px*px; sum.xy += px*py; sum.xz += px*pz;
+                    sum.yy += py*py; sum.yz += py*pz; sum.zz += pz*pz;
+                }
+                row[x + 1] = sum;
+            }
+        }
+    });
+
+    // columns are independent once the rows are summed
+    parallelFor(params_.num_threads, 1, static_cast<int>(stride), [&](int col_begin, int col_end)
+    {
+        for(int y = 2; y <= height_; ++y)
+        {
+            const Moments *above = &integral_[(y - 1)*stride];
+            Moments *row = &integral_[y*stride];
+            for(int x = col_begin; x < col_end; ++x)
+            {
+                row[x].n  += above[x].n;
+                row[x].x  += above[x].x;  row[x].y  += above[x].y;  row[x].z  += above[x].z;
+                row[x].xx += above[x].xx; row[x].xy += above[x].xy; row[x].xz += above[x].xz;
+                row[x].yy += above[x].yy; row[x].yz += above[x].yz; row[x].zz += above[x].zz;
+            }
+        }
+    });
+}
+
+void OrganizedNormalEstimator::computeNormals(int row_begin, int row_end, pcl::PointCloud<pcl::Normal> &normals) const
+{
+    const float nan    = std::numeric_limits<float>::quiet_NaN();
+    const size_t stride = width_ + 1;
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+
+    for(int y = row_begin; y < row_end; ++y)
+    {
+        const float *distance_row = edge_distance_.ptr<float>(y);
+        for(int x = 0; x < width_; ++x)
+        {
+            const size_t index = static_cast<size_t>(y)*width_ + x;
+            const float *pt = &points_[3*index];
+            pcl::Normal &normal = normals.points[index];
+            normal.normal_x = normal.normal_y = normal.normal_z = normal.curvature = nan;
+            if(std::isnan(pt[2]))
+                continue;
+
+            // the window grows with depth as the stereo noise does, but stays on this side of edges.
+            // Points on an edge have no window that does not straddle it.
+            float size = params_.smoothing_size + params_.depth_smoothing_factor*pt[2];
+            size = std::min(size, std::min(params_.max_smoothing_size, distance_row[x]));
+            if(size < 1.0f)
+                continue;
+            const int half = static_cast<int>(size);
+
+            const int x0 = std::max(0, x - half), x1 = std::min(width_, x + half + 1);
+            const int y0 = std::max(0, y - half), y1 = std::min(height_, y + half + 1);
+            const Moments &a = integral_[y0*stride + x0];
+            const Moments &b = integral_[y0*stride + x1];
+            const Moments &c = integral_[y1*stride + x0];
+            const Moments &d = integral_[y1*stride + x1];
+            const double n = d.n - b.n - c.n + a.n;
+            if(n < params_.min_points)
+                continue;
+
+            const Eigen::Vector3d centroid = Eigen::Vector3d(d.x - b.x - c.x + a.x, d.y - b.y - c.y + a.y,
+                                                             d.z - b.z - c.z + a.z)/n;
+            Eigen::Matrix3d covariance;
+            covariance(0, 0) = d.xx - b.xx - c.xx + a.xx;
+            covariance(0, 1) = d.xy - b.xy - c.xy + a.xy;
+            covariance(0, 2) = d.xz - b.xz - c.xz + a.xz;
+            covariance(1, 1) = d.yy - b.yy - c.yy + a.yy;
+            covariance(1, 2) = d.yz - b.yz - c.yz + a.yz;
+            covariance(2, 2) = d.zz - b.zz - c.zz + a.zz;
+            covariance(1, 0) = covariance(0, 1);
+            covariance(2, 0) = covariance(0, 2);
+            covariance(2, 1) = covariance(1, 2);
+            covariance = covariance/n - centroid*centroid.transpose();
+
+            solver.computeDirect(covariance);
+            Eigen::Vector3d direction = solver.eigenvectors().col(0);
+            // flip towards the sensor at the origin of the cloud frame
+            if(direction.dot(Eigen::Vector3d(pt[0], pt[1], pt[2])) > 0.0)
+                direction = -direction;
+
+            const double variation = solver.eigenvalues().sum();
+            normal.normal_x  = direction.x();
+            normal.normal_y  = direction.y();
+            normal.normal_z  = direction.z();
+            normal.curvature = variation > 0.0 ? solver.eigenvalues()(0)/variation : 0.0;
+        }
+    }
+}
+
+void OrganizedNormalEstimator::computeNormals(pcl::PointCloud<pcl::Normal> &normals)
+{
+    normals.points.resize(static_cast<size_t>(width_)*height_);
+    normals.width    = width_;
+    normals.height   = height_;
+    normals.is_dense = false;
+
+    computeEdgeDistance();
+    computeIntegralImage();
+    parallelFor(params_.num_threads, 0, height_, [&](int row_begin, int row_end){ computeNormals(row_begin, row_end, normals); });
+}
+
+OrganizedNormalEstimator::~OrganizedNormalEstimator()
+{
+}
+
+} /* namespace tough_perception */
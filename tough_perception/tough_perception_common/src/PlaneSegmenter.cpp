@@ -0,0 +1,393 @@
+/**
+ ********************************************************************************************************
+ * @file    PlaneSegmenter.cpp
+ * @brief   PlaneSegmenter class definition
+ * @details Sequential plane extraction with parallel RANSAC, patch splitting and convex outlines
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/PlaneSegmenter.h>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+namespace tough_perception {
+
+namespace {
+
+uint64_t cellKey(int u, int v)
+{
+    return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v);
+}
+
+// any two unit vectors orthogonal to the normal
+void planeBasis(const Eigen::Vector3f &normal, Eigen::Vector3f &u, Eigen::Vector3f &v)
+{
+    u = std::fabs(normal.z()) < 0.9f ? normal.cross(Eigen::Vector3f::UnitZ()) : normal.cross(Eigen::Vector3f::UnitX());
+    u.normalize();
+    v = normal.cross(u);
+}
+
+}
+
+PlaneSegmenter::PlaneSegmenter(const PlaneSegmenterParams &params):
+    params_(params), seed_(0)
+{
+    cos_normal_threshold_ = std::cos(params_.normal_threshold);
+}
+
+bool PlaneSegmenter::isInlier(const pcl::PointXYZ &pt, const pcl::Normal &pt_normal, const Eigen::Vector3f &normal, float d) const
+{
+    if(std::fabs(normal.dot(pt.getVector3fMap()) + d) > params_.distance_threshold)
+        return false;
+    // normals of unorganized clouds are not oriented, only the direction is compared
+    return std::fabs(normal.dot(pt_normal.getNormalVector3fMap())) > cos_normal_threshold_;
+}
+
+size_t PlaneSegmenter::findBestPlane(const pcl::PointCloud<pcl::PointXYZ> &cloud, const pcl::PointCloud<pcl::Normal> &normals,
+                                     const std::vector<int> &candidates, Eigen::Vector3f &normal, float &d)
+{
+    int num_threads = params_.num_threads > 0 ? params_.num_threads : std::thread::hardware_concurrency();
+    num_threads = std::max(1, num_threads);
+
+    std::mutex best_mutex;
+    size_t best_inliers = 0;
+    std::atomic<int> iterations(0);
+    std::atomic<int> required_iterations(params_.max_iterations);
+    const double log_probability = std::log(1.0 - params_.probability);
+
+    auto worker = [&](uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+
+        while(iterations++ < required_iterations)
+        {
+            const int i0 = candidates[pick(rng)];
+            const int i1 = candidates[pick(rng)];
+            const int i2 = candidates[pick(rng)];
+            const Eigen::Vector3f a = cloud.points[i0].getVector3fMap();
+            Eigen::Vector3f n = (cloud.points[i1].getVector3fMap() - a).cross(cloud.points[i2].getVector3fMap() - a);
+            const float norm = n.norm();
+            if(norm < 1e-6f)
+                continue;
+            n /= norm;
+            const float hypothesis_d = -n.dot(a);
+
+            // the sample points must agree with the plane before it is scored
+            if(std::fabs(n.dot(normals.points[i0].getNormalVector3fMap())) < cos_normal_threshold_ ||
+               std::fabs(n.dot(normals.points[i1].getNormalVector3fMap())) < cos_normal_threshold_ ||
+               std::fabs(n.dot(normals.points[i2].getNormalVector3fMap())) < cos_normal_threshold_)
+                continue;
+
+            size_t bound;
+            {
+                std::lock_guard<std::mutex> lock(best_mutex);
+                bound = best_inliers;
+            }
+
+            size_t count = 0;
+            const size_t total = candidates.size();
+            for(size_t i = 0; i < total; ++i)
+            {
+                if(isInlier(cloud.points[candidates[i]], normals.points[candidates[i]], n, hypothesis_d))
+                    ++count;
+                // stop scoring when even the remaining points would not beat the best plane
+                if(count + (total - i - 1) <= bound)
+                    break;
+            }
+
+            std::lock_guard<std::mutex> lock(best_mutex);
+            if(count <= best_inliers)
+                continue;
+            best_inliers = count;
+            normal       = n;
+            d            = hypothesis_d;
+
+            const double inlier_ratio = static_cast<double>(count)/total;
+            const double no_outlier   = 1.0 - inlier_ratio*inlier_ratio*inlier_ratio;
+            if(no_outlier <= 0.0)
+            {
+                required_iterations = 0;
+            }
+            else if(no_outlier < 1.0)
+            {
+                const double needed = std::ceil(log_probability/std::log(no_outlier));
+                if(needed < required_iterations)
+                    required_iterations = static_cast<int>(needed);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(num_threads);
+    for(int t = 0; t < num_threads; ++t)
+    {
+        workers.emplace_back(worker, seed_++);
+    }
+    for(auto &thread : workers)
+    {
+        thread.join();
+    }
+    return best_inliers;
+}
+
+bool PlaneSegmenter::fitPlane(const pcl::PointCloud<pcl::PointXYZ> &cloud, const std::vector<int> &indices,
+                              Eigen::Vector3f &normal, float &d, Eigen::Vector3f &centroid)
+{
+    if(indices.size() < 3)
+        return false;
+
+    Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+    for(int i : indices)
+        mean += cloud.points[i].getVector3fMap().cast<double>();
+    mean /= indices.size();
+
+    Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+    for(int i : indices)
+    {
+        const Eigen::Vector3d p = cloud.points[i].getVector3fMap().cast<double>() - mean;
+        covariance += p*p.transpose();
+    }
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+    solver.computeDirect(covariance);
+    if(solver.eigenvalues()(1) <= 0.0)
+        return false;
+
+    normal   = solver.eigenvectors().col(0).cast<float>();
+    centroid = mean.cast<float>();
+    d        = -normal.dot(centroid);
+    return true;
+}
+
+/**
+ * @note the inliers are binned in a grid on the plane with cells of cluster_tolerance and the occupied
+ *       cells are flood filled over their 8 neighbours
+ */
+void PlaneSegmenter::splitPatches(const pcl::PointCloud<pcl::PointXYZ> &cloud, const std::vector<int> &inliers,
+                                  const Eigen::Vector3f &normal, std::vector<std::vector<int>> &patches) const
+{
+    Eigen::Vector3f u, v;
+    planeBasis(normal, u, v);
+
+    std::unordered_map<uint64_t, std::vector<int>> cells;
+    for(int i : inliers)
+    {
+        const Eigen::Vector3f p = cloud.points[i].getVector3fMap();
+        const int cu = static_cast<int>(std::floor(u.dot(p)/params_.cluster_tolerance));
+        const int cv = static_cast<int>(std::floor(v.dot(p)/params_.cluster_tolerance));
+        cells[cellKey(cu, cv)].push_back(i);
+    }
+
+    std::unordered_map<uint64_t, bool> visited;
+    std::vector<std::pair<int, int>> stack;
+    for(const auto &cell : cells)
+    {
+        if(visited[cell.first])
+            continue;
+
+        patches.emplace_back();
+        std::vector<int> &patch = patches.back();
+        stack.emplace_back(static_cast<int>(cell.first >> 32), static_cast<int>(cell.first & 0xFFFFFFFF));
+        visited[cell.first] = true;
+        while(!stack.empty())
+        {
+            const std::pair<int, int> current = stack.back();
+            stack.pop_back();
+            const std::vector<int> &points = cells.find(cellKey(current.first, current.second))->second;
+            patch.insert(patch.end(), points.begin(), points.end());
+
+            for(int du = -1; du <= 1; ++du)
+            {
+                for(int dv = -1; dv <= 1; ++dv)
+                {
+                    const uint64_t key = cellKey(current.first + du, current.second + dv);
+                    if(cells.count(key) == 0 || visited[key])
+                        continue;
+                    visited[key] = true;
+                    stack.emplace_back(current.first + du, current.second + dv);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @note Andrew's monotone chain on the inliers projected on the plane
+ */
+void PlaneSegmenter::computeHull(const pcl::PointCloud<pcl::PointXYZ> &cloud, PlanarPatch &patch)
+{
+    Eigen::Vector3f u, v;
+    planeBasis(patch.normal, u, v);
+
+    std::vector<Eigen::Vector2f> points;
+    points.reserve(patch.inliers.size());
+    for(int i : patch.inliers)
+    {
+        const Eigen::Vector3f p = cloud.points[i].getVector3fMap() - patch.centroid;
+        points.push_back(Eigen::Vector2f(u.dot(p), v.dot(p)));
+    }
+    std::sort(points.begin(), points.end(), [](const Eigen::Vector2f &a, const Eigen::Vector2f &b)
+    {
+        return a.x() < b.x() || (a.x() == b.x() && a.y() < b.y());
+    });
+
+    auto cross = [](const Eigen::Vector2f &o, const Eigen::Vector2f &a, const Eigen::Vector2f &b)
+    {
+        return (a.x() - o.x())*(b.y() - o.y()) - (a.y() - o.y())*(b.x() - o.x());
+    };
+
+    std::vector<Eigen::Vector2f> hull(2*points.size());
+    size_t k = 0;
+    for(size_t i = 0; i < points.size(); ++i)
+    {
+        while(k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0.0f)
+            --k;
+        hull[k++] = points[i];
+    }
+    for(size_t i = points.size() - 1, lower = k + 1; i > 0; --i)
+    {
+        while(k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0.0f)
+            --k;
+        hull[k++] = points[i - 1];
+    }
+    hull.resize(k > 0 ? k - 1 : 0);
+
+    patch.area = 0.0f;
+    patch.hull.clear();
+    patch.hull.reserve(hull.size());
+    for(size_t i = 0; i < hull.size(); ++i)
+    {
+        const Eigen::Vector2f &a = hull[i];
+        const Eigen::Vector2f &b = hull[(i + 1) % hull.size()];
+        patch.area += 0.5f*(a.x()*b.y() - b.x()*a.y());
+        patch.hull.push_back(patch.centroid + a.x()*u + a.y()*v);
+    }
+}
+
+bool PlaneSegmenter::makePatch(const pcl::PointCloud<pcl::PointXYZ> &cloud, std::vector<int> &indices, PlanarPatch &patch) const
+{
+    if(static_cast<int>(indices.size()) < params_.min_inliers)
+        return false;
+    if(!fitPlane(cloud, indices, patch.normal, patch.d, patch.centroid))
+        return false;
+
+    const float vertical = std::fabs(patch.normal.z());
+    if(vertical > std::cos(params_.orientation_tolerance))
+    {
+        patch.type = PlanarPatch::HORIZONTAL;
+        if(patch.normal.z() < 0.0f)
+        {
+            patch.normal = -patch.normal;
+            patch.d      = -patch.d;
+        }
+    }
+    else if(vertical < std::sin(params_.orientation_tolerance))
+    {
+        patch.type = PlanarPatch::VERTICAL;
+    }
+    else if(params_.keep_slanted)
+    {
+        patch.type = PlanarPatch::SLANTED;
+    }
+    else
+    {
+        return false;
+    }
+
+    patch.inliers.swap(indices);
+    computeHull(cloud, patch);
+    return true;
+}
+
+/**
+ * @note the best plane of the remaining points is refit by least squares before its inliers are taken,
+ *       the inliers of a plane are removed even when none of its patches is large enough so that the
+ *       next search does not find it again
+ */
+void PlaneSegmenter::segment(const pcl::PointCloud<pcl::PointXYZ> &cloud, const pcl::PointCloud<pcl::Normal> &normals,
+                             std::vector<PlanarPatch> &patches)
+{
+    patches.clear();
+    if(cloud.size() != normals.size())
+    {
+        ROS_ERROR("PlaneSegmenter: %lu points but %lu normals", cloud.size(), normals.size());
+        return;
+    }
+
+    std::vector<int> remaining;
+    remaining.reserve(cloud.size());
+    for(size_t i = 0; i < cloud.size(); ++i)
+    {
+        if(pcl::isFinite(cloud.points[i]) && std::isfinite(normals.points[i].normal_z))
+            remaining.push_back(i);
+    }
+
+    seed_ = 0;
+    std::vector<int> inliers, outliers;
+    std::vector<std::vector<int>> split;
+    while(static_cast<int>(patches.size()) < params_.max_planes &&
+          static_cast<int>(remaining.size()) >= params_.min_inliers)
+    {
+        Eigen::Vector3f normal, centroid;
+        float d;
+        if(findBestPlane(cloud, normals, remaining, normal, d) < static_cast<size_t>(params_.min_inliers))
+            break;
+
+        inliers.clear();
+        for(int i : remaining)
+        {
+            if(isInlier(cloud.points[i], normals.points[i], normal, d))
+                inliers.push_back(i);
+        }
+        if(fitPlane(cloud, inliers, normal, d, centroid))
+        {
+            inliers.clear();
+            outliers.clear();
+            for(int i : remaining)
+            {
+                if(isInlier(cloud.points[i], normals.points[i], normal, d))
+                    inliers.push_back(i);
+                else
+                    outliers.push_back(i);
+            }
+            remaining.swap(outliers);
+        }
+        else
+        {
+            std::sort(inliers.begin(), inliers.end());
+            remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](int i)
+            {
+                return std::binary_search(inliers.begin(), inliers.end(), i);
+            }), remaining.end());
+        }
+
+        split.clear();
+        splitPatches(cloud, inliers, normal, split);
+        for(auto &indices : split)
+        {
+            PlanarPatch patch;
+            if(makePatch(cloud, indices, patch))
+                patches.push_back(std::move(patch));
+            if(static_cast<int>(patches.size()) >= params_.max_planes)
+                break;
+        }
+    }
+
+    std::sort(patches.begin(), patches.end(), [](const PlanarPatch &a, const PlanarPatch &b)
+    {
+        return a.inliers.size() > b.inliers.size();
+    });
+}
+
+PlaneSegmenter::~PlaneSegmenter()
+{
+}
+
+} /* namespace tough_perception */
@@ -9,6 +9,7 @@
 #include <tough_perception_common/MultisenseImage.h>
 #include <tough_perception_common/MultisensePointCloud.h>
 #include <tough_perception_common/PointCloudHelper.h>
+#include <limits>
 
 //BW: This typedef is specific to an application and should not be here
 typedef pcl::PointXYZRGB ARPoint;
@@ -54,13 +55,21 @@ void PointCloudHelper::generateOrganizedRGBDCloud( const cv::Mat &dispImage,
 	cloud->resize(width*height);
 	cloud->height=height;
 	cloud->width=width;
+	cloud->is_dense=false;
+
+	// pixels without disparity are NaN so that organized algorithms can skip them
+	tough_perception::StereoPointColor invalid;
+	invalid.x=invalid.y=invalid.z=std::numeric_limits<float>::quiet_NaN();
 
 	cv::reprojectImageTo3D(dispImage, xyz, Qmat, false);
 	for(int u=0;u<dispImage.rows;u++)
 		for(int v=0;v<dispImage.cols;v++)
 		{
 			if(dispImage.at<float>(cv::Point(v,u))==0.0)
+			{
+				cloud->at(v,u)=invalid;
 				continue;
+			}
 			cv::Vec3f cv_pt=xyz.at<cv::Vec3f>(cv::Point(v,u));
             tough_perception::StereoPointColor pt;
 			pt.x=cv_pt.val[0];
@@ -0,0 +1,133 @@
+/**
+ ********************************************************************************************************
+ * @file    ScanAccumulator.cpp
+ * @brief   ScanAccumulator class definition
+ * @details Ring of scans in the fixed frame assembled by concatenation
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/ScanAccumulator.h>
+#include <pcl_ros/transforms.h>
+#include <algorithm>
+#include <cstring>
+
+namespace tough_perception {
+
+ScanAccumulator::ScanAccumulator(ros::NodeHandle &nh, const std::string &cloud_topic, const std::string &fixed_frame, size_t max_clouds):
+    fixed_frame_(fixed_frame), max_clouds_(std::max<size_t>(1, max_clouds))
+{
+    cloud_sub_ = nh.subscribe(cloud_topic, 100, &ScanAccumulator::cloudCallback, this);
+}
+
+/**
+ * @note scans are transformed once when they arrive so that assembling only copies their data
+ */
+void ScanAccumulator::cloudCallback(const sensor_msgs::PointCloud2ConstPtr &msg)
+{
+    sensor_msgs::PointCloud2ConstPtr scan = msg;
+    if(msg->header.frame_id != fixed_frame_)
+    {
+        sensor_msgs::PointCloud2::Ptr transformed(new sensor_msgs::PointCloud2);
+        listener_.waitForTransform(fixed_frame_, msg->header.frame_id, msg->header.stamp, ros::Duration(0.1));
+        if(!pcl_ros::transformPointCloud(fixed_frame_, *msg, *transformed, listener_))
+        {
+            ROS_WARN_THROTTLE(1.0, "ScanAccumulator::cloudCallback : dropping scan in %s", msg->header.frame_id.c_str());
+            return;
+        }
+        scan = transformed;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // scans arrive in order, a scan from the past is inserted in place to keep the ring sorted
+    auto it = scans_.end();
+    while(it != scans_.begin() && (*(it - 1))->header.stamp > scan->header.stamp)
+        --it;
+    scans_.insert(it, scan);
+    while(scans_.size() > max_clouds_)
+        scans_.pop_front();
+}
+
+size_t ScanAccumulator::assemble(const ros::Time &begin, const ros::Time &end, sensor_msgs::PointCloud2 &cloud) const
+{
+    std::vector<sensor_msgs::PointCloud2ConstPtr> window;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto first = std::lower_bound(scans_.begin(), scans_.end(), begin,
+                                      [](const sensor_msgs::PointCloud2ConstPtr &scan, const ros::Time &stamp)
+                                      { return scan->header.stamp < stamp; });
+        // half open so that a scan stamped at the end of a window is only assembled by the next one
+        for(auto it = first; it != scans_.end() && (*it)->header.stamp < end; ++it)
+            window.push_back(*it);
+    }
+
+    cloud.header.frame_id = fixed_frame_;
+    cloud.header.stamp    = end;
+    cloud.height          = 1;
+    cloud.width           = 0;
+    cloud.is_bigendian    = false;
+    cloud.is_dense        = false;
+    cloud.data.clear();
+    if(window.empty())
+        return 0;
+
+    const sensor_msgs::PointCloud2 &layout = *window.front();
+    cloud.fields       = layout.fields;
+    cloud.point_step   = layout.point_step;
+    cloud.is_bigendian = layout.is_bigendian;
+
+    auto compatible = [&layout](const sensor_msgs::PointCloud2 &scan)
+    {
+        if(scan.point_step != layout.point_step || scan.fields.size() != layout.fields.size())
+            return false;
+        for(size_t i = 0; i < scan.fields.size(); ++i)
+        {
+            if(scan.fields[i].name != layout.fields[i].name || scan.fields[i].offset != layout.fields[i].offset ||
+               scan.fields[i].datatype != layout.fields[i].datatype)
+                return false;
+        }
+        return true;
+    };
+
+    size_t num_points = 0;
+    for(const auto &scan : window)
+    {
+        if(compatible(*scan))
+            num_points += scan->width*scan->height;
+    }
+
+    // a single allocation, every scan is copied row by row into it
+    cloud.data.resize(num_points*cloud.point_step);
+    uint8_t *out = cloud.data.data();
+    size_t assembled = 0;
+    for(const auto &scan : window)
+    {
+        if(!compatible(*scan))
+        {
+            ROS_WARN_THROTTLE(1.0, "ScanAccumulator::assemble : skipping a scan with different fields");
+            continue;
+        }
+        const size_t row_bytes = scan->width*scan->point_step;
+        for(uint32_t row = 0; row < scan->height; ++row)
+        {
+            std::memcpy(out, &scan->data[row*scan->row_step], row_bytes);
+            out += row_bytes;
+        }
+        ++assembled;
+    }
+
+    cloud.width    = num_points;
+    cloud.row_step = cloud.width*cloud.point_step;
+    return assembled;
+}
+
+void ScanAccumulator::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    scans_.clear();
+}
+
+ScanAccumulator::~ScanAccumulator()
+{
+}
+
+} /* namespace tough_perception */
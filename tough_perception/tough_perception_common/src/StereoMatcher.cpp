@@ -0,0 +1,332 @@
+/**
+ ********************************************************************************************************
+ * @file    StereoMatcher.cpp
+ * @brief   StereoMatcher class definition
+ * @details Census transform + semi global matching along 4 paths with sub pixel refinement
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/StereoMatcher.h>
+#include <tough_common/parallel_for.h>
+#include <algorithm>
+#include <limits>
+
+namespace tough_perception {
+
+namespace {
+
+// census window is 7 pixels wide and 5 pixels high, the center is not compared
+const int CENSUS_HALF_WIDTH  = 3;
+const int CENSUS_HALF_HEIGHT = 2;
+const int MAX_CENSUS_COST    = (2*CENSUS_HALF_WIDTH+1)*(2*CENSUS_HALF_HEIGHT+1) - 1;
+const int NUM_PATHS          = 4;
+
+/**
+ * @note one step of the semi global aggregation along a path
+ *       L(p,d) = C(p,d) + min(L(p-r,d), L(p-r,d-1)+P1, L(p-r,d+1)+P1, min_k L(p-r,k)+P2) - min_k L(p-r,k)
+ *       returns min_d L(p,d)
+ */
+inline uint16_t aggregateStep(const uint8_t *cost, const uint16_t *prev, uint16_t prev_min,
+                              int disparities, int p1, int p2, uint16_t *cur)
+{
+    uint16_t cur_min = std::numeric_limits<uint16_t>::max();
+    const uint32_t jump = prev_min + p2;
+    for(int d = 0; d < disparities; ++d)
+    {
+        uint32_t best = prev[d];
+        if(d > 0)
+            best = std::min<uint32_t>(best, prev[d-1] + p1);
+        if(d < disparities - 1)
+            best = std::min<uint32_t>(best, prev[d+1] + p1);
+        best = std::min(best, jump);
+        cur[d] = static_cast<uint16_t>(cost[d] + best - prev_min);
+        cur_min = std::min(cur_min, cur[d]);
+    }
+    return cur_min;
+}
+
+inline uint16_t initStep(const uint8_t *cost, int disparities, uint16_t *cur)
+{
+    uint16_t cur_min = std::numeric_limits<uint16_t>::max();
+    for(int d = 0; d < disparities; ++d)
+    {
+        cur[d] = cost[d];
+        cur_min = std::min(cur_min, cur[d]);
+    }
+    return cur_min;
+}
+
+}
+
+StereoMatcher::StereoMatcher(const StereoMatcherParams &params):
+    params_(params), width_(0), height_(0), min_disparity_(0), disparities_(0)
+{
+}
+
+void StereoMatcher::setParams(const StereoMatcherParams &params)
+{
+    params_ = params;
+}
+
+void StereoMatcher::censusTransform(const cv::Mat &img, std::vector<uint64_t> &census) const
+{
+    std::fill(census.begin(), census.end(), 0);
+    parallelFor(params_.num_threads, CENSUS_HALF_HEIGHT, height_ - CENSUS_HALF_HEIGHT, [&](int row_begin, int row_end)
+    {
+        for(int y = row_begin; y < row_end; ++y)
+        {
+            const uint8_t *center_row = img.ptr<uint8_t>(y);
+            for(int x = CENSUS_HALF_WIDTH; x < width_ - CENSUS_HALF_WIDTH; ++x)
+            {
+                const uint8_t center = center_row[x];
+                uint64_t signature = 0;
+                for(int dy = -CENSUS_HALF_HEIGHT; dy <= CENSUS_HALF_HEIGHT; ++dy)
+                {
+                    const uint8_t *row = img.ptr<uint8_t>(y + dy);
+                    for(int dx = -CENSUS_HALF_WIDTH; dx <= CENSUS_HALF_WIDTH; ++dx)
+                    {
+                        if(dx == 0 && dy == 0)
+                            continue;
+                        signature = (signature << 1) | (row[x + dx] < center ? 1 : 0);
+                    }
+                }
+                census[y*width_ + x] = signature;
+            }
+        }
+    });
+}
+
+void StereoMatcher::computePixelCost(int row_begin, int row_end)
+{
+    for(int y = row_begin; y < row_end; ++y)
+    {
+        const uint64_t *left  = &census_left_[y*width_];
+        const uint64_t *right = &census_right_[y*width_];
+        for(int x = 0; x < width_; ++x)
+        {
+            uint8_t *cost = &pixel_cost_[(static_cast<size_t>(y)*width_ + x)*disparities_];
+            for(int d = 0; d < disparities_; ++d)
+            {
+                int xr = x - min_disparity_ - d;
+                cost[d] = (xr >= 0 && xr < width_) ? __builtin_popcountll(left[x] ^ right[xr]) : MAX_CENSUS_COST;
+            }
+        }
+    }
+}
+
+void StereoMatcher::aggregateHorizontal(int row_begin, int row_end)
+{
+    std::vector<uint16_t> prev(disparities_), cur(disparities_);
+    for(int y = row_begin; y < row_end; ++y)
+    {
+        const size_t row_offset = static_cast<size_t>(y)*width_;
+
+        // left to right, initializes the aggregated cost
+        uint16_t prev_min = 0;
+        for(int x = 0; x < width_; ++x)
+        {
+            const size_t idx = (row_offset + x)*disparities_;
+            prev_min = (x == 0) ? initStep(&pixel_cost_[idx], disparities_, cur.data())
+                                : aggregateStep(&pixel_cost_[idx], prev.data(), prev_min, disparities_, params_.p1, params_.p2, cur.data());
+            std::copy(cur.begin(), cur.end(), &aggregated_cost_[idx]);
+            prev.swap(cur);
+        }
+
+        // right to left
+        for(int x = width_ - 1; x >= 0; --x)
+        {
+            const size_t idx = (row_offset + x)*disparities_;
+            prev_min = (x == width_ - 1) ? initStep(&pixel_cost_[idx], disparities_, cur.data())
+                                         : aggregateStep(&pixel_cost_[idx], prev.data(), prev_min, disparities_, params_.p1, params_.p2, cur.data());
+            uint16_t *agg = &aggregated_cost_[idx];
+            for(int d = 0; d < disparities_; ++d)
+                agg[d] += cur[d];
+            prev.swap(cur);
+        }
+    }
+}
+
+void StereoMatcher::aggregateVertical(int col_begin, int col_end)
+{
+    const int cols = col_end - col_begin;
+    std::vector<uint16_t> prev(cols*disparities_), cur(cols*disparities_);
+    std::vector<uint16_t> prev_min(cols);
+
+    // the rows are walked in the outer loop so that the memory is accessed contiguously
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        const bool top_down = (pass == 0);
+        for(int i = 0; i < height_; ++i)
+        {
+            const int y = top_down ? i : height_ - 1 - i;
+            for(int c = 0; c < cols; ++c)
+            {
+                const size_t idx = (static_cast<size_t>(y)*width_ + col_begin + c)*disparities_;
+                uint16_t *cur_col = &cur[c*disparities_];
+                prev_min[c] = (i == 0) ? initStep(&pixel_cost_[idx], disparities_, cur_col)
+                                       : aggregateStep(&pixel_cost_[idx], &prev[c*disparities_], prev_min[c],
+                                                       disparities_, params_.p1, params_.p2, cur_col);
+                uint16_t *agg = &aggregated_cost_[idx];
+                for(int d = 0; d < disparities_; ++d)
+                    agg[d] += cur_col[d];
+            }
+            prev.swap(cur);
+        }
+    }
+}
+
+void StereoMatcher::selectDisparity(int row_begin, int row_end, cv::Mat &disparity, cv::Mat &cost) const
+{
+    const float max_cost = NUM_PATHS*(MAX_CENSUS_COST + params_.p2);
+    for(int y = row_begin; y < row_end; ++y)
+    {
+        float   *disp_row = disparity.ptr<float>(y);
+        uint8_t *cost_row = cost.ptr<uint8_t>(y);
+        for(int x = 0; x < width_; ++x)
+        {
+            disp_row[x] = 0.0f;
+            cost_row[x] = 255;
+            if(y < CENSUS_HALF_HEIGHT || y >= height_ - CENSUS_HALF_HEIGHT ||
+               x < CENSUS_HALF_WIDTH  || x >= width_ - CENSUS_HALF_WIDTH)
+                continue;
+
+            const uint16_t *agg = &aggregated_cost_[(static_cast<size_t>(y)*width_ + x)*disparities_];
+            const int best = std::min_element(agg, agg + disparities_) - agg;
+            const int best_cost = agg[best];
+
+            // reject the match if another disparity, not adjacent to the best, is almost as good
+            bool unique = true;
+            for(int d = 0; d < disparities_ && unique; ++d)
+            {
+                if(std::abs(d - best) > 1 && agg[d]*(100 - params_.uniqueness_ratio) < best_cost*100)
+                    unique = false;
+            }
+            if(!unique)
+                continue;
+
+            // fit a parabola through the neighbours of the best disparity
+            float delta = 0.0f;
+            if(best > 0 && best < disparities_ - 1)
+            {
+                const float denom = agg[best-1] + agg[best+1] - 2.0f*best_cost;
+                if(denom > 0.0f)
+                    delta = (agg[best-1] - agg[best+1])/(2.0f*denom);
+            }
+
+            const float d = min_disparity_ + best + delta;
+            if(d <= 0.0f)
+                continue;
+            disp_row[x] = d;
+            cost_row[x] = static_cast<uint8_t>(std::min(254.0f, 255.0f*best_cost/max_cost));
+        }
+    }
+}
+
+bool StereoMatcher::compute(const cv::Mat &left, const cv::Mat &right, cv::Mat &disparity, cv::Mat &cost)
+{
+    if(left.empty() || right.empty() || left.size() != right.size())
+    {
+        ROS_ERROR("StereoMatcher: left and right images must be non empty and of the same size");
+        return false;
+    }
+
+    cv::Mat left_gray = left, right_gray = right;
+    if(left.channels() == 3)
+        cv::cvtColor(left, left_gray, CV_BGR2GRAY);
+    if(right.channels() == 3)
+        cv::cvtColor(right, right_gray, CV_BGR2GRAY);
+    if(left_gray.depth() != CV_8U)
+        left_gray.convertTo(left_gray, CV_8U);
+    if(right_gray.depth() != CV_8U)
+        right_gray.convertTo(right_gray, CV_8U);
+
+    const cv::Rect full(0, 0, left.cols, left.rows);
+    const cv::Rect roi = params_.roi.area() > 0 ? (params_.roi & full) : full;
+    const int scale = std::max(1, params_.downscale);
+    if(roi.area() == 0 || params_.num_disparities < scale)
+    {
+        ROS_ERROR("StereoMatcher: empty region of interest or disparity range");
+        return false;
+    }
+
+    // the right pixels matching the left edge of the roi lie up to the max disparity further left
+    cv::Rect work = roi;
+    const int extension = std::min(roi.x, params_.min_disparity + params_.num_disparities);
+    work.x     -= extension;
+    work.width += extension;
+
+    cv::Mat left_work = left_gray(work), right_work = right_gray(work);
+    if(scale > 1)
+    {
+        cv::Size work_size(work.width/scale, work.height/scale);
+        cv::resize(left_gray(work), left_work, work_size, 0, 0, cv::INTER_AREA);
+        cv::resize(right_gray(work), right_work, work_size, 0, 0, cv::INTER_AREA);
+    }
+
+    width_         = left_work.cols;
+    height_        = left_work.rows;
+    min_disparity_ = params_.min_disparity/scale;
+    disparities_   = params_.num_disparities/scale;
+    if(width_ <= 2*CENSUS_HALF_WIDTH || height_ <= 2*CENSUS_HALF_HEIGHT)
+    {
+        ROS_ERROR("StereoMatcher: region of interest too small");
+        return false;
+    }
+
+    const size_t num_pixels = static_cast<size_t>(width_)*height_;
+    census_left_.resize(num_pixels);
+    census_right_.resize(num_pixels);
+    pixel_cost_.resize(num_pixels*disparities_);
+    aggregated_cost_.resize(num_pixels*disparities_);
+
+    censusTransform(left_work, census_left_);
+    censusTransform(right_work, census_right_);
+    parallelFor(params_.num_threads, 0, height_, [this](int b, int e){ computePixelCost(b, e); });
+    parallelFor(params_.num_threads, 0, height_, [this](int b, int e){ aggregateHorizontal(b, e); });
+    parallelFor(params_.num_threads, 0, width_,  [this](int b, int e){ aggregateVertical(b, e); });
+
+    cv::Mat work_disparity(height_, width_, CV_32F);
+    cv::Mat work_cost(height_, width_, CV_8U);
+    parallelFor(params_.num_threads, 0, height_, [&](int b, int e){ selectDisparity(b, e, work_disparity, work_cost); });
+
+    // scale the result back in to the roi of a full resolution image
+    disparity = cv::Mat::zeros(left.size(), CV_32F);
+    cost      = cv::Mat(left.size(), CV_8U, cv::Scalar(255));
+    for(int y = roi.y; y < roi.y + roi.height; ++y)
+    {
+        const int wy = std::min((y - work.y)/scale, height_ - 1);
+        const float   *work_disp_row = work_disparity.ptr<float>(wy);
+        const uint8_t *work_cost_row = work_cost.ptr<uint8_t>(wy);
+        float   *disp_row = disparity.ptr<float>(y);
+        uint8_t *cost_row = cost.ptr<uint8_t>(y);
+        for(int x = roi.x; x < roi.x + roi.width; ++x)
+        {
+            const int wx = std::min((x - work.x)/scale, width_ - 1);
+            disp_row[x] = work_disp_row[wx]*scale;
+            cost_row[x] = work_cost_row[wx];
+        }
+    }
+    return true;
+}
+
+void StereoMatcher::disparityToDepth(const cv::Mat &disparity, float focal_length, float baseline, cv::Mat &depth)
+{
+    depth = cv::Mat::zeros(disparity.size(), CV_32F);
+    const float fb = focal_length*baseline;
+    for(int y = 0; y < disparity.rows; ++y)
+    {
+        const float *disp_row  = disparity.ptr<float>(y);
+        float       *depth_row = depth.ptr<float>(y);
+        for(int x = 0; x < disparity.cols; ++x)
+        {
+            if(disp_row[x] > 0.0f)
+                depth_row[x] = fb/disp_row[x];
+        }
+    }
+}
+
+StereoMatcher::~StereoMatcher()
+{
+}
+
+} /* namespace tough_perception */
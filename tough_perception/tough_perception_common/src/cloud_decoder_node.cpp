@@ -0,0 +1,51 @@
+/**
+ ********************************************************************************************************
+ * @file    cloud_decoder_node.cpp
+ * @brief   decompresses a compressed point cloud topic
+ * @details subscribes to compressed_cloud and publishes the decoded cloud on cloud_out.
+ *          Remap the topics in the launch file.
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/CloudCompression.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <std_msgs/Empty.h>
+
+using namespace tough_perception;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "cloud_decoder");
+    ros::NodeHandle nh;
+
+    CloudDecoder decoder;
+    ros::Publisher cloud_pub = nh.advertise<sensor_msgs::PointCloud2>("cloud_out", 1, true);
+    ros::Publisher key_frame_pub = nh.advertise<std_msgs::Empty>("request_key_frame", 1);
+
+    // a key frame is requested once per gap, and again only if it has not come after a second
+    bool waiting_for_key_frame = false;
+    ros::Time requested;
+    ros::Subscriber compressed_sub = nh.subscribe<tough_perception_common::CompressedCloud>("compressed_cloud", 10,
+            [&](const tough_perception_common::CompressedCloudConstPtr &msg)
+            {
+                pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+                if(!decoder.decode(*msg, cloud))
+                {
+                    // ask the encoder for a key frame instead of waiting for the next one
+                    if(!waiting_for_key_frame || (ros::Time::now() - requested) > ros::Duration(1.0))
+                    {
+                        key_frame_pub.publish(std_msgs::Empty());
+                        waiting_for_key_frame = true;
+                        requested = ros::Time::now();
+                    }
+                    return;
+                }
+                waiting_for_key_frame = false;
+                sensor_msgs::PointCloud2 out;
+                pcl::toROSMsg(*cloud, out);
+                cloud_pub.publish(out);
+            });
+
+    ros::spin();
+    return 0;
+}
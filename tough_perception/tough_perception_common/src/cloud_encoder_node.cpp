@@ -0,0 +1,51 @@
+/**
+ ********************************************************************************************************
+ * @file    cloud_encoder_node.cpp
+ * @brief   compresses a point cloud topic
+ * @details subscribes to cloud_in and publishes the octree compressed cloud on compressed_cloud.
+ *          Remap the topics in the launch file.
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/CloudCompression.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <std_msgs/Empty.h>
+
+using namespace tough_perception;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "cloud_encoder");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    double point_resolution, octree_resolution;
+    int key_frame_rate;
+    pnh.param<double>("point_resolution", point_resolution, 0.005);
+    pnh.param<double>("octree_resolution", octree_resolution, 0.02);
+    pnh.param<int>("key_frame_rate", key_frame_rate, 10);
+
+    CloudEncoder encoder(point_resolution, octree_resolution, key_frame_rate);
+    ros::Publisher compressed_pub = nh.advertise<tough_perception_common::CompressedCloud>("compressed_cloud", 10, true);
+
+    // a subscriber connecting midway needs a key frame to start decoding
+    ros::Subscriber cloud_sub = nh.subscribe<sensor_msgs::PointCloud2>("cloud_in", 1,
+            [&](const sensor_msgs::PointCloud2ConstPtr &msg)
+            {
+                pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+                pcl::fromROSMsg(*msg, *cloud);
+                if(cloud->empty())
+                    return;
+
+                tough_perception_common::CompressedCloud compressed;
+                encoder.encode(cloud, compressed);
+                compressed_pub.publish(compressed);
+                ROS_INFO_ONCE("Compressing %s, %lu bytes to %lu bytes", msg->header.frame_id.c_str(),
+                              msg->data.size(), compressed.data.size());
+            });
+    ros::Subscriber key_frame_sub = nh.subscribe<std_msgs::Empty>("request_key_frame", 1,
+            [&](const std_msgs::EmptyConstPtr &) { encoder.forceKeyFrame(); });
+
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ ********************************************************************************************************
+ * @file    depth_conditioner_node.cpp
+ * @brief   publishes the multisense depth masked with the cost image and fused over time
+ * @details gets the synchronized color, depth and cost images, looks up the pose of the left camera
+ *          at the time of the frame and publishes the conditioned depth and its variance on
+ *          conditioned_depth and conditioned_depth_variance
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/DepthConditioner.h>
+#include <tough_perception_common/MultisenseImage.h>
+#include <tough_common/tough_common_names.h>
+#include <cv_bridge/cv_bridge.h>
+#include <image_transport/image_transport.h>
+#include <sensor_msgs/image_encodings.h>
+#include <tf/transform_listener.h>
+#include <tf_conversions/tf_eigen.h>
+
+using namespace tough_perception;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "depth_conditioner");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    DepthConditionerParams params;
+    std::string fixed_frame, camera_frame;
+    pnh.param<std::string>("fixed_frame", fixed_frame, TOUGH_COMMON_NAMES::WORLD_TF);
+    pnh.param<std::string>("camera_frame", camera_frame, TOUGH_COMMON_NAMES::LEFT_CAMERA_OPTICAL_FRAME_TF);
+    pnh.param<int>("max_cost", params.max_cost, params.max_cost);
+    pnh.param<float>("min_depth", params.min_depth, params.min_depth);
+    pnh.param<float>("max_depth", params.max_depth, params.max_depth);
+    pnh.param<int>("window", params.window, params.window);
+    pnh.param<int>("min_samples", params.min_samples, params.min_samples);
+    pnh.param<float>("depth_noise", params.depth_noise, params.depth_noise);
+    pnh.param<float>("outlier_gate", params.outlier_gate, params.outlier_gate);
+    pnh.param<float>("max_translation", params.max_translation, params.max_translation);
+    pnh.param<float>("max_rotation", params.max_rotation, params.max_rotation);
+    pnh.param<int>("num_threads", params.num_threads, params.num_threads);
+
+    MultisenseImage mi(nh);
+    DepthConditioner conditioner(params);
+    tf::TransformListener listener;
+
+    image_transport::ImageTransport it(nh);
+    image_transport::Publisher depth_pub    = it.advertise("conditioned_depth", 1);
+    image_transport::Publisher variance_pub = it.advertise("conditioned_depth_variance", 1);
+
+    cv::Mat color, depth, cost, conditioned, variance;
+    ros::Time stamp;
+    ros::Rate rate(30);
+    while(ros::ok())
+    {
+        ros::spinOnce();
+        if(!mi.giveSyncDepthImageswTime(color, depth, cost, stamp))
+        {
+            rate.sleep();
+            continue;
+        }
+
+        // the history is only fused while the head holds still
+        tf::StampedTransform camera_tf;
+        try
+        {
+            listener.waitForTransform(fixed_frame, camera_frame, stamp, ros::Duration(0.1));
+            listener.lookupTransform(fixed_frame, camera_frame, stamp, camera_tf);
+        }
+        catch(tf::TransformException &ex)
+        {
+            ROS_WARN_THROTTLE(5, "depth_conditioner: %s", ex.what());
+            conditioner.reset();
+            continue;
+        }
+        Eigen::Affine3d camera_pose;
+        tf::transformTFToEigen(camera_tf, camera_pose);
+
+        if(!conditioner.condition(depth, cost, camera_pose.cast<float>(), conditioned, variance))
+            continue;
+
+        std_msgs::Header header;
+        header.stamp    = stamp;
+        header.frame_id = camera_frame;
+        depth_pub.publish(cv_bridge::CvImage(header, sensor_msgs::image_encodings::TYPE_32FC1, conditioned).toImageMsg());
+        if(variance_pub.getNumSubscribers() > 0)
+            variance_pub.publish(cv_bridge::CvImage(header, sensor_msgs::image_encodings::TYPE_32FC1, variance).toImageMsg());
+    }
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include <tough_perception_common/laser2point_cloud.h>
+#include <algorithm>
+#include <cmath>
 
 
 
@@ -6,11 +8,14 @@ Laser2PointCloud::Laser2PointCloud(ros::NodeHandle n,
                                    const std::string laserScanTopic,
                                    const std::string baseFrame,
                                    const std::string pointCloudTopic,
-                                   const std::string pointCloud2Topic):m_laserScanSubscriber(n.subscribe(laserScanTopic,100, &Laser2PointCloud::scanCallBack, this)) {
+                                   const std::string pointCloud2Topic,
+                                   ros::NodeHandle pnh):m_laserScanSubscriber(n.subscribe(laserScanTopic,100, &Laser2PointCloud::scanCallBack, this)) {
 
     m_pointCloud2Publisher = n.advertise<sensor_msgs::PointCloud2>(pointCloud2Topic, 30,true);
     m_pointCloudPublisher = n.advertise<sensor_msgs::PointCloud>(pointCloudTopic, 30, true);
     m_baseFrame.assign(baseFrame);
+
+    pnh.param<int>("deskew_knots", m_deskewKnots, 8);
 }
 
 void Laser2PointCloud::scanCallBack(const sensor_msgs::LaserScan::ConstPtr& scan_in){
@@ -24,13 +29,16 @@ void Laser2PointCloud::scanCallBack(const sensor_msgs::LaserScan::ConstPtr& scan
     }
 
     // Got the tf, proceed with conversion
-    sensor_msgs::PointCloud cloud;
-    m_projector.transformLaserScanToPointCloud(m_baseFrame,*scan_in,
-                                               cloud,m_listener);
+    // messages are published as shared pointers so that nodelets in the same manager receive them without a copy
+    sensor_msgs::PointCloud::Ptr cloud(new sensor_msgs::PointCloud);
+    if(m_deskewKnots < 2 || scan_in->time_increment <= 0.0f || !deskewScan(*scan_in, *cloud)){
+        m_projector.transformLaserScanToPointCloud(m_baseFrame,*scan_in,
+                                                   *cloud,m_listener);
+    }
 
     // convert pointcloud to pointcloud2
-    sensor_msgs::PointCloud2 cloud2;
-    sensor_msgs::convertPointCloudToPointCloud2(cloud, cloud2);
+    sensor_msgs::PointCloud2::Ptr cloud2(new sensor_msgs::PointCloud2);
+    sensor_msgs::convertPointCloudToPointCloud2(*cloud, *cloud2);
 
     //publish the ros message
     m_pointCloudPublisher.publish(cloud);
@@ -39,4 +47,68 @@ void Laser2PointCloud::scanCallBack(const sensor_msgs::LaserScan::ConstPtr& scan
 
 }
 
+bool Laser2PointCloud::deskewScan(const sensor_msgs::LaserScan &scan_in, sensor_msgs::PointCloud &cloud){
+    const size_t num_beams = scan_in.ranges.size();
+    if(num_beams < 2){
+        return false;
+    }
+
+    // sample the sensor pose at evenly spaced knots over the scan
+    const double scan_duration = (num_beams - 1)*scan_in.time_increment;
+    const double knot_interval = scan_duration/(m_deskewKnots - 1);
+    std::vector<tf::StampedTransform> knots(m_deskewKnots);
+    try{
+        for(int k = 0; k < m_deskewKnots; ++k){
+            m_listener.lookupTransform(m_baseFrame, scan_in.header.frame_id,
+                                       scan_in.header.stamp + ros::Duration(k*knot_interval), knots[k]);
+        }
+    }
+    catch(tf::TransformException &ex){
+        ROS_WARN_THROTTLE(1.0, "Laser2PointCloud::deskewScan : %s", ex.what());
+        return false;
+    }
+
+    cloud.header.frame_id = m_baseFrame;
+    cloud.header.stamp    = scan_in.header.stamp;
+    cloud.points.clear();
+    cloud.points.reserve(num_beams);
+    cloud.channels.clear();
+
+    const bool has_intensity = scan_in.intensities.size() == num_beams;
+    sensor_msgs::ChannelFloat32 intensity, index;
+    intensity.name = "intensity";
+    index.name     = "index";
 
+    for(size_t i = 0; i < num_beams; ++i){
+        const float range = scan_in.ranges[i];
+        if(!std::isfinite(range) || range < scan_in.range_min || range > scan_in.range_max){
+            continue;
+        }
+
+        // interpolate the pose between the two knots around the time of the beam
+        const double t     = i*scan_in.time_increment/knot_interval;
+        const int    knot  = std::min(static_cast<int>(t), m_deskewKnots - 2);
+        const double ratio = t - knot;
+        tf::Transform pose(knots[knot].getRotation().slerp(knots[knot + 1].getRotation(), ratio),
+                           knots[knot].getOrigin().lerp(knots[knot + 1].getOrigin(), ratio));
+
+        const double angle = scan_in.angle_min + i*scan_in.angle_increment;
+        const tf::Vector3 pt = pose*tf::Vector3(range*cos(angle), range*sin(angle), 0.0);
+
+        geometry_msgs::Point32 point;
+        point.x = pt.x();
+        point.y = pt.y();
+        point.z = pt.z();
+        cloud.points.push_back(point);
+        if(has_intensity){
+            intensity.values.push_back(scan_in.intensities[i]);
+        }
+        index.values.push_back(i);
+    }
+
+    if(has_intensity){
+        cloud.channels.push_back(intensity);
+    }
+    cloud.channels.push_back(index);
+    return true;
+}
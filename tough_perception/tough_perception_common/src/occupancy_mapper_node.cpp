@@ -0,0 +1,124 @@
+/**
+ ********************************************************************************************************
+ * @file    occupancy_mapper_node.cpp
+ * @brief   incremental occupancy mapping of the filtered laser scans
+ * @details subscribes to cloud_in, one filtered laser scan per message, and inserts every scan in an
+ *          OccupancyMapper with the sensor pose at the stamp of the scan. The voxels that changed are
+ *          published on occupied_cells_delta and freed_cells_delta, all the occupied voxels are
+ *          published periodically on occupied_cells and the 2D projection on projected_map.
+ *          Remap the topics in the launch file.
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/OccupancyMapper.h>
+#include <tough_common/tough_common_names.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <tf/transform_listener.h>
+#include <tf_conversions/tf_eigen.h>
+#include <pcl/common/transforms.h>
+#include <std_msgs/Empty.h>
+
+using namespace tough_perception;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "occupancy_mapper");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    OccupancyMapperParams params;
+    std::string frame_id, sensor_frame;
+    double full_map_period;
+    pnh.param<std::string>("frame_id", frame_id, TOUGH_COMMON_NAMES::WORLD_TF);
+    pnh.param<std::string>("sensor_frame", sensor_frame, TOUGH_COMMON_NAMES::HEAD_HOKUYO_FRAME_TF);
+    pnh.param<float>("resolution", params.resolution, params.resolution);
+    pnh.param<float>("sensor_model/hit", params.prob_hit, params.prob_hit);
+    pnh.param<float>("sensor_model/miss", params.prob_miss, params.prob_miss);
+    pnh.param<float>("sensor_model/min", params.clamp_min, params.clamp_min);
+    pnh.param<float>("sensor_model/max", params.clamp_max, params.clamp_max);
+    pnh.param<float>("sensor_model/max_range", params.max_range, params.max_range);
+    pnh.param<float>("occupancy_thres", params.occupancy_thres, params.occupancy_thres);
+    pnh.param<float>("occupancy_min_z", params.projection_min_z, params.projection_min_z);
+    pnh.param<float>("occupancy_max_z", params.projection_max_z, params.projection_max_z);
+    pnh.param<int>("num_threads", params.num_threads, params.num_threads);
+    pnh.param<double>("full_map_period", full_map_period, 5.0);
+
+    OccupancyMapper mapper(params);
+    tf::TransformListener listener;
+
+    ros::Publisher occupied_delta_pub = nh.advertise<sensor_msgs::PointCloud2>("occupied_cells_delta", 10);
+    ros::Publisher freed_delta_pub    = nh.advertise<sensor_msgs::PointCloud2>("freed_cells_delta", 10);
+    ros::Publisher occupied_pub       = nh.advertise<sensor_msgs::PointCloud2>("occupied_cells", 1, true);
+    ros::Publisher projected_map_pub  = nh.advertise<nav_msgs::OccupancyGrid>("projected_map", 1, true);
+
+    ros::Subscriber cloud_sub = nh.subscribe<sensor_msgs::PointCloud2>("cloud_in", 10,
+            [&](const sensor_msgs::PointCloud2ConstPtr &msg)
+            {
+                pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+                pcl::fromROSMsg(*msg, *cloud);
+                if(cloud->empty())
+                    return;
+
+                tf::StampedTransform cloud_tf, sensor_tf;
+                try
+                {
+                    listener.waitForTransform(frame_id, msg->header.frame_id, msg->header.stamp, ros::Duration(0.5));
+                    listener.lookupTransform(frame_id, msg->header.frame_id, msg->header.stamp, cloud_tf);
+                    // the rays of the scan start where the sensor was when it was taken
+                    listener.lookupTransform(frame_id, sensor_frame, msg->header.stamp, sensor_tf);
+                }
+                catch(tf::TransformException &ex)
+                {
+                    ROS_WARN("occupancy_mapper: %s", ex.what());
+                    return;
+                }
+
+                Eigen::Affine3d cloud_pose;
+                tf::transformTFToEigen(cloud_tf, cloud_pose);
+                pcl::transformPointCloud(*cloud, *cloud, cloud_pose.cast<float>());
+                const Eigen::Vector3f origin(sensor_tf.getOrigin().x(), sensor_tf.getOrigin().y(), sensor_tf.getOrigin().z());
+
+                size_t rays = mapper.insertCloud(*cloud, origin);
+                ROS_DEBUG("occupancy_mapper: traced %lu of %lu points", rays, cloud->size());
+                if(rays == 0)
+                    return;
+
+                pcl::PointCloud<pcl::PointXYZ> occupied, freed;
+                mapper.takeChanges(occupied, freed);
+                occupied.header.frame_id = frame_id;
+                freed.header.frame_id    = frame_id;
+                pcl_conversions::toPCL(msg->header.stamp, occupied.header.stamp);
+                freed.header.stamp       = occupied.header.stamp;
+                if(!occupied.empty())
+                    occupied_delta_pub.publish(occupied);
+                if(!freed.empty())
+                    freed_delta_pub.publish(freed);
+
+                nav_msgs::OccupancyGrid grid;
+                if(mapper.getProjectedMap(grid))
+                {
+                    grid.header.frame_id = frame_id;
+                    grid.header.stamp    = msg->header.stamp;
+                    projected_map_pub.publish(grid);
+                }
+            });
+
+    ros::Subscriber reset_sub = nh.subscribe<std_msgs::Empty>("reset_pointcloud", 1,
+            [&](const std_msgs::EmptyConstPtr &) { mapper.clear(); });
+
+    // the full map is only for late subscribers, the deltas carry the updates
+    ros::Timer full_map_timer = nh.createTimer(ros::Duration(full_map_period),
+            [&](const ros::TimerEvent &)
+            {
+                if(occupied_pub.getNumSubscribers() == 0)
+                    return;
+                pcl::PointCloud<pcl::PointXYZ> occupied;
+                mapper.getOccupiedCells(occupied);
+                occupied.header.frame_id = frame_id;
+                pcl_conversions::toPCL(ros::Time::now(), occupied.header.stamp);
+                occupied_pub.publish(occupied);
+            });
+
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**
+ ********************************************************************************************************
+ * @file    perception_nodelets.cpp
+ * @brief   nodelet wrappers of the laser pipeline
+ * @details Laser2PointCloud, PeriodicSnapshotter and WalkwayGenerator loaded in one nodelet manager exchange
+ *          their clouds as shared pointers instead of serializing them. See field_perception_nodelets.launch.
+ ********************************************************************************************************
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <tough_perception_common/laser2point_cloud.h>
+#include <tough_perception_common/periodic_snapshotter.h>
+#include <tough_perception_common/walkway_generator.h>
+#include <tough_perception_common/perception_common_names.h>
+#include <tough_common/tough_common_names.h>
+#include <memory>
+
+namespace tough_perception {
+
+class Laser2PointCloudNodelet : public nodelet::Nodelet
+{
+    std::unique_ptr<Laser2PointCloud> laser2point_;
+
+    virtual void onInit()
+    {
+        laser2point_.reset(new Laser2PointCloud(getNodeHandle(), PERCEPTION_COMMON_NAMES::MULTISENSE_LASER_SCAN_TOPIC, TOUGH_COMMON_NAMES::WORLD_TF,
+                                                PERCEPTION_COMMON_NAMES::MULTISENSE_LASER_CLOUD_TOPIC, PERCEPTION_COMMON_NAMES::MULTISENSE_LASER_CLOUD_TOPIC2,
+                                                getPrivateNodeHandle()));
+    }
+};
+
+/**
+ * @note the service mode is not waited for here, onInit must not block the manager
+ */
+class PeriodicSnapshotterNodelet : public nodelet::Nodelet
+{
+    std::unique_ptr<laser_assembler::PeriodicSnapshotter> snapshotter_;
+
+    virtual void onInit()
+    {
+        snapshotter_.reset(new laser_assembler::PeriodicSnapshotter(getNodeHandle(), getPrivateNodeHandle()));
+    }
+};
+
+class WalkwayGeneratorNodelet : public nodelet::Nodelet
+{
+    std::unique_ptr<WalkwayGenerator> generator_;
+
+    virtual void onInit()
+    {
+        generator_.reset(new WalkwayGenerator(getNodeHandle()));
+    }
+};
+
+} /* namespace tough_perception */
+
+PLUGINLIB_EXPORT_CLASS(tough_perception::Laser2PointCloudNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(tough_perception::PeriodicSnapshotterNodelet, nodelet::Nodelet)
+PLUGINLIB_EXPORT_CLASS(tough_perception::WalkwayGeneratorNodelet, nodelet::Nodelet)
@@ -42,14 +42,12 @@
 
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/filters/filter.h>
-#include <pcl/filters/crop_box.h>
 #include <pcl/features/normal_3d.h>
 
 #include <pcl/registration/icp.h>
 #include <pcl/registration/icp_nl.h>
 #include <pcl/registration/transforms.h>
 
-#include <pcl/filters/passthrough.h>
 #include <pcl/octree/octree_pointcloud_density.h>
 
 #include <pcl/visualization/pcl_visualizer.h>
@@ -107,7 +105,8 @@ public:
     }
 };
 
-PeriodicSnapshotter::PeriodicSnapshotter()
+PeriodicSnapshotter::PeriodicSnapshotter(ros::NodeHandle nh, ros::NodeHandle pnh):
+    n_(nh)
 {
     robot_state_                = RobotStateInformer::getRobotStateInformer(n_);
     rd_                         = RobotDescription::getRobotDescription(n_);
@@ -117,13 +116,29 @@ PeriodicSnapshotter::PeriodicSnapshotter()
     resetPointcloudSub_         = n_.subscribe("reset_pointcloud", 10, &PeriodicSnapshotter::resetPointcloudCB, this);
     pausePointcloudSub_         = n_.subscribe("pause_pointcloud", 10, &PeriodicSnapshotter::pausePointcloudCB, this);
     boxFilterSub_               = n_.subscribe("clearbox_pointcloud", 10, &PeriodicSnapshotter::setBoxFilterCB, this);
-    // Create the service client for calling the assembler
-    client_                     = n_.serviceClient<AssembleScans2>("assemble_scans2");
-    snapshot_sub_               = n_.subscribe("snapshot_cloud2",10, &PeriodicSnapshotter::mergeClouds, this);
+
+    // scans are accumulated in process unless the laser_assembler service is requested
+    pnh.param<bool>("use_assembler_service", use_assembler_service_, false);
+    if(use_assembler_service_)
+    {
+        // Create the service client for calling the assembler
+        client_                 = n_.serviceClient<AssembleScans2>("assemble_scans2");
+        snapshot_sub_           = n_.subscribe("snapshot_cloud2",10, &PeriodicSnapshotter::mergeClouds, this);
+    }
+    else
+    {
+        int max_clouds;
+        std::string fixed_frame;
+        pnh.param<int>("max_clouds", max_clouds, 400);
+        pnh.param<std::string>("fixed_frame", fixed_frame, TOUGH_COMMON_NAMES::WORLD_TF);
+        scan_accumulator_.reset(new tough_perception::ScanAccumulator(n_, PERCEPTION_COMMON_NAMES::MULTISENSE_LASER_FILTERED_CLOUD_TOPIC2,
+                                                                      fixed_frame, max_clouds));
+    }
 
     // Start the timer that will trigger the processing loop (timerCallback)
     float timeout;
     n_.param<float>("laser_assembler_svc/laser_snapshot_timeout", timeout, 5.0);
+    pnh.param<float>("snapshot_period", timeout, timeout);
     ROS_INFO("PeriodicSnapshotter::PeriodicSnapshotter : Snapshot timeout : %.2f seconds", timeout);
     timer_ = n_.createTimer(ros::Duration(timeout,0), &PeriodicSnapshotter::timerCallback, this);
 
@@ -144,6 +159,30 @@ PeriodicSnapshotter::PeriodicSnapshotter()
     n_.param<float>("filter_min_z", filter_min_z, -10.0);
     n_.param<float>("filter_max_z", filter_max_z, 10.0);
 
+    // scans deskewed by laser2point_cloud need fewer iterations to converge
+    pnh.param<int>("icp_iterations", icp_iterations_, 30);
+
+    // regions always removed from the merged cloud, each one is [min_x, min_y, min_z, max_x, max_y, max_z]
+    XmlRpc::XmlRpcValue exclusions;
+    if(pnh.getParam("filter_exclusion_regions", exclusions) && exclusions.getType() == XmlRpc::XmlRpcValue::TypeArray)
+    {
+        for(int i = 0; i < exclusions.size(); ++i)
+        {
+            if(exclusions[i].getType() != XmlRpc::XmlRpcValue::TypeArray || exclusions[i].size() != 6)
+            {
+                ROS_WARN("PeriodicSnapshotter::PeriodicSnapshotter : Ignoring exclusion region %d, expected 6 values", i);
+                continue;
+            }
+            float bounds[6];
+            for(int j = 0; j < 6; ++j)
+            {
+                XmlRpc::XmlRpcValue &value = exclusions[i][j];
+                bounds[j] = value.getType() == XmlRpc::XmlRpcValue::TypeInt ? (int)value : (double)value;
+            }
+            exclusion_regions_.emplace_back(Eigen::Vector3f(bounds[0], bounds[1], bounds[2]),
+                                            Eigen::Vector3f(bounds[3], bounds[4], bounds[5]));
+        }
+    }
 
 }
 
@@ -159,6 +198,19 @@ void PeriodicSnapshotter::timerCallback(const ros::TimerEvent& e)
         return;
     }
 
+    if(!use_assembler_service_)
+    {
+        // the snapshot is handed to mergeClouds directly, it is still published for other consumers
+        sensor_msgs::PointCloud2::Ptr cloud(new sensor_msgs::PointCloud2);
+        size_t scans = scan_accumulator_->assemble(e.last_real, e.current_real, *cloud);
+        if(scans == 0)
+            return;
+        ROS_DEBUG("PeriodicSnapshotter::timerCallback : Assembled %lu scans, %u points", scans, cloud->width);
+        snapshot_pub_.publish(cloud);
+        mergeClouds(cloud);
+        return;
+    }
+
     // Populate our service request based on our timer callback times
     AssembleScans2 srv;
     srv.request.begin = e.last_real;
@@ -236,7 +288,7 @@ void PeriodicSnapshotter::pairAlign (const pcl::PointCloud<pcl::PointXYZ>::Ptr c
     Eigen::Matrix4f Ti = Eigen::Matrix4f::Identity (), prev, targetToSource;
     PointCloudWithNormals::Ptr reg_result = points_with_normals_src;
     reg.setMaximumIterations (2);
-    for (int i = 0; i < 30; ++i)
+    for (int i = 0; i < icp_iterations_; ++i)
     {
         // save cloud for visualization purpose
         points_with_normals_src = reg_result;
@@ -303,10 +355,9 @@ void PeriodicSnapshotter::setBoxFilterCB(const std_msgs::Int8 &msg)
     pcl::PointCloud<pcl::PointXYZ>::Ptr pcl_prev_msg(new pcl::PointCloud<pcl::PointXYZ>);
     convertROStoPCL(prev_msg_, pcl_prev_msg);
     geometry_msgs::Pose pelvisPose;
-    pcl::PointCloud<pcl::PointXYZ>::Ptr tgt (new pcl::PointCloud<pcl::PointXYZ>);
     robot_state_->getCurrentPose(rd_->getPelvisFrame(), pelvisPose);
-    Eigen::Vector4f minPoint;
-    Eigen::Vector4f maxPoint;
+    Eigen::Vector3f minPoint;
+    Eigen::Vector3f maxPoint;
 
     // this indicates that if the msg contains element 1 it, would clear point cloud from waist up
     if(msg.data == 1)
@@ -343,28 +394,16 @@ void PeriodicSnapshotter::setBoxFilterCB(const std_msgs::Int8 &msg)
         maxPoint[2]=1;
     }
 
-    Eigen::Vector3f boxTranslatation;
-    boxTranslatation[0]=pelvisPose.position.x;
-    boxTranslatation[1]=pelvisPose.position.y;
-    boxTranslatation[2]=pelvisPose.position.z;
-    Eigen::Vector3f boxRotation;
-    boxRotation[0]=0;  // rotation around x-axis
-    boxRotation[1]=0;  // rotation around y-axis
-    boxRotation[2]= tf::getYaw(pelvisPose.orientation);  //in radians rotation around z-axis. this rotates your cube 45deg around z-axis.
-
-
-    pcl::CropBox<pcl::PointXYZ> box_filter;
-    std::vector<int> indices;
-    indices.clear();
-    box_filter.setInputCloud(pcl_prev_msg);
-    box_filter.setMin(minPoint);
-    box_filter.setMax(maxPoint);
-    box_filter.setTranslation(boxTranslatation);
-    box_filter.setRotation(boxRotation);
-    box_filter.setNegative(true);
-    box_filter.filter(*tgt);
+    // the box is placed at the pelvis and rotated with its yaw
+    Eigen::Affine3f boxTransform = Eigen::Translation3f(pelvisPose.position.x, pelvisPose.position.y, pelvisPose.position.z)
+                                 * Eigen::AngleAxisf(tf::getYaw(pelvisPose.orientation), Eigen::Vector3f::UnitZ());
+
+    std::vector<tough_perception::CropRegion> regions;
+    regions.emplace_back(minPoint, maxPoint, boxTransform);
+    tough_perception::PointCloudHelper::removeRegionsInPlace(*pcl_prev_msg, regions);
+
     sensor_msgs::PointCloud2::Ptr merged_cloud(new sensor_msgs::PointCloud2());
-    convertPCLtoROS(tgt,merged_cloud);
+    convertPCLtoROS(pcl_prev_msg,merged_cloud);
     prev_msg_ = merged_cloud;
 
     registered_pointcloud_pub_.publish(merged_cloud);
@@ -439,45 +478,8 @@ void PeriodicSnapshotter::mergeClouds(const sensor_msgs::PointCloud2::Ptr msg){
 void
 PeriodicSnapshotter::clipPointCloud(const pcl::PointCloud<pcl::PointXYZ>::Ptr input_cloud)
 {
-    pcl::PassThrough<pcl::PointXYZ> globalPassThroughFilter;
-
-    globalPassThroughFilter.setInputCloud(input_cloud);
-    globalPassThroughFilter.setFilterFieldName ("z");
-    globalPassThroughFilter.setFilterLimits (filter_min_z, filter_max_z);
-    globalPassThroughFilter.filter (*input_cloud);
-
-
-    globalPassThroughFilter.setInputCloud(input_cloud);
-    globalPassThroughFilter.setFilterFieldName ("y");
-    globalPassThroughFilter.setFilterLimits (filter_min_y, filter_max_y);
-    globalPassThroughFilter.filter (*input_cloud);
-
-
-    globalPassThroughFilter.setInputCloud(input_cloud);
-    globalPassThroughFilter.setFilterFieldName ("x");
-    globalPassThroughFilter.setFilterLimits (filter_min_x, filter_max_x);
-    globalPassThroughFilter.filter (*input_cloud);
-}
-
-
-
-int main(int argc, char **argv)
-{
-    ros::init(argc, argv, "periodic_snapshotter");
-    ros::NodeHandle n;
-    ROS_INFO("Waiting for [build_cloud] to be advertised");
-    ros::service::waitForService("build_cloud");
-    ROS_INFO("Found build_cloud! Starting the snapshotter");
-    PeriodicSnapshotter snapshotter;
-
-    float timeout;
-    n.param<float>("laser_assembler_svc/laser_snapshot_timeout", timeout, 5.0);
-
-    ros::Rate looprate((double)timeout);
-    while(ros::ok())
-    {
-        ros::spinOnce();
-        looprate.sleep();
-    }
-    return 0;
+    // one pass over the cloud for the clipping box and the exclusion regions, without intermediate copies
+    tough_perception::CropRegion clipRegion(Eigen::Vector3f(filter_min_x, filter_min_y, filter_min_z),
+                                            Eigen::Vector3f(filter_max_x, filter_max_y, filter_max_z));
+    tough_perception::PointCloudHelper::cropInPlace(*input_cloud, clipRegion, exclusion_regions_);
 }
@@ -0,0 +1,23 @@
+#include "tough_perception_common/periodic_snapshotter.h"
+
+using namespace laser_assembler;
+
+int main(int argc, char **argv)
+{
+    ros::init(argc, argv, "periodic_snapshotter");
+    ros::NodeHandle n;
+    ros::NodeHandle pnh("~");
+    bool use_assembler_service;
+    pnh.param<bool>("use_assembler_service", use_assembler_service, false);
+    if(use_assembler_service)
+    {
+        ROS_INFO("Waiting for [build_cloud] to be advertised");
+        ros::service::waitForService("build_cloud");
+        ROS_INFO("Found build_cloud! Starting the snapshotter");
+    }
+    PeriodicSnapshotter snapshotter(n, pnh);
+
+    // the scans are received by the accumulator between snapshots, callbacks can not wait for a slow loop
+    ros::spin();
+    return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ ********************************************************************************************************
+ * @file    plane_segmenter_node.cpp
+ * @brief   finds the horizontal and vertical planes of the assembled cloud
+ * @details subscribes to the assembled laser cloud, downsamples it and computes its normals, then
+ *          publishes every plane patch found on planar_patches and their outlines as markers on
+ *          planar_patches_markers. Stair treads and platforms are horizontal patches.
+ ********************************************************************************************************
+ */
+
+#include <tough_perception_common/PlaneSegmenter.h>
+#include <tough_perception_common/PlanarPatchArray.h>
+#include <tough_perception_common/perception_common_names.h>
+#include <pcl_conversions/pcl_conversions.h>
+#include <pcl/features/normal_3d_omp.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/search/kdtree.h>
+#include <visualization_msgs/MarkerArray.h>
+
+using namespace tough_perception;
+
+int main(int argc, char** argv)
+{
+    ros::init(argc, argv, "plane_segmenter");
+    ros::NodeHandle nh;
+    ros::NodeHandle pnh("~");
+
+    PlaneSegmenterParams params;
+    double leaf_size, normal_radius;
+    pnh.param<double>("leaf_size", leaf_size, 0.02);
+    pnh.param<double>("normal_radius", normal_radius, 0.05);
+    pnh.param<float>("distance_threshold", params.distance_threshold, params.distance_threshold);
+    pnh.param<float>("normal_threshold", params.normal_threshold, params.normal_threshold);
+    pnh.param<int>("min_inliers", params.min_inliers, params.min_inliers);
+    pnh.param<int>("max_planes", params.max_planes, params.max_planes);
+    pnh.param<int>("max_iterations", params.max_iterations, params.max_iterations);
+    pnh.param<float>("probability", params.probability, params.probability);
+    pnh.param<float>("orientation_tolerance", params.orientation_tolerance, params.orientation_tolerance);
+    pnh.param<bool>("keep_slanted", params.keep_slanted, params.keep_slanted);
+    pnh.param<float>("cluster_tolerance", params.cluster_tolerance, params.cluster_tolerance);
+    pnh.param<int>("num_threads", params.num_threads, params.num_threads);
+
+    PlaneSegmenter segmenter(params);
+    ros::Publisher patches_pub = nh.advertise<tough_perception_common::PlanarPatchArray>("planar_patches", 1, true);
+    ros::Publisher markers_pub = nh.advertise<visualization_msgs::MarkerArray>("planar_patches_markers", 1, true);
+    size_t published_markers = 0;
+
+    ros::Subscriber cloud_sub = nh.subscribe<sensor_msgs::PointCloud2>(PERCEPTION_COMMON_NAMES::ASSEMBLED_LASER_CLOUD_TOPIC, 1,
+            [&](const sensor_msgs::PointCloud2ConstPtr &msg)
+            {
+                pcl::PointCloud<pcl::PointXYZ>::Ptr input(new pcl::PointCloud<pcl::PointXYZ>);
+                pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+                pcl::PointCloud<pcl::Normal> normals;
+                pcl::fromROSMsg(*msg, *input);
+                if(input->empty())
+                    return;
+
+                ros::WallTime start = ros::WallTime::now();
+                pcl::VoxelGrid<pcl::PointXYZ> voxel;
+                voxel.setInputCloud(input);
+                voxel.setLeafSize(leaf_size, leaf_size, leaf_size);
+                voxel.filter(*cloud);
+
+                pcl::NormalEstimationOMP<pcl::PointXYZ, pcl::Normal> normal_estimation(params.num_threads);
+                pcl::search::KdTree<pcl::PointXYZ>::Ptr tree(new pcl::search::KdTree<pcl::PointXYZ>);
+                normal_estimation.setInputCloud(cloud);
+                normal_estimation.setSearchMethod(tree);
+                normal_estimation.setRadiusSearch(normal_radius);
+                normal_estimation.compute(normals);
+
+                std::vector<PlanarPatch> patches;
+                segmenter.segment(*cloud, normals, patches);
+                ROS_INFO("plane_segmenter: %lu planes in %lu points, %.1f ms", patches.size(), cloud->size(),
+                         (ros::WallTime::now() - start).toSec()*1000.0);
+
+                tough_perception_common::PlanarPatchArray patch_array;
+                visualization_msgs::MarkerArray markers;
+                patch_array.header = msg->header;
+                for(size_t i = 0; i < patches.size(); ++i)
+                {
+                    const PlanarPatch &patch = patches[i];
+                    tough_perception_common::PlanarPatch patch_msg;
+                    patch_msg.type        = patch.type;
+                    patch_msg.normal.x    = patch.normal.x();
+                    patch_msg.normal.y    = patch.normal.y();
+                    patch_msg.normal.z    = patch.normal.z();
+                    patch_msg.d           = patch.d;
+                    patch_msg.centroid.x  = patch.centroid.x();
+                    patch_msg.centroid.y  = patch.centroid.y();
+                    patch_msg.centroid.z  = patch.centroid.z();
+                    patch_msg.area        = patch.area;
+                    patch_msg.num_inliers = patch.inliers.size();
+                    patch_msg.hull.resize(patch.hull.size());
+                    for(size_t j = 0; j < patch.hull.size(); ++j)
+                    {
+                        patch_msg.hull[j].x = patch.hull[j].x();
+                        patch_msg.hull[j].y = patch.hull[j].y();
+                        patch_msg.hull[j].z = patch.hull[j].z();
+                    }
+
+                    visualization_msgs::Marker marker;
+                    marker.header             = msg->header;
+                    marker.ns                 = "planar_patches";
+                    marker.id                 = i;
+                    marker.type               = visualization_msgs::Marker::LINE_STRIP;
+                    marker.action             = visualization_msgs::Marker::ADD;
+                    marker.pose.orientation.w = 1.0;
+                    marker.scale.x            = 0.01;
+                    marker.color.a            = 1.0;
+                    marker.color.g            = patch.type == PlanarPatch::HORIZONTAL ? 1.0 : 0.0;
+                    marker.color.b            = patch.type == PlanarPatch::VERTICAL ? 1.0 : 0.0;
+                    marker.color.r            = patch.type == PlanarPatch::SLANTED ? 1.0 : 0.0;
+                    marker.points             = patch_msg.hull;
+                    if(!marker.points.empty())
+                        marker.points.push_back(marker.points.front());
+                    markers.markers.push_back(marker);
+
+                    patch_array.patches.push_back(patch_msg);
+                }
+
+                // remove the outlines of the previous cloud that are not replaced
+                for(size_t i = patches.size(); i < published_markers; ++i)
+                {
+                    visualization_msgs::Marker marker;
+                    marker.header = msg->header;
+                    marker.ns     = "planar_patches";
+                    marker.id     = i;
+                    marker.action = visualization_msgs::Marker::DELETE;
+                    markers.markers.push_back(marker);
+                }
+                published_markers = patches.size();
+
+                patches_pub.publish(patch_array);
+                markers_pub.publish(markers);
+            });
+
+    ros::spin();
+    return 0;
+}
@@ -11,6 +11,9 @@
 
 #include <tough_perception_common/PointCloudHelper.h>
 #include <tough_perception_common/MultisenseImage.h>
+#include <tough_perception_common/OrganizedNormalEstimator.h>
+#include <pcl/common/io.h>
+#include <pcl_conversions/pcl_conversions.h>
 
 
 using namespace tough_perception;
@@ -31,6 +34,10 @@ int main(int argc, char** argv)
 	bool new_disp=false;
 
 	ros::Publisher debug_publisher = nh.advertise<pcl::PCLPointCloud2> ("/debug/RGBD", 1);
+	ros::Publisher normals_publisher = nh.advertise<pcl::PointCloud<pcl::PointXYZRGBNormal> > ("/debug/RGBD_normals", 1);
+
+	OrganizedNormalEstimator normal_estimator;
+	pcl::PointCloud<pcl::Normal> normals;
 
 	while(ros::ok())
 	{
@@ -59,6 +66,19 @@ int main(int argc, char** argv)
 			output.header.stamp=ros::Time::now().toNSec();
 			debug_publisher.publish(output);
 
+			if(normals_publisher.getNumSubscribers() > 0)
+			{
+				ros::WallTime start = ros::WallTime::now();
+				normal_estimator.compute(*organized_cloud, normals);
+				ROS_INFO_STREAM("Organized normals computed in "<<(ros::WallTime::now() - start).toSec()*1000.0<<" ms");
+
+				pcl::PointCloud<pcl::PointXYZRGBNormal> cloud_normals;
+				pcl::concatenateFields(*organized_cloud, normals, cloud_normals);
+				cloud_normals.header.frame_id=output.header.frame_id;
+				pcl_conversions::toPCL(ros::Time::now(), cloud_normals.header.stamp);
+				normals_publisher.publish(cloud_normals);
+			}
+
 			new_disp=new_color=false;
 
 		}
@@ -15,7 +15,7 @@
 static const float GROUND_THRESHOLD      = 0.07f;
 static const float FOOT_GROUND_THRESHOLD = 0.05f;
 
-WalkwayGenerator::WalkwayGenerator(ros::NodeHandle &n){
+WalkwayGenerator::WalkwayGenerator(ros::NodeHandle &n):nh_(n){
     pointcloudPub_ = nh_.advertise<pcl::PointCloud<pcl::PointXYZ> >("walkway",1, true);
     ROS_INFO("Subscribing to %s", PERCEPTION_COMMON_NAMES::ASSEMBLED_LASER_CLOUD_TOPIC.c_str());
     pointcloudSub_ = nh_.subscribe(PERCEPTION_COMMON_NAMES::ASSEMBLED_LASER_CLOUD_TOPIC, 1,  &WalkwayGenerator::generateWalkwayPoints, this);
@@ -28,8 +28,12 @@ WalkwayGenerator::~WalkwayGenerator(){
     pointcloudSub_.shutdown();
 }
 
-void WalkwayGenerator::generateWalkwayPoints(const pcl::PointCloud<pcl::PointXYZ>::Ptr cloud){
+void WalkwayGenerator::generateWalkwayPoints(const sensor_msgs::PointCloud2ConstPtr &msg){
 
+    // the assembled cloud is subscribed as PointCloud2 so that it is not serialized inside a nodelet manager,
+    // it is still copied into the pcl cloud
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud (new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::fromROSMsg(*msg, *cloud);
     if(cloud->empty())
         return;
     ROS_INFO("Recieved a pointcloud");
@@ -184,13 +188,3 @@ double WalkwayGenerator::getCurrentFootHeight(void)
     height_foot = height_foot > transformStamped.getOrigin().getZ() ? transformStamped.getOrigin().getZ() : height_foot;
     return height_foot;
 }
-
-
-int main(int argc, char** argv){
-    ros::init(argc, argv, "walkway_generator");
-    ROS_INFO("Starting walkway filter node");
-    ros::NodeHandle n;
-    WalkwayGenerator obj(n);
-    ros::spin();
-    return 0;
-}
@@ -0,0 +1,10 @@
+#include <tough_perception_common/walkway_generator.h>
+
+int main(int argc, char** argv){
+    ros::init(argc, argv, "walkway_generator");
+    ROS_INFO("Starting walkway filter node");
+    ros::NodeHandle n;
+    WalkwayGenerator obj(n);
+    ros::spin();
+    return 0;
+}